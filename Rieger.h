@@ -4,14 +4,98 @@
 
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
 #include <cstdint>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <concepts>
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
 #include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <shared_mutex>
 #include <optional>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <limits>
 #include <filesystem>
 #include <fstream>
-#include <optional>
+#include <functional>
+#include <future>
+#include <iterator>
+#include <span>
+#include <stdexcept>
+#include <system_error>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#if defined(_WIN32) || defined(_WIN64)
+    #define WIN32_LEAN_AND_MEAN
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #include <Windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <sys/uio.h>
+    #include <unistd.h>
+
+    #if defined(__linux__) && __has_include(<linux/io_uring.h>) && !defined(RIEGER_NO_IO_URING)
+        #define RIEGER_HAS_IO_URING
+        #include <linux/io_uring.h>
+        #include <sys/syscall.h>
+    #endif
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+    #include <immintrin.h>
+    #if defined(_MSC_VER)
+        #include <intrin.h>
+    #endif
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+    #include <arm_neon.h>
+#endif
+
+#if defined(__ARM_FEATURE_CRC32)
+    #include <arm_acle.h>
+#endif
+
+#if defined(__linux__) && defined(__aarch64__)
+    #include <asm/hwcap.h>
+    #include <sys/auxv.h>
+#endif
+
+#if defined(RIEGER_USE_ZSTD)
+    #include <zstd.h>
+#endif
+
+#if defined(RIEGER_PROFILE_TRACY)
+    #if !defined(TRACY_ENABLE)
+        #error "RIEGER_PROFILE_TRACY needs TRACY_ENABLE and the Tracy client"
+    #endif
+    #include <tracy/TracyC.h>
+#endif
+
+// Compiles one function for instructions above the build's baseline, so it can be picked at
+// runtime. MSVC emits any intrinsic without it.
+#if defined(__GNUC__) || defined(__clang__)
+    #define RIEGER_TARGET(features) __attribute__((target(features)))
+#else
+    #define RIEGER_TARGET(features)
+#endif
 
 #define CAST static_cast
 #define RCAST reinterpret_cast
@@ -45,261 +129,9124 @@ using Shared = std::shared_ptr<T>;
 template<class T>
 using Option = std::optional<T>;
 
-template<class T>
-using Unique = std::unique_ptr<T>;
+template<class T, class Deleter = std::default_delete<T>>
+using Unique = std::unique_ptr<T, Deleter>;
 
 template<class T>
 using Vector = std::vector<T>;
 
-constexpr auto Inf32 = std::numeric_limits<float>::infinity();
-constexpr auto Inf64 = std::numeric_limits<double>::infinity();
+template<class T>
+using ArenaVector = std::pmr::vector<T>;
 
-namespace IO {
-    inline Option<str> Read(const Path& filename) {
-        if (!exists(filename) || is_directory(filename)) {
-            return kNone;
-        }
+using ArenaString = std::pmr::string;
 
-        std::ifstream file(filename);
-        if (!file.is_open()) {
-            return kNone;
-        }
+// Monotonic bump allocator for ArenaVector/ArenaString and any other std::pmr container.
+// Deallocation is a no-op; Reset() reclaims everything at once and keeps the chunks for the
+// next round, Release() hands them back upstream. Not thread-safe; use one arena per thread
+// (ThreadLocal()) or per request.
+class Arena final : public std::pmr::memory_resource {
+public:
+    static constexpr size_t kDefaultChunkSize = 64 * 1024;
+    static constexpr size_t kMaxChunkSize     = 64 * 1024 * 1024;
 
-        str content((std::istreambuf_iterator(file)), std::istreambuf_iterator<char>());
-        file.close();
+    explicit Arena(const size_t chunkSize                = kDefaultChunkSize,
+                   std::pmr::memory_resource* upstream = std::pmr::get_default_resource())
+        : upstream(upstream), firstChunkSize(std::max<size_t>(chunkSize, 64)) {}
 
-        return content;
+    ~Arena() override {
+        Release();
     }
 
-    inline Option<Vector<u8>> ReadAllBytes(const Path& filename) {
-        if (!exists(filename) || is_directory(filename)) {
-            return kNone;
+    Arena(const Arena&)            = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    static Arena& ThreadLocal() {
+        thread_local Arena arena;
+        return arena;
+    }
+
+    // Invalidates everything allocated so far but keeps the chunks.
+    void Reset() noexcept {
+        current = 0;
+        cursor  = chunks.empty() ? nullptr : chunks.front().memory;
+        limit   = chunks.empty() ? nullptr : chunks.front().memory + chunks.front().size;
+    }
+
+    // Invalidates everything allocated so far and frees the chunks.
+    void Release() noexcept {
+        for (const auto& chunk : chunks) {
+            upstream->deallocate(chunk.memory, chunk.size, alignof(std::max_align_t));
         }
 
-        std::ifstream file(filename, std::ios::binary);
-        if (!file.is_open()) {
-            return kNone;
+        chunks.clear();
+        Reset();
+    }
+
+    // Bytes held in chunks, used or not.
+    [[nodiscard]] size_t Capacity() const noexcept {
+        size_t total = 0;
+        for (const auto& chunk : chunks) {
+            total += chunk.size;
         }
 
-        Vector<u8> bytes(std::istreambuf_iterator(file), {});
-        file.close();
+        return total;
+    }
 
-        return bytes;
+    template<class T>
+    [[nodiscard]] std::pmr::polymorphic_allocator<T> Allocator() noexcept {
+        return this;
     }
 
-    inline Option<Vector<str>> ReadAllLines(const Path& filename) {
-        if (!exists(filename) || is_directory(filename)) {
-            return kNone;
+private:
+    struct Chunk {
+        u8* memory  = nullptr;
+        size_t size = 0;
+    };
+
+    std::pmr::memory_resource* upstream;
+    size_t firstChunkSize;
+    Vector<Chunk> chunks;
+    size_t current = 0;
+    u8* cursor     = nullptr;
+    u8* limit      = nullptr;
+
+    void* do_allocate(const size_t bytes, const size_t alignment) override {
+        while (true) {
+            if (cursor) {
+                const auto address = RCAST<uintptr_t>(cursor);
+                const auto aligned = (address + alignment - 1) & ~(CAST<uintptr_t>(alignment) - 1);
+                const auto padding = CAST<size_t>(aligned - address);
+                if (padding + bytes <= CAST<size_t>(limit - cursor)) {
+                    u8* result = cursor + padding;
+                    cursor     = result + bytes;
+                    return result;
+                }
+            }
+
+            NextChunk(bytes + alignment);
         }
+    }
 
-        std::ifstream file(filename);
-        if (!file.is_open()) {
-            return kNone;
+    void do_deallocate(void*, size_t, size_t) override {}
+
+    [[nodiscard]] bool do_is_equal(const memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+
+    // Moves to the next retained chunk that can hold minimum bytes, or grows a new one with
+    // doubling chunk sizes.
+    void NextChunk(const size_t minimum) {
+        size_t next = cursor ? current + 1 : 0;
+        while (next < chunks.size() && chunks[next].size < minimum) {
+            ++next;
         }
 
-        Vector<str> lines;
-        str line;
-        while (std::getline(file, line)) {
-            lines.push_back(line);
+        if (next == chunks.size()) {
+            const size_t grown =
+              chunks.empty() ? firstChunkSize : std::min(chunks.back().size * 2, kMaxChunkSize);
+            const size_t size = std::max(grown, minimum);
+            auto* memory      = CAST<u8*>(upstream->allocate(size, alignof(std::max_align_t)));
+            chunks.push_back({memory, size});
         }
 
-        file.close();
+        current = next;
+        cursor  = chunks[current].memory;
+        limit   = cursor + chunks[current].size;
+    }
+};
 
-        return lines;
+// Fixed-size object pool. Slots are carved from cache-line-aligned slabs that double in size
+// and are only returned when the pool is destroyed; freed slots go on an intrusive free list.
+// With Concurrent = true, allocation and release are lock-free (a tagged Treiber stack) and may
+// happen on any thread. The pool must outlive every object it hands out.
+template<class T, bool Concurrent = false>
+class Pool {
+public:
+    static constexpr size_t kSlabAlignment = 64;
+
+    explicit Pool(const size_t firstSlabSize = 64)
+        : slabShift(SlabShift(firstSlabSize)) {}
+
+    ~Pool() {
+        for (u32 slab = 0; slab < kMaxSlabs; ++slab) {
+            if (Slot* memory = slabs[slab].load(std::memory_order_relaxed)) {
+                ::operator delete(memory, std::align_val_t {kAlignment});
+            }
+        }
     }
 
-    inline Option<Vector<u8>>
-    ReadBlock(const Path& filename, const u32 blockOffset, const size_t blockSize) {
-        if (!exists(filename) || is_directory(filename)) {
-            return kNone;
+    Pool(const Pool&)            = delete;
+    Pool& operator=(const Pool&) = delete;
+
+    template<class... Args>
+    [[nodiscard]] T* New(Args&&... args) {
+        void* memory = Allocate();
+        try {
+            return new (memory) T(std::forward<Args>(args)...);
+        } catch (...) {
+            Deallocate(memory);
+            throw;
         }
+    }
 
-        std::ifstream file(filename, std::ios::binary);
-        if (!file.is_open()) {
-            return kNone;
+    void Delete(T* object) noexcept {
+        if (object) {
+            object->~T();
+            Deallocate(object);
         }
+    }
 
-        file.seekg(blockOffset, std::ios::beg);
-        if (!file.good()) {
-            return kNone;
+    // Uninitialized storage for one T.
+    [[nodiscard]] void* Allocate() {
+        u64 head = freeList.load(std::memory_order_acquire);
+        while (Link(head) != 0) {
+            Slot* slot     = SlotAt(Link(head) - 1);
+            const u64 next = NextTag(head) | LoadNext(slot);
+            if constexpr (Concurrent) {
+                if (freeList.compare_exchange_weak(
+                      head, next, std::memory_order_acquire, std::memory_order_acquire)) {
+                    return slot->storage;
+                }
+            } else {
+                freeList.store(next, std::memory_order_relaxed);
+                return slot->storage;
+            }
         }
 
-        Vector<u8> buffer(blockSize);
-        file.read(RCAST<char*>(buffer.data()), CAST<std::streamsize>(blockSize));
+        u32 index;
+        if constexpr (Concurrent) {
+            index = fresh.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            index = fresh.load(std::memory_order_relaxed);
+            fresh.store(index + 1, std::memory_order_relaxed);
+        }
 
-        if (file.gcount() != CAST<std::streamsize>(blockSize)) {
-            return kNone;
+        if (index == std::numeric_limits<u32>::max()) {
+            throw std::bad_alloc();
         }
 
-        return buffer;
+        Slot* slot  = SlotAt(index);
+        slot->index = index;
+        return slot->storage;
     }
 
-    inline bool Write(const Path& filename, const str& content) {
-        std::ofstream outfile(filename);
-        if (!outfile.is_open()) {
-            return false;
+    void Deallocate(void* memory) noexcept {
+        Slot* slot     = RCAST<Slot*>(memory);
+        const u32 link = slot->index + 1;
+        u64 head       = freeList.load(std::memory_order_relaxed);
+        while (true) {
+            StoreNext(slot, Link(head));
+            if constexpr (Concurrent) {
+                if (freeList.compare_exchange_weak(head,
+                                                   NextTag(head) | link,
+                                                   std::memory_order_release,
+                                                   std::memory_order_relaxed)) {
+                    return;
+                }
+            } else {
+                freeList.store(NextTag(head) | link, std::memory_order_relaxed);
+                return;
+            }
         }
+    }
 
-        outfile.write(content.c_str(), CAST<std::streamsize>(content.length()));
-        outfile.close();
+    // Slots handed out at least once; freed slots are reused before this grows.
+    [[nodiscard]] size_t Reserved() const noexcept {
+        return fresh.load(std::memory_order_relaxed);
+    }
 
-        return true;
+private:
+    // The object storage sits at offset 0 so a T* converts straight back to its slot.
+    struct Slot {
+        alignas(T) std::byte storage[sizeof(T)];
+        u32 index;
+        u32 next;
+    };
+
+    static constexpr u32 kMaxSlabs     = 32;
+    static constexpr size_t kAlignment = std::max(kSlabAlignment, alignof(Slot));
+
+    // Slab k holds (1 << slabShift) << k slots, so 32 slabs cover every u32 index.
+    u32 slabShift;
+    std::atomic<Slot*> slabs[kMaxSlabs] {};
+    // Low 32 bits: index + 1 of the first free slot (0 when empty); high 32 bits: ABA tag.
+    alignas(kSlabAlignment) std::atomic<u64> freeList {0};
+    alignas(kSlabAlignment) std::atomic<u32> fresh {0};
+
+    static u32 SlabShift(const size_t firstSlabSize) noexcept {
+        return CAST<u32>(std::countr_zero(std::bit_ceil(std::max<size_t>(firstSlabSize, 1))));
     }
 
-    inline bool WriteAllBytes(const Path& filename, const Vector<u8>& bytes) {
-        std::ofstream outfile(filename, std::ios::binary);
-        if (!outfile.is_open()) {
-            return false;
+    static u32 Link(const u64 head) noexcept {
+        return CAST<u32>(head);
+    }
+
+    static u64 NextTag(const u64 head) noexcept {
+        return ((head >> 32) + 1) << 32;
+    }
+
+    static u32 LoadNext(Slot* slot) noexcept {
+        if constexpr (Concurrent) {
+            return std::atomic_ref(slot->next).load(std::memory_order_relaxed);
+        } else {
+            return slot->next;
         }
+    }
 
-        outfile.write(RCAST<const char*>(bytes.data()), CAST<std::streamsize>(bytes.size()));
-        outfile.close();
+    static void StoreNext(Slot* slot, const u32 next) noexcept {
+        if constexpr (Concurrent) {
+            std::atomic_ref(slot->next).store(next, std::memory_order_relaxed);
+        } else {
+            slot->next = next;
+        }
+    }
 
-        return true;
+    Slot* SlotAt(const u32 index) {
+        const u64 scaled = (CAST<u64>(index) >> slabShift) + 1;
+        const u32 slab   = CAST<u32>(std::bit_width(scaled) - 1);
+        const u64 base   = ((u64 {1} << slab) - 1) << slabShift;
+        Slot* memory     = slabs[slab].load(std::memory_order_acquire);
+        if (!memory) {
+            memory = AllocateSlab(slab);
+        }
+
+        return memory + (index - base);
     }
 
-    inline bool WriteAllLines(const Path& filename, const Vector<str>& lines) {
-        std::ofstream outfile(filename);
-        if (!outfile.is_open()) {
-            return false;
+    Slot* AllocateSlab(const u32 slab) {
+        const size_t count = (size_t {1} << slabShift) << slab;
+        auto* memory =
+          CAST<Slot*>(::operator new(count * sizeof(Slot), std::align_val_t {kAlignment}));
+
+        Slot* expected = nullptr;
+        if (!slabs[slab].compare_exchange_strong(
+              expected, memory, std::memory_order_acq_rel, std::memory_order_acquire)) {
+            // Another thread installed this slab first.
+            ::operator delete(memory, std::align_val_t {kAlignment});
+            return expected;
         }
 
-        for (const auto& line : lines) {
-            outfile << line << std::endl;
+        return memory;
+    }
+};
+
+template<class T, bool Concurrent = false>
+struct PoolDeleter {
+    Pool<T, Concurrent>* pool = nullptr;
+
+    void operator()(T* object) const noexcept {
+        pool->Delete(object);
+    }
+};
+
+// Standard allocator whose single-element allocations come from a process-wide concurrent
+// Pool per type; used for shared_ptr control blocks and node-based containers.
+template<class T>
+class PoolAllocator {
+public:
+    using value_type = T;
+
+    PoolAllocator() noexcept = default;
+
+    template<class U>
+    PoolAllocator(const PoolAllocator<U>&) noexcept {}
+
+    [[nodiscard]] T* allocate(const size_t count) {
+        if (count == 1) {
+            return CAST<T*>(SharedPool().Allocate());
         }
 
-        outfile.close();
+        return CAST<T*>(::operator new(count * sizeof(T), std::align_val_t {alignof(T)}));
+    }
+
+    void deallocate(T* memory, const size_t count) noexcept {
+        if (count == 1) {
+            SharedPool().Deallocate(memory);
+        } else {
+            ::operator delete(memory, std::align_val_t {alignof(T)});
+        }
+    }
 
+    template<class U>
+    bool operator==(const PoolAllocator<U>&) const noexcept {
         return true;
     }
-}  // namespace IO
 
-#if defined(_WIN32) || defined(_WIN64)
+private:
+    // Never destroyed, so objects released during static destruction stay valid.
+    static Pool<T, true>& SharedPool() {
+        static auto* pool = new Pool<T, true>();
+        return *pool;
+    }
+};
 
-    #pragma warning(disable : 4996)
-    #define WIN32_LEAN_AND_MEAN
-    #include <Windows.h>
-    #include <codecvt>
+template<class T, bool Concurrent, class... Args>
+Unique<T, PoolDeleter<T, Concurrent>> MakePooledUnique(Pool<T, Concurrent>& pool, Args&&... args) {
+    return Unique<T, PoolDeleter<T, Concurrent>>(pool.New(std::forward<Args>(args)...),
+                                                  PoolDeleter<T, Concurrent> {&pool});
+}
 
-namespace WindowsAPI {
-    inline std::string GetHResultErrorMessage(HRESULT hr) {
-        char* errorMsg = nullptr;
-        FormatMessageA(FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM |
-                         FORMAT_MESSAGE_IGNORE_INSERTS,
-                       nullptr,
-                       hr,
-                       MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT),
-                       RCAST<LPSTR>(&errorMsg),
-                       0,
-                       nullptr);
-
-        std::string errorString;
-        if (errorMsg) {
-            errorString = errorMsg;
-            LocalFree(errorMsg);
-        } else {
-            errorString = "Unknown error";
+// The control block is pooled too. Use a concurrent pool if the last reference may be dropped
+// on another thread.
+template<class T, bool Concurrent, class... Args>
+Shared<T> MakePooledShared(Pool<T, Concurrent>& pool, Args&&... args) {
+    return Shared<T>(pool.New(std::forward<Args>(args)...),
+                     PoolDeleter<T, Concurrent> {&pool},
+                     PoolAllocator<T> {});
+}
+
+// std::vector work-alike that keeps up to N elements inline and only spills to the heap beyond
+// that. Growth, iterator invalidation and exception safety follow std::vector, except that
+// moving an inline SmallVector moves its elements individually.
+template<class T, size_t N = 8>
+class SmallVector {
+    static_assert(N > 0, "use Vector for containers without inline storage");
+
+public:
+    using value_type             = T;
+    using size_type              = size_t;
+    using difference_type        = std::ptrdiff_t;
+    using reference              = T&;
+    using const_reference        = const T&;
+    using pointer                = T*;
+    using const_pointer          = const T*;
+    using iterator               = T*;
+    using const_iterator         = const T*;
+    using reverse_iterator       = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+    SmallVector() noexcept = default;
+
+    explicit SmallVector(const size_t size) {
+        resize(size);
+    }
+
+    SmallVector(const size_t size, const T& value) {
+        assign(size, value);
+    }
+
+    SmallVector(std::initializer_list<T> values) {
+        assign(values.begin(), values.end());
+    }
+
+    template<std::input_iterator Iterator>
+    SmallVector(Iterator first, Iterator last) {
+        assign(first, last);
+    }
+
+    SmallVector(const SmallVector& other) {
+        assign(other.begin(), other.end());
+    }
+
+    SmallVector(SmallVector&& other) noexcept(std::is_nothrow_move_constructible_v<T>) {
+        TakeFrom(other);
+    }
+
+    ~SmallVector() {
+        clear();
+        FreeHeap();
+    }
+
+    SmallVector& operator=(const SmallVector& other) {
+        if (this != &other) {
+            assign(other.begin(), other.end());
         }
 
-        return errorString;
+        return *this;
     }
 
-    class ComError final : public std::exception {
-    public:
-        explicit ComError(HRESULT hr) noexcept : result(hr) {}
+    SmallVector& operator=(SmallVector&& other) noexcept(std::is_nothrow_move_constructible_v<T>) {
+        if (this != &other) {
+            clear();
+            FreeHeap();
+            TakeFrom(other);
+        }
 
-        [[nodiscard]] const char* what() const noexcept override {
-            static char errMsg[256] = {};
-            sprintf_s(errMsg,
-                      "Failure with HRESULT of %08X.\nError: %s\n",
-                      CAST<u32>(result),
-                      GetHResultErrorMessage(result).c_str());
-            return errMsg;
+        return *this;
+    }
+
+    SmallVector& operator=(std::initializer_list<T> values) {
+        assign(values.begin(), values.end());
+        return *this;
+    }
+
+    void assign(const size_t size, const T& value) {
+        // value may be one of the elements about to be destroyed.
+        const T copy(value);
+        clear();
+        reserve(size);
+        std::uninitialized_fill_n(elements, size, copy);
+        count = size;
+    }
+
+    template<std::input_iterator Iterator>
+    void assign(Iterator first, Iterator last) {
+        if (!empty() && MayAlias(first, last)) {
+            SmallVector staged(first, last);
+            *this = std::move(staged);
+            return;
         }
 
-    private:
-        HRESULT result;
-    };
+        clear();
+        if constexpr (std::forward_iterator<Iterator>) {
+            reserve(CAST<size_t>(std::distance(first, last)));
+        }
 
-    inline void ThrowIfFailed(HRESULT hr) {
-        if (FAILED(hr)) {
-            throw ComError(hr);
+        for (; first != last; ++first) {
+            emplace_back(*first);
         }
     }
 
-    enum class AlertSeverity : u32 {
-        Info    = MB_ICONINFORMATION | MB_OK,
-        Warning = MB_ICONWARNING | MB_OK,
-        Error   = MB_ICONERROR | MB_OK,
-    };
+    [[nodiscard]] T& operator[](const size_t index) noexcept {
+        return elements[index];
+    }
 
-    inline void ShowMessage(const str& message,
-                            const AlertSeverity severity,
-                            const str& caption = "Alert",
-                            HWND window        = nullptr) {
-        ::MessageBoxA(window, message.c_str(), caption.c_str(), CAST<u32>(severity));
+    [[nodiscard]] const T& operator[](const size_t index) const noexcept {
+        return elements[index];
     }
 
-    inline void WideToANSI(const wstr& value, str& converted) {
-        std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> converter;
-        converted = converter.to_bytes(value);
+    [[nodiscard]] T& at(const size_t index) {
+        if (index >= count) {
+            throw std::out_of_range("SmallVector::at");
+        }
+
+        return elements[index];
     }
 
-    inline void ANSIToWide(const str& value, wstr& converted) {
-        std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> converter;
-        converted = converter.from_bytes(value);
+    [[nodiscard]] const T& at(const size_t index) const {
+        return const_cast<SmallVector*>(this)->at(index);
     }
-}  // namespace WindowsAPI
-#endif
 
-namespace Math {
-    template<typename T>
-    concept FiniteFloat = std::floating_point<T> && requires(T value) {
-        { std::isfinite(value) } -> std::convertible_to<bool>;
-    };
+    [[nodiscard]] T& front() noexcept {
+        return elements[0];
+    }
 
-    template<FiniteFloat T>
-    T Lerp(T a, T b, f64 t) {
-        if (a == b) {
-            return a;
+    [[nodiscard]] const T& front() const noexcept {
+        return elements[0];
+    }
+
+    [[nodiscard]] T& back() noexcept {
+        return elements[count - 1];
+    }
+
+    [[nodiscard]] const T& back() const noexcept {
+        return elements[count - 1];
+    }
+
+    [[nodiscard]] T* data() noexcept {
+        return elements;
+    }
+
+    [[nodiscard]] const T* data() const noexcept {
+        return elements;
+    }
+
+    [[nodiscard]] iterator begin() noexcept {
+        return elements;
+    }
+
+    [[nodiscard]] const_iterator begin() const noexcept {
+        return elements;
+    }
+
+    [[nodiscard]] const_iterator cbegin() const noexcept {
+        return elements;
+    }
+
+    [[nodiscard]] iterator end() noexcept {
+        return elements + count;
+    }
+
+    [[nodiscard]] const_iterator end() const noexcept {
+        return elements + count;
+    }
+
+    [[nodiscard]] const_iterator cend() const noexcept {
+        return elements + count;
+    }
+
+    [[nodiscard]] reverse_iterator rbegin() noexcept {
+        return reverse_iterator(end());
+    }
+
+    [[nodiscard]] const_reverse_iterator rbegin() const noexcept {
+        return const_reverse_iterator(end());
+    }
+
+    [[nodiscard]] reverse_iterator rend() noexcept {
+        return reverse_iterator(begin());
+    }
+
+    [[nodiscard]] const_reverse_iterator rend() const noexcept {
+        return const_reverse_iterator(begin());
+    }
+
+    [[nodiscard]] bool empty() const noexcept {
+        return count == 0;
+    }
+
+    [[nodiscard]] size_t size() const noexcept {
+        return count;
+    }
+
+    [[nodiscard]] size_t capacity() const noexcept {
+        return reserved;
+    }
+
+    [[nodiscard]] static constexpr size_t max_size() noexcept {
+        return std::numeric_limits<size_t>::max() / sizeof(T);
+    }
+
+    // True while the elements still live in the inline buffer.
+    [[nodiscard]] bool IsInline() const noexcept {
+        return elements == Inline();
+    }
+
+    void reserve(const size_t capacity) {
+        if (capacity > reserved) {
+            Reallocate(capacity);
         }
+    }
 
-        auto result = a * (1.0 - t) + b * t;
-        return CAST<T>(result);
+    void shrink_to_fit() {
+        if (!IsInline() && count < reserved) {
+            Reallocate(count);
+        }
     }
-}  // namespace Math
 
-namespace Color {
-    inline void HexToRGBA(const u32 hex, f32& r, f32& g, f32& b, f32& a) {
-        const u8 alphaByte = (hex >> 24) & 0xFF;
-        const u8 redByte   = (hex >> 16) & 0xFF;
-        const u8 greenByte = (hex >> 8) & 0xFF;
-        const u8 blueByte  = hex & 0xFF;
+    void clear() noexcept {
+        std::destroy_n(elements, count);
+        count = 0;
+    }
+
+    template<class... Args>
+    T& emplace_back(Args&&... args) {
+        if (count < reserved) {
+            std::construct_at(elements + count, std::forward<Args>(args)...);
+        } else {
+            // Build the new element before moving the old ones; args may refer into them.
+            const size_t capacity = Grown(count + 1);
+            T* memory             = Allocate(capacity);
+            try {
+                std::construct_at(memory + count, std::forward<Args>(args)...);
+            } catch (...) {
+                Free(memory);
+                throw;
+            }
+
+            try {
+                Adopt(memory, capacity);
+            } catch (...) {
+                std::destroy_at(memory + count);
+                Free(memory);
+                throw;
+            }
+        }
 
-        a = CAST<f32>(CAST<u32>(alphaByte) / 255.0);
-        r = CAST<f32>(CAST<u32>(redByte) / 255.0);
-        g = CAST<f32>(CAST<u32>(greenByte) / 255.0);
-        b = CAST<f32>(CAST<u32>(blueByte) / 255.0);
+        return elements[count++];
     }
 
-    inline void HexToRGBA(const u32 hex, u32& r, u32& g, u32& b, u32& a) {
-        const u8 alphaByte = (hex >> 24) & 0xFF;
-        const u8 redByte   = (hex >> 16) & 0xFF;
-        const u8 greenByte = (hex >> 8) & 0xFF;
-        const u8 blueByte  = hex & 0xFF;
+    void push_back(const T& value) {
+        emplace_back(value);
+    }
 
-        a = CAST<u32>(alphaByte);
-        r = CAST<u32>(redByte);
-        g = CAST<u32>(greenByte);
-        b = CAST<u32>(blueByte);
+    void push_back(T&& value) {
+        emplace_back(std::move(value));
     }
 
-    inline u32 RGBAToHex(const f32 r, const f32 g, const f32 b, const f32 a) {
-        const auto redByte   = CAST<u8>(r * 255.0f);
-        const auto greenByte = CAST<u8>(g * 255.0f);
-        const auto blueByte  = CAST<u8>(b * 255.0f);
-        const auto alphaByte = CAST<u8>(a * 255.0f);
+    void pop_back() noexcept {
+        std::destroy_at(elements + --count);
+    }
 
-        return (alphaByte << 24) | (redByte << 16) | (greenByte << 8) | blueByte;
+    template<class... Args>
+    iterator emplace(const_iterator position, Args&&... args) {
+        const auto offset = position - begin();
+        emplace_back(std::forward<Args>(args)...);
+        std::rotate(begin() + offset, end() - 1, end());
+        return begin() + offset;
+    }
+
+    iterator insert(const_iterator position, const T& value) {
+        return emplace(position, value);
+    }
+
+    iterator insert(const_iterator position, T&& value) {
+        return emplace(position, std::move(value));
+    }
+
+    template<std::input_iterator Iterator>
+    iterator insert(const_iterator position, Iterator first, Iterator last) {
+        const auto offset   = position - begin();
+        const size_t before = count;
+        for (; first != last; ++first) {
+            emplace_back(*first);
+        }
+
+        std::rotate(begin() + offset, begin() + before, end());
+        return begin() + offset;
+    }
+
+    iterator erase(const_iterator position) {
+        return erase(position, position + 1);
+    }
+
+    iterator erase(const_iterator first, const_iterator last) {
+        T* target = begin() + (first - begin());
+        if (first != last) {
+            T* tail = std::move(begin() + (last - begin()), end(), target);
+            std::destroy(tail, end());
+            count = CAST<size_t>(tail - elements);
+        }
+
+        return target;
+    }
+
+    void resize(const size_t size) {
+        if (size < count) {
+            std::destroy(elements + size, end());
+            count = size;
+            return;
+        }
+
+        reserve(size);
+        std::uninitialized_value_construct(end(), elements + size);
+        count = size;
+    }
+
+    void resize(const size_t size, const T& value) {
+        if (size < count) {
+            resize(size);
+            return;
+        }
+
+        while (count < size) {
+            emplace_back(value);
+        }
+    }
+
+    void swap(SmallVector& other) noexcept(std::is_nothrow_move_constructible_v<T>) {
+        SmallVector temporary(std::move(other));
+        other = std::move(*this);
+        *this = std::move(temporary);
+    }
+
+    friend bool operator==(const SmallVector& lhs, const SmallVector& rhs) {
+        return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end());
+    }
+
+    friend auto operator<=>(const SmallVector& lhs, const SmallVector& rhs)
+        requires std::three_way_comparable<T>
+    {
+        return std::lexicographical_compare_three_way(
+          lhs.begin(), lhs.end(), rhs.begin(), rhs.end());
+    }
+
+private:
+    T* elements     = Inline();
+    size_t count    = 0;
+    size_t reserved = N;
+    alignas(T) std::byte buffer[N * sizeof(T)];
+
+    T* Inline() noexcept {
+        return RCAST<T*>(buffer);
+    }
+
+    const T* Inline() const noexcept {
+        return RCAST<const T*>(buffer);
+    }
+
+    [[nodiscard]] size_t Grown(const size_t minimum) const {
+        if (minimum > max_size()) {
+            throw std::length_error("SmallVector");
+        }
+
+        return std::max(minimum, reserved > max_size() / 2 ? max_size() : reserved * 2);
+    }
+
+    static T* Allocate(const size_t capacity) {
+        return CAST<T*>(::operator new(capacity * sizeof(T), std::align_val_t {alignof(T)}));
+    }
+
+    static void Free(T* memory) noexcept {
+        ::operator delete(memory, std::align_val_t {alignof(T)});
+    }
+
+    void FreeHeap() noexcept {
+        if (!IsInline()) {
+            Free(elements);
+        }
+
+        elements = Inline();
+        reserved = N;
+    }
+
+    // Whether [first, last) might refer to this vector's elements. Only contiguous ranges can be
+    // ruled out by address.
+    template<class Iterator>
+    [[nodiscard]] bool MayAlias(const Iterator first, const Iterator last) const noexcept {
+        if constexpr (std::contiguous_iterator<Iterator>) {
+            if (first == last) {
+                return false;
+            }
+
+            const std::less<const void*> before;
+            const void* rangeBegin = std::to_address(first);
+            const void* rangeEnd   = std::to_address(first) + (last - first);
+            return before(rangeBegin, end()) && before(begin(), rangeEnd);
+        } else {
+            return true;
+        }
+    }
+
+    // Builds count elements at destination from source, moving them unless a throwing move
+    // could be avoided by copying, as std::vector does. On failure source is left intact.
+    static void Relocate(T* source, const size_t count, T* destination) {
+        if constexpr (std::is_nothrow_move_constructible_v<T> ||
+                      !std::is_copy_constructible_v<T>) {
+            std::uninitialized_move(source, source + count, destination);
+        } else {
+            std::uninitialized_copy(source, source + count, destination);
+        }
+    }
+
+    // Moves the current elements into memory (which already holds anything built past them)
+    // and makes it the active buffer. Leaves the vector unchanged if that throws.
+    void Adopt(T* memory, const size_t capacity) {
+        Relocate(elements, count, memory);
+        std::destroy_n(elements, count);
+        if (!IsInline()) {
+            Free(elements);
+        }
+
+        elements = memory;
+        reserved = capacity;
+    }
+
+    void Reallocate(const size_t capacity) {
+        if (capacity <= N) {
+            if (!IsInline()) {
+                T* heap = elements;
+                Relocate(heap, count, Inline());
+                std::destroy_n(heap, count);
+                Free(heap);
+                elements = Inline();
+                reserved = N;
+            }
+
+            return;
+        }
+
+        T* memory = Allocate(capacity);
+        try {
+            Adopt(memory, capacity);
+        } catch (...) {
+            Free(memory);
+            throw;
+        }
+    }
+
+    void TakeFrom(SmallVector& other) {
+        if (other.IsInline()) {
+            std::uninitialized_move(other.begin(), other.end(), Inline());
+            count = other.count;
+            other.clear();
+        } else {
+            elements       = other.elements;
+            count          = other.count;
+            reserved       = other.reserved;
+            other.elements = other.Inline();
+            other.count    = 0;
+            other.reserved = N;
+        }
+    }
+};
+
+// Fixed-capacity, null-terminated string of at most N characters that never allocates.
+// Mirrors the std::string members that make sense without growth; exceeding the capacity
+// throws std::length_error.
+template<size_t N>
+class InlineString {
+    using Length = std::conditional_t<(N < 256), u8, std::conditional_t<(N < 65536), u16, u32>>;
+
+public:
+    using value_type      = char;
+    using size_type       = size_t;
+    using iterator        = char*;
+    using const_iterator  = const char*;
+    using traits_type     = std::char_traits<char>;
+
+    static constexpr auto npos = std::string_view::npos;
+
+    constexpr InlineString() noexcept = default;
+
+    constexpr InlineString(const char* text) : InlineString(std::string_view(text)) {}
+
+    constexpr InlineString(const std::string_view text) {
+        assign(text);
+    }
+
+    constexpr InlineString(const size_t size, const char character) {
+        resize(size, character);
+    }
+
+    // Explicit so that an accidental conversion can't throw on long input.
+    explicit InlineString(const str& text) : InlineString(std::string_view(text)) {}
+
+    constexpr InlineString& operator=(const std::string_view text) {
+        return assign(text);
+    }
+
+    constexpr InlineString& operator=(const char* text) {
+        return assign(std::string_view(text));
+    }
+
+    constexpr InlineString& assign(const std::string_view text) {
+        CheckLength(text.size());
+        std::copy(text.begin(), text.end(), chars);
+        SetLength(text.size());
+        return *this;
+    }
+
+    [[nodiscard]] constexpr char& operator[](const size_t index) noexcept {
+        return chars[index];
+    }
+
+    [[nodiscard]] constexpr const char& operator[](const size_t index) const noexcept {
+        return chars[index];
+    }
+
+    [[nodiscard]] constexpr char& at(const size_t index) {
+        if (index >= count) {
+            throw std::out_of_range("InlineString::at");
+        }
+
+        return chars[index];
+    }
+
+    [[nodiscard]] constexpr const char& at(const size_t index) const {
+        return const_cast<InlineString*>(this)->at(index);
+    }
+
+    [[nodiscard]] constexpr char& front() noexcept {
+        return chars[0];
+    }
+
+    [[nodiscard]] constexpr char front() const noexcept {
+        return chars[0];
+    }
+
+    [[nodiscard]] constexpr char& back() noexcept {
+        return chars[count - 1];
+    }
+
+    [[nodiscard]] constexpr char back() const noexcept {
+        return chars[count - 1];
+    }
+
+    [[nodiscard]] constexpr char* data() noexcept {
+        return chars;
+    }
+
+    [[nodiscard]] constexpr const char* data() const noexcept {
+        return chars;
+    }
+
+    [[nodiscard]] constexpr const char* c_str() const noexcept {
+        return chars;
+    }
+
+    [[nodiscard]] constexpr iterator begin() noexcept {
+        return chars;
+    }
+
+    [[nodiscard]] constexpr const_iterator begin() const noexcept {
+        return chars;
+    }
+
+    [[nodiscard]] constexpr iterator end() noexcept {
+        return chars + count;
+    }
+
+    [[nodiscard]] constexpr const_iterator end() const noexcept {
+        return chars + count;
+    }
+
+    [[nodiscard]] constexpr bool empty() const noexcept {
+        return count == 0;
+    }
+
+    [[nodiscard]] constexpr size_t size() const noexcept {
+        return count;
+    }
+
+    [[nodiscard]] constexpr size_t length() const noexcept {
+        return count;
+    }
+
+    [[nodiscard]] static constexpr size_t capacity() noexcept {
+        return N;
+    }
+
+    [[nodiscard]] static constexpr size_t max_size() noexcept {
+        return N;
+    }
+
+    constexpr void clear() noexcept {
+        SetLength(0);
+    }
+
+    constexpr void push_back(const char character) {
+        CheckLength(count + 1);
+        chars[count] = character;
+        SetLength(count + 1u);
+    }
+
+    constexpr void pop_back() noexcept {
+        SetLength(count - 1u);
+    }
+
+    constexpr InlineString& append(const std::string_view text) {
+        CheckLength(count + text.size());
+        std::copy(text.begin(), text.end(), chars + count);
+        SetLength(count + text.size());
+        return *this;
+    }
+
+    constexpr InlineString& append(const size_t repeat, const char character) {
+        CheckLength(count + repeat);
+        std::fill_n(chars + count, repeat, character);
+        SetLength(count + repeat);
+        return *this;
+    }
+
+    constexpr InlineString& operator+=(const std::string_view text) {
+        return append(text);
+    }
+
+    constexpr InlineString& operator+=(const char character) {
+        push_back(character);
+        return *this;
+    }
+
+    constexpr void resize(const size_t size, const char character = '\0') {
+        CheckLength(size);
+        if (size > count) {
+            std::fill(chars + count, chars + size, character);
+        }
+
+        SetLength(size);
+    }
+
+    [[nodiscard]] constexpr InlineString substr(const size_t position = 0,
+                                                const size_t size     = npos) const {
+        return InlineString(View().substr(position, size));
+    }
+
+    [[nodiscard]] constexpr size_t find(const std::string_view text,
+                                        const size_t position = 0) const noexcept {
+        return View().find(text, position);
+    }
+
+    [[nodiscard]] constexpr size_t find(const char character,
+                                        const size_t position = 0) const noexcept {
+        return View().find(character, position);
+    }
+
+    [[nodiscard]] constexpr size_t rfind(const std::string_view text,
+                                         const size_t position = npos) const noexcept {
+        return View().rfind(text, position);
+    }
+
+    [[nodiscard]] constexpr bool starts_with(const std::string_view text) const noexcept {
+        return View().starts_with(text);
+    }
+
+    [[nodiscard]] constexpr bool ends_with(const std::string_view text) const noexcept {
+        return View().ends_with(text);
+    }
+
+    [[nodiscard]] constexpr int compare(const std::string_view text) const noexcept {
+        return View().compare(text);
+    }
+
+    [[nodiscard]] constexpr std::string_view View() const noexcept {
+        return {chars, count};
+    }
+
+    constexpr operator std::string_view() const noexcept {
+        return View();
+    }
+
+    [[nodiscard]] str ToString() const {
+        return str(View());
+    }
+
+    friend constexpr bool operator==(const InlineString& lhs, const std::string_view rhs) noexcept {
+        return lhs.View() == rhs;
+    }
+
+    friend constexpr auto operator<=>(const InlineString& lhs,
+                                      const std::string_view rhs) noexcept {
+        return lhs.View() <=> rhs;
+    }
+
+private:
+    Length count = 0;
+    char chars[N + 1] {};
+
+    static constexpr void CheckLength(const size_t size) {
+        if (size > N) {
+            throw std::length_error("InlineString capacity exceeded");
+        }
+    }
+
+    constexpr void SetLength(const size_t size) noexcept {
+        count      = CAST<Length>(size);
+        chars[size] = '\0';
+    }
+};
+
+template<size_t N>
+struct std::hash<InlineString<N>> {
+    size_t operator()(const InlineString<N>& text) const noexcept {
+        return std::hash<std::string_view> {}(text.View());
+    }
+};
+
+constexpr auto Inf32 = std::numeric_limits<float>::infinity();
+constexpr auto Inf64 = std::numeric_limits<double>::infinity();
+
+// CPU feature detection and kernel selection. Features are read once, on first use, from cpuid
+// on x86, from the auxiliary vector or IsProcessorFeaturePresent on ARM64. Kernels built with
+// RIEGER_TARGET are picked through Select and kept in a static, so hot paths call a resolved
+// pointer instead of checking features on every call.
+namespace Cpu {
+    enum class Feature : u32 {
+        Sse2     = 1u << 0,
+        Sse42    = 1u << 1,
+        Avx2     = 1u << 2,
+        Fma      = 1u << 3,
+        Bmi2     = 1u << 4,
+        Avx512F  = 1u << 5,
+        Avx512BW = 1u << 6,
+        Neon     = 1u << 7,
+        Crc32    = 1u << 8,
+    };
+
+    constexpr Feature operator|(const Feature a, const Feature b) noexcept {
+        return CAST<Feature>(CAST<u32>(a) | CAST<u32>(b));
+    }
+
+    // The tiers the batch kernels come in. The x86 tiers are ordered, so >= compares capability.
+    enum class SimdLevel { Scalar, Sse2, Avx2, Avx512, Neon };
+
+    namespace Detail {
+        inline u32 Detect() noexcept {
+            u32 features = 0;
+            const auto set = [&](const Feature feature, const bool present) {
+                features |= present ? CAST<u32>(feature) : 0;
+            };
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+    #if defined(_MSC_VER) && !defined(__clang__)
+            int info[4];
+            __cpuid(info, 0);
+            const int maxLeaf = info[0];
+            __cpuid(info, 1);
+            set(Feature::Sse2, (info[3] & (1 << 26)) != 0);
+            set(Feature::Sse42, (info[2] & (1 << 20)) != 0);
+            // AVX state must also be enabled by the OS, which XCR0 reports.
+            const bool osxsave = (info[2] & (1 << 27)) != 0;
+            const u64 xcr0     = osxsave ? _xgetbv(0) : 0;
+            const bool ymm     = (xcr0 & 0x6) == 0x6;
+            const bool zmm     = (xcr0 & 0xE6) == 0xE6;
+            set(Feature::Fma, ymm && (info[2] & (1 << 12)) != 0);
+            if (maxLeaf >= 7) {
+                __cpuidex(info, 7, 0);
+                set(Feature::Avx2, ymm && (info[1] & (1 << 5)) != 0);
+                set(Feature::Bmi2, (info[1] & (1 << 8)) != 0);
+                set(Feature::Avx512F, zmm && (info[1] & (1 << 16)) != 0);
+                set(Feature::Avx512BW, zmm && (info[1] & (1 << 30)) != 0);
+            }
+    #else
+            __builtin_cpu_init();
+            set(Feature::Sse2, __builtin_cpu_supports("sse2"));
+            set(Feature::Sse42, __builtin_cpu_supports("sse4.2"));
+            set(Feature::Avx2, __builtin_cpu_supports("avx2"));
+            set(Feature::Fma, __builtin_cpu_supports("fma"));
+            set(Feature::Bmi2, __builtin_cpu_supports("bmi2"));
+            set(Feature::Avx512F, __builtin_cpu_supports("avx512f"));
+            set(Feature::Avx512BW, __builtin_cpu_supports("avx512bw"));
+    #endif
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+            set(Feature::Neon, true);
+    #if defined(__ARM_FEATURE_CRC32) || defined(__APPLE__)
+            set(Feature::Crc32, true);
+    #elif defined(_WIN32) || defined(_WIN64)
+            set(Feature::Crc32,
+                ::IsProcessorFeaturePresent(PF_ARM_V8_CRC32_INSTRUCTIONS_AVAILABLE) != 0);
+    #elif defined(__linux__) && defined(__aarch64__)
+            set(Feature::Crc32, (::getauxval(AT_HWCAP) & HWCAP_CRC32) != 0);
+    #endif
+#endif
+            (void)set;
+            return features;
+        }
+    }  // namespace Detail
+
+    // Every Feature the CPU and OS support, as a mask of their bits.
+    inline u32 Features() noexcept {
+        static const u32 features = Detail::Detect();
+        return features;
+    }
+
+    // Whether every feature in required is present.
+    inline bool Has(const Feature required) noexcept {
+        return (Features() & CAST<u32>(required)) == CAST<u32>(required);
+    }
+
+    // The widest tier this CPU runs. The AVX2 tier includes FMA, which its kernels rely on.
+    inline SimdLevel ActiveSimd() noexcept {
+        static const SimdLevel level = [] {
+            if (Has(Feature::Avx512F | Feature::Avx2 | Feature::Fma)) {
+                return SimdLevel::Avx512;
+            }
+
+            if (Has(Feature::Avx2 | Feature::Fma)) {
+                return SimdLevel::Avx2;
+            }
+
+            if (Has(Feature::Sse2)) {
+                return SimdLevel::Sse2;
+            }
+
+            return Has(Feature::Neon) ? SimdLevel::Neon : SimdLevel::Scalar;
+        }();
+        return level;
+    }
+
+    // One implementation of a kernel and the features it needs.
+    template<class Kernel>
+    struct Candidate {
+        Feature required;
+        Kernel kernel;
+    };
+
+    // The first candidate whose features are all present, else fallback. List candidates best
+    // first and keep the result in a static: static const auto kernel = Cpu::Select(...);
+    template<class Kernel, size_t Count>
+    Kernel Select(const Candidate<Kernel> (&candidates)[Count], const Kernel fallback) noexcept {
+        for (const auto& candidate : candidates) {
+            if (Has(candidate.required)) {
+                return candidate.kernel;
+            }
+        }
+
+        return fallback;
+    }
+}  // namespace Cpu
+
+// Block compression. LZ4 is built in and emits the standard LZ4 block format, so its output
+// decodes with any LZ4 implementation. Zstd needs libzstd: define RIEGER_USE_ZSTD and link it.
+// Blocks are self-contained; IO::WriteAllBytes with CompressionOptions frames many of them.
+namespace Compression {
+    enum class Codec : u8 {
+        None,
+        LZ4,
+        Zstd,
+    };
+
+    namespace Detail {
+        inline u16 Load16(const u8* source) noexcept {
+            return CAST<u16>(source[0] | (source[1] << 8));
+        }
+
+        inline u32 Load32(const u8* source) noexcept {
+            return CAST<u32>(source[0]) | (CAST<u32>(source[1]) << 8) |
+                   (CAST<u32>(source[2]) << 16) | (CAST<u32>(source[3]) << 24);
+        }
+
+        inline u64 Load64(const u8* source) noexcept {
+            return CAST<u64>(Load32(source)) | (CAST<u64>(Load32(source + 4)) << 32);
+        }
+
+        inline void Store32(u8* target, const u32 value) noexcept {
+            for (size_t i = 0; i < 4; ++i) {
+                target[i] = CAST<u8>(value >> (8 * i));
+            }
+        }
+
+        inline void Store64(u8* target, const u64 value) noexcept {
+            Store32(target, CAST<u32>(value));
+            Store32(target + 4, CAST<u32>(value >> 32));
+        }
+
+        // Native-order loads for match finding, where byte order does not matter.
+        inline u32 Read32(const u8* source) noexcept {
+            u32 value;
+            std::memcpy(&value, source, sizeof(value));
+            return value;
+        }
+
+        inline u64 Read64(const u8* source) noexcept {
+            u64 value;
+            std::memcpy(&value, source, sizeof(value));
+            return value;
+        }
+
+        // Format limits from the LZ4 block specification.
+        inline constexpr size_t kLZ4MinMatch     = 4;
+        inline constexpr size_t kLZ4LastLiterals = 5;
+        inline constexpr size_t kLZ4MatchLimit   = 12;
+        inline constexpr size_t kLZ4MaxOffset    = 65535;
+        inline constexpr size_t kLZ4MaxInput     = 0x7E000000;
+        inline constexpr u32 kLZ4HashLog         = 12;
+
+        inline u32 LZ4Hash(const u32 sequence) noexcept {
+            return (sequence * 2654435761u) >> (32 - kLZ4HashLog);
+        }
+
+        // Bytes in common at a and b, stopping at limit (which bounds b).
+        inline size_t CommonLength(const u8* a, const u8* b, const u8* limit) noexcept {
+            const u8* start = b;
+            while (b + 8 <= limit) {
+                const u64 difference = Read64(a) ^ Read64(b);
+                if (difference != 0) {
+                    const int bit = std::endian::native == std::endian::little
+                                      ? std::countr_zero(difference)
+                                      : std::countl_zero(difference);
+                    return CAST<size_t>(b - start) + CAST<size_t>(bit / 8);
+                }
+
+                a += 8;
+                b += 8;
+            }
+
+            while (b < limit && *a == *b) {
+                ++a;
+                ++b;
+            }
+
+            return CAST<size_t>(b - start);
+        }
+
+        // Appends one sequence: literals, then (unless last) a match of matchLength at offset.
+        // Returns the new output cursor or nullptr if it would pass end.
+        inline u8* LZ4Sequence(u8* out,
+                               u8* const end,
+                               const u8* literals,
+                               const size_t literalLength,
+                               const size_t offset,
+                               const size_t matchLength) noexcept {
+            const size_t matchCode = matchLength == 0 ? 0 : matchLength - kLZ4MinMatch;
+            const size_t needed =
+              1 + literalLength / 255 + 1 + literalLength + 2 + matchCode / 255 + 1;
+            if (CAST<size_t>(end - out) < needed) {
+                return nullptr;
+            }
+
+            u8* token = out++;
+            *token    = CAST<u8>(std::min<size_t>(literalLength, 15) << 4);
+            if (literalLength >= 15) {
+                size_t rest = literalLength - 15;
+                for (; rest >= 255; rest -= 255) {
+                    *out++ = 255;
+                }
+
+                *out++ = CAST<u8>(rest);
+            }
+
+            if (literalLength > 0) {
+                std::memcpy(out, literals, literalLength);
+            }
+
+            out += literalLength;
+            if (matchLength == 0) {
+                return out;
+            }
+
+            *out++ = CAST<u8>(offset);
+            *out++ = CAST<u8>(offset >> 8);
+            *token |= CAST<u8>(std::min<size_t>(matchCode, 15));
+            if (matchCode >= 15) {
+                size_t rest = matchCode - 15;
+                for (; rest >= 255; rest -= 255) {
+                    *out++ = 255;
+                }
+
+                *out++ = CAST<u8>(rest);
+            }
+
+            return out;
+        }
+
+        // Greedy single-probe match finder, the same strategy as LZ4's default fast mode.
+        inline Option<size_t> LZ4Compress(const std::span<const u8> source,
+                                          const std::span<u8> destination) noexcept {
+            const u8* const base = source.data();
+            const size_t size    = source.size();
+            u8* out              = destination.data();
+            u8* const end        = out + destination.size();
+            const u8* anchor     = base;
+            if (size > kLZ4MaxInput) {
+                return kNone;
+            }
+
+            if (size > kLZ4MatchLimit) {
+                u32 table[1u << kLZ4HashLog] {};
+                const u8* const matchEnd   = base + size - kLZ4LastLiterals;
+                const u8* const lastSearch = base + size - kLZ4MatchLimit;
+
+                const u8* cursor = base;
+                while (cursor <= lastSearch) {
+                    const u32 hash = LZ4Hash(Read32(cursor));
+                    const u8* ref  = base + table[hash];
+                    table[hash]    = CAST<u32>(cursor - base);
+                    if (ref >= cursor || CAST<size_t>(cursor - ref) > kLZ4MaxOffset ||
+                        Read32(ref) != Read32(cursor)) {
+                        cursor += 1 + (CAST<size_t>(cursor - anchor) >> 6);
+                        continue;
+                    }
+
+                    while (cursor > anchor && ref > base && cursor[-1] == ref[-1]) {
+                        --cursor;
+                        --ref;
+                    }
+
+                    const size_t length =
+                      kLZ4MinMatch +
+                      CommonLength(ref + kLZ4MinMatch, cursor + kLZ4MinMatch, matchEnd);
+                    out = LZ4Sequence(out,
+                                      end,
+                                      anchor,
+                                      CAST<size_t>(cursor - anchor),
+                                      CAST<size_t>(cursor - ref),
+                                      length);
+                    if (!out) {
+                        return kNone;
+                    }
+
+                    cursor += length;
+                    anchor = cursor;
+                    if (cursor <= lastSearch) {
+                        table[LZ4Hash(Read32(cursor - 2))] = CAST<u32>(cursor - 2 - base);
+                    }
+                }
+            }
+
+            out = LZ4Sequence(out, end, anchor, CAST<size_t>(base + size - anchor), 0, 0);
+            if (!out) {
+                return kNone;
+            }
+
+            return CAST<size_t>(out - destination.data());
+        }
+
+        // Copies length bytes in 16-byte steps, so up to 15 bytes past both ends may be read
+        // and written. Callers guarantee that slack and, for matches, a distance of 16 or more.
+        inline void WildCopy(u8* target, const u8* source, const size_t length) noexcept {
+            for (size_t i = 0; i < length; i += 16) {
+                std::memcpy(target + i, source + i, 16);
+            }
+        }
+
+        // Bounds-checked decoder; rejects anything that would read or write out of range.
+        inline Option<size_t> LZ4Decompress(const std::span<const u8> source,
+                                            const std::span<u8> destination) noexcept {
+            const u8* in          = source.data();
+            const u8* const inEnd = in + source.size();
+            u8* out               = destination.data();
+            u8* const outEnd      = out + destination.size();
+
+            const auto readLength = [&](size_t length) -> Option<size_t> {
+                if (length != 15) {
+                    return length;
+                }
+
+                u8 next = 255;
+                while (next == 255) {
+                    if (in == inEnd) {
+                        return kNone;
+                    }
+
+                    next = *in++;
+                    length += next;
+                }
+
+                return length;
+            };
+
+            while (in < inEnd) {
+                const u8 token     = *in++;
+                const auto literal = readLength(token >> 4);
+                if (!literal.has_value() || CAST<size_t>(inEnd - in) < *literal ||
+                    CAST<size_t>(outEnd - out) < *literal) {
+                    return kNone;
+                }
+
+                if (CAST<size_t>(inEnd - in) >= *literal + 16 &&
+                    CAST<size_t>(outEnd - out) >= *literal + 16) {
+                    WildCopy(out, in, *literal);
+                } else if (*literal > 0) {
+                    std::memcpy(out, in, *literal);
+                }
+
+                in += *literal;
+                out += *literal;
+                if (in == inEnd) {
+                    return CAST<size_t>(out - destination.data());
+                }
+
+                if (inEnd - in < 2) {
+                    return kNone;
+                }
+
+                const size_t offset = Load16(in);
+                in += 2;
+                const auto match = readLength(token & 15);
+                if (offset == 0 || offset > CAST<size_t>(out - destination.data()) ||
+                    !match.has_value() || CAST<size_t>(outEnd - out) < *match + kLZ4MinMatch) {
+                    return kNone;
+                }
+
+                const u8* from = out - offset;
+                size_t length  = *match + kLZ4MinMatch;
+                if (offset >= 16 && CAST<size_t>(outEnd - out) >= length + 16) {
+                    WildCopy(out, from, length);
+                    out += length;
+                } else if (offset >= length) {
+                    std::memcpy(out, from, length);
+                    out += length;
+                } else {
+                    // Overlapping copy repeats the last offset bytes.
+                    for (; length > 0; --length) {
+                        *out++ = *from++;
+                    }
+                }
+            }
+
+            return kNone;
+        }
+    }  // namespace Detail
+
+    [[nodiscard]] constexpr bool IsAvailable(const Codec codec) noexcept {
+#if defined(RIEGER_USE_ZSTD)
+        return codec == Codec::None || codec == Codec::LZ4 || codec == Codec::Zstd;
+#else
+        return codec == Codec::None || codec == Codec::LZ4;
+#endif
+    }
+
+    // Worst-case compressed size of size input bytes.
+    [[nodiscard]] inline size_t CompressBound(const Codec codec, const size_t size) noexcept {
+#if defined(RIEGER_USE_ZSTD)
+        if (codec == Codec::Zstd) {
+            return ZSTD_compressBound(size);
+        }
+#endif
+        return codec == Codec::None ? size : size + size / 255 + 16;
+    }
+
+    // Bytes written to destination, or kNone if the codec is unavailable or the output does
+    // not fit. level only applies to Zstd (0 picks its default).
+    inline Option<size_t> Compress(const Codec codec,
+                                   const std::span<const u8> source,
+                                   const std::span<u8> destination,
+                                   [[maybe_unused]] const i32 level = 0) {
+        switch (codec) {
+            case Codec::None:
+                if (destination.size() < source.size()) {
+                    return kNone;
+                }
+
+                std::copy(source.begin(), source.end(), destination.begin());
+                return source.size();
+            case Codec::LZ4:
+                return Detail::LZ4Compress(source, destination);
+            case Codec::Zstd: {
+#if defined(RIEGER_USE_ZSTD)
+                const size_t written = ZSTD_compress(
+                  destination.data(), destination.size(), source.data(), source.size(), level);
+                if (ZSTD_isError(written)) {
+                    return kNone;
+                }
+
+                return written;
+#else
+                return kNone;
+#endif
+            }
+        }
+
+        return kNone;
+    }
+
+    // Bytes written to destination, or kNone for corrupt input, an unavailable codec, or
+    // output that does not fit.
+    inline Option<size_t> Decompress(const Codec codec,
+                                     const std::span<const u8> source,
+                                     const std::span<u8> destination) {
+        switch (codec) {
+            case Codec::None:
+                return Compress(Codec::None, source, destination);
+            case Codec::LZ4:
+                return Detail::LZ4Decompress(source, destination);
+            case Codec::Zstd: {
+#if defined(RIEGER_USE_ZSTD)
+                const size_t written = ZSTD_decompress(
+                  destination.data(), destination.size(), source.data(), source.size());
+                if (ZSTD_isError(written)) {
+                    return kNone;
+                }
+
+                return written;
+#else
+                return kNone;
+#endif
+            }
+        }
+
+        return kNone;
+    }
+
+    inline Option<Vector<u8>>
+    Compress(const Codec codec, const std::span<const u8> source, const i32 level = 0) {
+        Vector<u8> compressed(CompressBound(codec, source.size()));
+        const auto size = Compress(codec, source, compressed, level);
+        if (!size.has_value()) {
+            return kNone;
+        }
+
+        compressed.resize(*size);
+        return compressed;
+    }
+}  // namespace Compression
+
+// Non-cryptographic content hashes. XXH3 is the 64-bit XXH3 of xxHash 0.8 and CRC32C the
+// Castagnoli CRC used by iSCSI and ext4; both match the reference implementations bit for bit.
+// XXH3 runs its 64-byte stripes with SSE2 or NEON, or AVX2 where the CPU has it. CRC32C uses
+// the SSE4.2 crc32 instruction where the CPU has it, or ARMv8 CRC when the build targets it.
+namespace Hash {
+    // Anything IO can hash into while it reads.
+    template<typename T>
+    concept Hasher = requires(T& hasher, std::span<const u8> data) { hasher.Update(data); };
+
+    namespace Detail {
+        inline constexpr u64 kPrime32_1 = 0x9E3779B1;
+        inline constexpr u64 kPrime32_2 = 0x85EBCA77;
+        inline constexpr u64 kPrime32_3 = 0xC2B2AE3D;
+        inline constexpr u64 kPrime64_1 = 0x9E3779B185EBCA87;
+        inline constexpr u64 kPrime64_2 = 0xC2B2AE3D27D4EB4F;
+        inline constexpr u64 kPrime64_3 = 0x165667B19E3779F9;
+        inline constexpr u64 kPrime64_4 = 0x85EBCA77C2B2AE63;
+        inline constexpr u64 kPrime64_5 = 0x27D4EB2F165667C5;
+
+        inline constexpr size_t kStripeLength    = 64;
+        inline constexpr size_t kSecretSize      = 192;
+        inline constexpr size_t kStripesPerBlock = (kSecretSize - kStripeLength) / 8;
+        inline constexpr size_t kBlockLength     = kStripeLength * kStripesPerBlock;
+        inline constexpr size_t kMidSizeMax      = 240;
+        inline constexpr size_t kMergeAccsStart  = 11;
+        inline constexpr size_t kLastAccStart    = 7;
+        inline constexpr size_t kScrambleOffset  = kSecretSize - kStripeLength;
+
+        alignas(64) inline constexpr u8 kSecret[kSecretSize] = {
+          0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21,
+          0xad, 0x1c, 0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4,
+          0xb7, 0xb3, 0x67, 0x1f, 0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a,
+          0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21, 0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e,
+          0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c, 0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3,
+          0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3, 0x71, 0x64, 0x48, 0x97,
+          0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8, 0xa8, 0xfa,
+          0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+          0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78,
+          0x73, 0x64, 0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff,
+          0xfa, 0x13, 0x63, 0xeb, 0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16,
+          0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e, 0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc,
+          0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce, 0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16,
+          0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+        };
+
+        inline constexpr u64 kInitialAcc[8] = {
+          kPrime32_3, kPrime64_1, kPrime64_2, kPrime64_3,
+          kPrime64_4, kPrime32_2, kPrime64_5, kPrime32_1,
+        };
+
+        using Compression::Detail::Load32;
+        using Compression::Detail::Load64;
+        using Compression::Detail::Store64;
+
+        inline u32 ByteSwap32(const u32 value) noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+            return __builtin_bswap32(value);
+#elif defined(_MSC_VER)
+            return _byteswap_ulong(value);
+#else
+            return (value >> 24) | ((value >> 8) & 0xFF00) | ((value << 8) & 0xFF0000) |
+                   (value << 24);
+#endif
+        }
+
+        inline u64 ByteSwap64(const u64 value) noexcept {
+            return (CAST<u64>(ByteSwap32(CAST<u32>(value))) << 32) |
+                   ByteSwap32(CAST<u32>(value >> 32));
+        }
+
+        inline u64 Multiply128Fold(const u64 a, const u64 b) noexcept {
+#if defined(__SIZEOF_INT128__)
+            __extension__ using Wide = unsigned __int128;
+            const Wide product       = CAST<Wide>(a) * b;
+            return CAST<u64>(product) ^ CAST<u64>(product >> 64);
+#elif defined(_M_X64)
+            u64 high;
+            const u64 low = _umul128(a, b, &high);
+            return low ^ high;
+#else
+            const u64 lowLow   = (a & 0xFFFFFFFF) * (b & 0xFFFFFFFF);
+            const u64 highLow  = (a >> 32) * (b & 0xFFFFFFFF);
+            const u64 lowHigh  = (a & 0xFFFFFFFF) * (b >> 32);
+            const u64 highHigh = (a >> 32) * (b >> 32);
+            const u64 cross    = (lowLow >> 32) + (highLow & 0xFFFFFFFF) + lowHigh;
+            const u64 high     = (highLow >> 32) + (cross >> 32) + highHigh;
+            return ((cross << 32) | (lowLow & 0xFFFFFFFF)) ^ high;
+#endif
+        }
+
+        inline u64 XXH64Avalanche(u64 value) noexcept {
+            value ^= value >> 33;
+            value *= kPrime64_2;
+            value ^= value >> 29;
+            value *= kPrime64_3;
+            return value ^ (value >> 32);
+        }
+
+        inline u64 Avalanche(u64 value) noexcept {
+            value ^= value >> 37;
+            value *= 0x165667919E3779F9;
+            return value ^ (value >> 32);
+        }
+
+        inline u64 StrongAvalanche(u64 value, const u64 length) noexcept {
+            value ^= std::rotl(value, 49) ^ std::rotl(value, 24);
+            value *= 0x9FB21C651E98DF25;
+            value ^= (value >> 35) + length;
+            value *= 0x9FB21C651E98DF25;
+            return value ^ (value >> 28);
+        }
+
+        inline u64 Mix16(const u8* input, const u8* secret, const u64 seed) noexcept {
+            return Multiply128Fold(Load64(input) ^ (Load64(secret) + seed),
+                                   Load64(input + 8) ^ (Load64(secret + 8) - seed));
+        }
+
+        inline u64 Hash0To16(const u8* input, const size_t length, u64 seed) noexcept {
+            const u8* secret = kSecret;
+            if (length > 8) {
+                const u64 low =
+                  Load64(input) ^ ((Load64(secret + 24) ^ Load64(secret + 32)) + seed);
+                const u64 high = Load64(input + length - 8) ^
+                                 ((Load64(secret + 40) ^ Load64(secret + 48)) - seed);
+                return Avalanche(length + ByteSwap64(low) + high + Multiply128Fold(low, high));
+            }
+
+            if (length >= 4) {
+                seed ^= CAST<u64>(ByteSwap32(CAST<u32>(seed))) << 32;
+                const u64 combined = Load32(input + length - 4) + (CAST<u64>(Load32(input)) << 32);
+                const u64 flip     = (Load64(secret + 8) ^ Load64(secret + 16)) - seed;
+                return StrongAvalanche(combined ^ flip, length);
+            }
+
+            if (length > 0) {
+                const u32 combined = (CAST<u32>(input[0]) << 16) |
+                                     (CAST<u32>(input[length >> 1]) << 24) |
+                                     CAST<u32>(input[length - 1]) | CAST<u32>(length << 8);
+                const u64 flip = CAST<u64>(Load32(secret) ^ Load32(secret + 4)) + seed;
+                return XXH64Avalanche(combined ^ flip);
+            }
+
+            return XXH64Avalanche(seed ^ Load64(secret + 56) ^ Load64(secret + 64));
+        }
+
+        inline u64 Hash17To128(const u8* input, const size_t length, const u64 seed) noexcept {
+            const u8* secret = kSecret;
+            u64 acc          = length * kPrime64_1;
+            if (length > 32) {
+                if (length > 64) {
+                    if (length > 96) {
+                        acc += Mix16(input + 48, secret + 96, seed);
+                        acc += Mix16(input + length - 64, secret + 112, seed);
+                    }
+
+                    acc += Mix16(input + 32, secret + 64, seed);
+                    acc += Mix16(input + length - 48, secret + 80, seed);
+                }
+
+                acc += Mix16(input + 16, secret + 32, seed);
+                acc += Mix16(input + length - 32, secret + 48, seed);
+            }
+
+            acc += Mix16(input, secret, seed);
+            acc += Mix16(input + length - 16, secret + 16, seed);
+            return Avalanche(acc);
+        }
+
+        inline u64 Hash129To240(const u8* input, const size_t length, const u64 seed) noexcept {
+            constexpr size_t kStartOffset = 3;
+            constexpr size_t kLastOffset  = 136 - 17;
+
+            const u8* secret = kSecret;
+            u64 acc          = length * kPrime64_1;
+            for (size_t i = 0; i < 8; ++i) {
+                acc += Mix16(input + 16 * i, secret + 16 * i, seed);
+            }
+
+            acc = Avalanche(acc);
+            for (size_t i = 8; i < length / 16; ++i) {
+                acc += Mix16(input + 16 * i, secret + 16 * (i - 8) + kStartOffset, seed);
+            }
+
+            acc += Mix16(input + length - 16, secret + kLastOffset, seed);
+            return Avalanche(acc);
+        }
+
+        // Folds stripes 64-byte stripes into acc, stepping 8 bytes through the secret per
+        // stripe. Scramble mixes acc at a block boundary.
+        using AccumulateKernel = void (*)(u64*, const u8*, const u8*, size_t);
+        using ScrambleKernel   = void (*)(u64*, const u8*);
+
+        inline void AccumulateScalar(u64* acc, const u8* input, const u8* secret, size_t stripes) {
+            for (; stripes > 0; --stripes, input += kStripeLength, secret += 8) {
+                for (size_t i = 0; i < 8; ++i) {
+                    const u64 value = Load64(input + 8 * i);
+                    const u64 keyed = value ^ Load64(secret + 8 * i);
+                    acc[i ^ 1] += value;
+                    acc[i] += (keyed & 0xFFFFFFFF) * (keyed >> 32);
+                }
+            }
+        }
+
+        inline void ScrambleScalar(u64* acc, const u8* secret) {
+            for (size_t i = 0; i < 8; ++i) {
+                u64 value = acc[i];
+                value ^= value >> 47;
+                value ^= Load64(secret + 8 * i);
+                acc[i] = value * kPrime32_1;
+            }
+        }
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+        inline void AccumulateSse2(u64* acc, const u8* input, const u8* secret, size_t stripes) {
+            auto* lanes = RCAST<__m128i*>(acc);
+            __m128i sums[4];
+            for (size_t i = 0; i < 4; ++i) {
+                sums[i] = _mm_load_si128(lanes + i);
+            }
+
+            for (; stripes > 0; --stripes, input += kStripeLength, secret += 8) {
+                for (size_t i = 0; i < 4; ++i) {
+                    const __m128i value = _mm_loadu_si128(RCAST<const __m128i*>(input) + i);
+                    const __m128i keyed =
+                      _mm_xor_si128(value, _mm_loadu_si128(RCAST<const __m128i*>(secret) + i));
+                    const __m128i product = _mm_mul_epu32(keyed, _mm_srli_epi64(keyed, 32));
+                    const __m128i swapped = _mm_shuffle_epi32(value, _MM_SHUFFLE(1, 0, 3, 2));
+                    sums[i] = _mm_add_epi64(sums[i], _mm_add_epi64(product, swapped));
+                }
+            }
+
+            for (size_t i = 0; i < 4; ++i) {
+                _mm_store_si128(lanes + i, sums[i]);
+            }
+        }
+
+        inline void ScrambleSse2(u64* acc, const u8* secret) {
+            const __m128i prime = _mm_set1_epi32(CAST<int>(kPrime32_1));
+            auto* lanes         = RCAST<__m128i*>(acc);
+            for (size_t i = 0; i < 4; ++i) {
+                __m128i value = _mm_load_si128(lanes + i);
+                value         = _mm_xor_si128(value, _mm_srli_epi64(value, 47));
+                value = _mm_xor_si128(value, _mm_loadu_si128(RCAST<const __m128i*>(secret) + i));
+                const __m128i low  = _mm_mul_epu32(value, prime);
+                const __m128i high = _mm_mul_epu32(_mm_srli_epi64(value, 32), prime);
+                _mm_store_si128(lanes + i, _mm_add_epi64(low, _mm_slli_epi64(high, 32)));
+            }
+        }
+
+        RIEGER_TARGET("avx2")
+        inline void AccumulateAvx2(u64* acc, const u8* input, const u8* secret, size_t stripes) {
+            auto* lanes   = RCAST<__m256i*>(acc);
+            __m256i sums0 = _mm256_load_si256(lanes);
+            __m256i sums1 = _mm256_load_si256(lanes + 1);
+            for (; stripes > 0; --stripes, input += kStripeLength, secret += 8) {
+                const auto* data = RCAST<const __m256i*>(input);
+                const auto* key  = RCAST<const __m256i*>(secret);
+                for (size_t i = 0; i < 2; ++i) {
+                    const __m256i value   = _mm256_loadu_si256(data + i);
+                    const __m256i keyed   = _mm256_xor_si256(value, _mm256_loadu_si256(key + i));
+                    const __m256i product = _mm256_mul_epu32(keyed, _mm256_srli_epi64(keyed, 32));
+                    const __m256i swapped = _mm256_shuffle_epi32(value, _MM_SHUFFLE(1, 0, 3, 2));
+                    __m256i& sums         = i == 0 ? sums0 : sums1;
+                    sums = _mm256_add_epi64(sums, _mm256_add_epi64(product, swapped));
+                }
+            }
+
+            _mm256_store_si256(lanes, sums0);
+            _mm256_store_si256(lanes + 1, sums1);
+        }
+
+        RIEGER_TARGET("avx2")
+        inline void ScrambleAvx2(u64* acc, const u8* secret) {
+            const __m256i prime = _mm256_set1_epi32(CAST<int>(kPrime32_1));
+            auto* lanes         = RCAST<__m256i*>(acc);
+            for (size_t i = 0; i < 2; ++i) {
+                __m256i value = _mm256_load_si256(lanes + i);
+                value         = _mm256_xor_si256(value, _mm256_srli_epi64(value, 47));
+                value         = _mm256_xor_si256(
+                  value, _mm256_loadu_si256(RCAST<const __m256i*>(secret) + i));
+                const __m256i low  = _mm256_mul_epu32(value, prime);
+                const __m256i high = _mm256_mul_epu32(_mm256_srli_epi64(value, 32), prime);
+                _mm256_store_si256(lanes + i, _mm256_add_epi64(low, _mm256_slli_epi64(high, 32)));
+            }
+        }
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+        inline void AccumulateNeon(u64* acc, const u8* input, const u8* secret, size_t stripes) {
+            uint64x2_t sums[4];
+            for (size_t i = 0; i < 4; ++i) {
+                sums[i] = vld1q_u64(acc + 2 * i);
+            }
+
+            for (; stripes > 0; --stripes, input += kStripeLength, secret += 8) {
+                for (size_t i = 0; i < 4; ++i) {
+                    const uint64x2_t value = vreinterpretq_u64_u8(vld1q_u8(input + 16 * i));
+                    const uint64x2_t keyed =
+                      veorq_u64(value, vreinterpretq_u64_u8(vld1q_u8(secret + 16 * i)));
+                    sums[i] = vaddq_u64(sums[i], vextq_u64(value, value, 1));
+                    sums[i] = vmlal_u32(sums[i], vmovn_u64(keyed), vshrn_n_u64(keyed, 32));
+                }
+            }
+
+            for (size_t i = 0; i < 4; ++i) {
+                vst1q_u64(acc + 2 * i, sums[i]);
+            }
+        }
+
+        inline void ScrambleNeon(u64* acc, const u8* secret) {
+            const uint32x2_t prime = vdup_n_u32(CAST<u32>(kPrime32_1));
+            for (size_t i = 0; i < 4; ++i) {
+                uint64x2_t value = vld1q_u64(acc + 2 * i);
+                value            = veorq_u64(value, vshrq_n_u64(value, 47));
+                value = veorq_u64(value, vreinterpretq_u64_u8(vld1q_u8(secret + 16 * i)));
+                const uint64x2_t high = vshlq_n_u64(vmull_u32(vshrn_n_u64(value, 32), prime), 32);
+                vst1q_u64(acc + 2 * i, vmlal_u32(high, vmovn_u64(value), prime));
+            }
+        }
+#endif
+
+        struct XXH3Kernels {
+            AccumulateKernel accumulate;
+            ScrambleKernel scramble;
+        };
+
+        inline XXH3Kernels SelectXXH3Kernels() noexcept {
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+            if (Cpu::Has(Cpu::Feature::Avx2)) {
+                return {AccumulateAvx2, ScrambleAvx2};
+            }
+
+            return {AccumulateSse2, ScrambleSse2};
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+            return {AccumulateNeon, ScrambleNeon};
+#else
+            return {AccumulateScalar, ScrambleScalar};
+#endif
+        }
+
+        inline const XXH3Kernels& ActiveXXH3Kernels() noexcept {
+            static const XXH3Kernels kernels = SelectXXH3Kernels();
+            return kernels;
+        }
+
+        inline u64 MergeAccs(const u64* acc, const u8* secret, u64 result) noexcept {
+            for (size_t i = 0; i < 4; ++i) {
+                result += Multiply128Fold(acc[2 * i] ^ Load64(secret + 16 * i),
+                                          acc[2 * i + 1] ^ Load64(secret + 16 * i + 8));
+            }
+
+            return Avalanche(result);
+        }
+
+        // The secret a seed stands for on inputs longer than kMidSizeMax.
+        inline void DeriveSecret(const u64 seed, u8* secret) noexcept {
+            for (size_t i = 0; i < kSecretSize; i += 16) {
+                Store64(secret + i, Load64(kSecret + i) + seed);
+                Store64(secret + i + 8, Load64(kSecret + i + 8) - seed);
+            }
+        }
+
+        inline u64 HashLong(const u8* input, const size_t length, const u8* secret) noexcept {
+            const auto& kernels = ActiveXXH3Kernels();
+            alignas(64) u64 acc[8];
+            std::copy_n(kInitialAcc, 8, acc);
+
+            const size_t blocks = (length - 1) / kBlockLength;
+            for (size_t block = 0; block < blocks; ++block) {
+                kernels.accumulate(acc, input + block * kBlockLength, secret, kStripesPerBlock);
+                kernels.scramble(acc, secret + kScrambleOffset);
+            }
+
+            const size_t stripes = (length - 1 - blocks * kBlockLength) / kStripeLength;
+            kernels.accumulate(acc, input + blocks * kBlockLength, secret, stripes);
+            kernels.accumulate(
+              acc, input + length - kStripeLength, secret + kScrambleOffset - kLastAccStart, 1);
+            return MergeAccs(acc, secret + kMergeAccsStart, length * kPrime64_1);
+        }
+
+        inline u64 XXH3(const u8* input, const size_t length, const u64 seed) noexcept {
+            if (length <= 16) {
+                return Hash0To16(input, length, seed);
+            }
+
+            if (length <= 128) {
+                return Hash17To128(input, length, seed);
+            }
+
+            if (length <= kMidSizeMax) {
+                return Hash129To240(input, length, seed);
+            }
+
+            if (seed == 0) {
+                return HashLong(input, length, kSecret);
+            }
+
+            alignas(64) u8 secret[kSecretSize];
+            DeriveSecret(seed, secret);
+            return HashLong(input, length, secret);
+        }
+    }  // namespace Detail
+
+    [[nodiscard]] inline u64 XXH3(const std::span<const u8> data, const u64 seed = 0) noexcept {
+        return Detail::XXH3(data.data(), data.size(), seed);
+    }
+
+    // XXH3 over data that arrives in pieces; the digest equals XXH3 of the concatenation.
+    class XXH3State {
+    public:
+        explicit XXH3State(const u64 initialSeed = 0) noexcept {
+            Reset(initialSeed);
+        }
+
+        void Reset() noexcept {
+            Reset(seed);
+        }
+
+        void Reset(const u64 newSeed) noexcept {
+            seed = newSeed;
+            std::copy_n(Detail::kInitialAcc, 8, acc);
+            Detail::DeriveSecret(seed, secret);
+            buffered       = 0;
+            blockStripes   = 0;
+            totalLength    = 0;
+        }
+
+        void Update(std::span<const u8> data) noexcept {
+            totalLength += data.size();
+            if (data.size() <= kBufferSize - buffered) {
+                std::copy_n(data.data(), data.size(), buffer + buffered);
+                buffered += data.size();
+                return;
+            }
+
+            if (buffered > 0) {
+                const size_t fill = kBufferSize - buffered;
+                std::copy_n(data.data(), fill, buffer + buffered);
+                data = data.subspan(fill);
+                ConsumeStripes(acc, blockStripes, buffer, kBufferStripes);
+                buffered = 0;
+            }
+
+            if (data.size() > kBufferSize) {
+                do {
+                    ConsumeStripes(acc, blockStripes, data.data(), kBufferStripes);
+                    data = data.subspan(kBufferSize);
+                } while (data.size() > kBufferSize);
+
+                // The digest may need the tail of this run to complete a short last stripe.
+                std::copy_n(data.data() - Detail::kStripeLength,
+                            Detail::kStripeLength,
+                            buffer + kBufferSize - Detail::kStripeLength);
+            }
+
+            std::copy_n(data.data(), data.size(), buffer);
+            buffered = data.size();
+        }
+
+        [[nodiscard]] u64 Digest() const noexcept {
+            using namespace Detail;
+            if (totalLength <= kMidSizeMax) {
+                return Detail::XXH3(buffer, buffered, seed);
+            }
+
+            alignas(64) u64 merged[8];
+            std::copy_n(acc, 8, merged);
+            size_t stripes = blockStripes;
+            const auto& kernels = ActiveXXH3Kernels();
+            const u8* lastAccSecret = secret + kScrambleOffset - kLastAccStart;
+            if (buffered >= kStripeLength) {
+                ConsumeStripes(merged, stripes, buffer, (buffered - 1) / kStripeLength);
+                kernels.accumulate(merged, buffer + buffered - kStripeLength, lastAccSecret, 1);
+            } else {
+                u8 lastStripe[kStripeLength];
+                const size_t catchUp = kStripeLength - buffered;
+                std::copy_n(buffer + kBufferSize - catchUp, catchUp, lastStripe);
+                std::copy_n(buffer, buffered, lastStripe + catchUp);
+                kernels.accumulate(merged, lastStripe, lastAccSecret, 1);
+            }
+
+            return MergeAccs(merged, secret + kMergeAccsStart, totalLength * kPrime64_1);
+        }
+
+    private:
+        static constexpr size_t kBufferSize    = 256;
+        static constexpr size_t kBufferStripes = kBufferSize / Detail::kStripeLength;
+
+        alignas(64) u64 acc[8];
+        alignas(64) u8 secret[Detail::kSecretSize];
+        alignas(64) u8 buffer[kBufferSize];
+        size_t buffered     = 0;
+        size_t blockStripes = 0;
+        u64 totalLength     = 0;
+        u64 seed            = 0;
+
+        // Accumulates stripes at the running position in the block, scrambling when the
+        // block fills.
+        void ConsumeStripes(u64* target, size_t& position, const u8* input, const size_t stripes)
+          const noexcept {
+            using namespace Detail;
+            const auto& kernels = ActiveXXH3Kernels();
+            if (kStripesPerBlock - position <= stripes) {
+                const size_t toEnd = kStripesPerBlock - position;
+                kernels.accumulate(target, input, secret + position * 8, toEnd);
+                kernels.scramble(target, secret + kScrambleOffset);
+                kernels.accumulate(target, input + toEnd * kStripeLength, secret, stripes - toEnd);
+                position = stripes - toEnd;
+            } else {
+                kernels.accumulate(target, input, secret + position * 8, stripes);
+                position += stripes;
+            }
+        }
+    };
+
+    namespace Detail {
+        inline constexpr u32 kCRC32CPolynomial = 0x82F63B78;
+
+        // Slicing-by-8 tables: row k advances a byte through k further zero bytes.
+        inline constexpr auto kCRC32CTable = [] {
+            std::array<std::array<u32, 256>, 8> table {};
+            for (u32 i = 0; i < 256; ++i) {
+                u32 crc = i;
+                for (int bit = 0; bit < 8; ++bit) {
+                    crc = (crc >> 1) ^ (kCRC32CPolynomial & (0u - (crc & 1)));
+                }
+
+                table[0][i] = crc;
+            }
+
+            for (size_t row = 1; row < 8; ++row) {
+                for (size_t i = 0; i < 256; ++i) {
+                    const u32 previous = table[row - 1][i];
+                    table[row][i]      = (previous >> 8) ^ table[0][previous & 0xFF];
+                }
+            }
+
+            return table;
+        }();
+
+        inline u32 CRC32CTable(u32 crc, const u8* data, size_t length) noexcept {
+            const auto& table = kCRC32CTable;
+            for (; length >= 8; length -= 8, data += 8) {
+                const u32 low  = Load32(data) ^ crc;
+                const u32 high = Load32(data + 4);
+                crc = table[7][low & 0xFF] ^ table[6][(low >> 8) & 0xFF] ^
+                      table[5][(low >> 16) & 0xFF] ^ table[4][low >> 24] ^
+                      table[3][high & 0xFF] ^ table[2][(high >> 8) & 0xFF] ^
+                      table[1][(high >> 16) & 0xFF] ^ table[0][high >> 24];
+            }
+
+            for (; length > 0; --length, ++data) {
+                crc = (crc >> 8) ^ table[0][(crc ^ *data) & 0xFF];
+            }
+
+            return crc;
+        }
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+        RIEGER_TARGET("sse4.2")
+        inline u32 CRC32CSse42(u32 crc, const u8* data, size_t length) noexcept {
+    #if defined(__x86_64__) || defined(_M_X64) || defined(_M_AMD64)
+            u64 wide = crc;
+            for (; length >= 8; length -= 8, data += 8) {
+                wide = _mm_crc32_u64(wide, Compression::Detail::Read64(data));
+            }
+
+            crc = CAST<u32>(wide);
+    #endif
+            for (; length >= 4; length -= 4, data += 4) {
+                crc = _mm_crc32_u32(crc, Compression::Detail::Read32(data));
+            }
+
+            for (; length > 0; --length, ++data) {
+                crc = _mm_crc32_u8(crc, *data);
+            }
+
+            return crc;
+        }
+#elif defined(__ARM_FEATURE_CRC32)
+        inline u32 CRC32CArm(u32 crc, const u8* data, size_t length) noexcept {
+            for (; length >= 8; length -= 8, data += 8) {
+                crc = __crc32cd(crc, Compression::Detail::Read64(data));
+            }
+
+            for (; length > 0; --length, ++data) {
+                crc = __crc32cb(crc, *data);
+            }
+
+            return crc;
+        }
+#endif
+
+        using CRC32CKernel = u32 (*)(u32, const u8*, size_t) noexcept;
+
+        // Advances a pre-inverted CRC over data.
+        inline u32 CRC32CUpdate(const u32 crc, const u8* data, const size_t length) noexcept {
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+            static const CRC32CKernel kernel =
+              Cpu::Select<CRC32CKernel>({{Cpu::Feature::Sse42, CRC32CSse42}}, CRC32CTable);
+            return kernel(crc, data, length);
+#elif defined(__ARM_FEATURE_CRC32)
+            return CRC32CArm(crc, data, length);
+#else
+            return CRC32CTable(crc, data, length);
+#endif
+        }
+    }  // namespace Detail
+
+    // Chains like zlib's crc32: CRC32C(b, CRC32C(a)) equals CRC32C of a followed by b.
+    [[nodiscard]] inline u32 CRC32C(const std::span<const u8> data,
+                                    const u32 previous = 0) noexcept {
+        return ~Detail::CRC32CUpdate(~previous, data.data(), data.size());
+    }
+
+    class CRC32CState {
+    public:
+        void Reset() noexcept {
+            crc = ~0u;
+        }
+
+        void Update(const std::span<const u8> data) noexcept {
+            crc = Detail::CRC32CUpdate(crc, data.data(), data.size());
+        }
+
+        [[nodiscard]] u32 Digest() const noexcept {
+            return ~crc;
+        }
+
+    private:
+        u32 crc = ~0u;
+    };
+}  // namespace Hash
+
+// Scoped timers and per-site counters for hot paths. Probes are written with
+// RIEGER_PROFILE_SCOPE and RIEGER_PROFILE_BYTES and compile to nothing unless RIEGER_PROFILE is
+// defined before Rieger.h is included; with it, every IO entry point records calls, bytes and
+// a latency histogram. Each thread updates its own counters with plain relaxed stores, so a
+// probe costs two timestamp reads and a few uncontended writes. SetTracing also keeps the last
+// kTraceCapacity spans of every thread for WriteChromeTrace, whose JSON loads in
+// chrome://tracing and Perfetto, and converts to Tracy with its import-chrome tool. Defining
+// RIEGER_PROFILE_TRACY as well forwards each span to a live Tracy session through TracyC.h.
+namespace Profile {
+#if defined(RIEGER_PROFILE)
+    inline constexpr bool kEnabled = true;
+#else
+    inline constexpr bool kEnabled = false;
+#endif
+
+    inline constexpr size_t kMaxSites         = 256;
+    inline constexpr size_t kHistogramBuckets = 32;
+    inline constexpr size_t kTraceCapacity    = 64 * 1024;
+
+    // A raw timestamp: TSC ticks on x86, the virtual counter on ARM64, QPC ticks elsewhere on
+    // Windows and steady_clock nanoseconds otherwise.
+    inline u64 Now() noexcept {
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+        return __rdtsc();
+#elif defined(_WIN32) || defined(_WIN64)
+        LARGE_INTEGER counter;
+        ::QueryPerformanceCounter(&counter);
+        return CAST<u64>(counter.QuadPart);
+#elif defined(__aarch64__)
+        u64 counter;
+        asm volatile("mrs %0, cntvct_el0" : "=r"(counter));
+        return counter;
+#else
+        return CAST<u64>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           std::chrono::steady_clock::now().time_since_epoch())
+                           .count());
+#endif
+    }
+
+    // Nanoseconds per Now() tick. The TSC rate is measured against steady_clock on first use,
+    // which takes about 20 ms; the other counters report their frequency.
+    inline f64 NanosecondsPerTick() noexcept {
+        static const f64 scale = [] {
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+            const auto wallStart = std::chrono::steady_clock::now();
+            const u64 tickStart  = Now();
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            const u64 ticks   = Now() - tickStart;
+            const auto wall   = std::chrono::steady_clock::now() - wallStart;
+            const auto wallNs = std::chrono::duration<f64, std::nano>(wall).count();
+            return ticks > 0 ? wallNs / CAST<f64>(ticks) : 1.0;
+#elif defined(_WIN32) || defined(_WIN64)
+            LARGE_INTEGER frequency;
+            ::QueryPerformanceFrequency(&frequency);
+            return 1e9 / CAST<f64>(frequency.QuadPart);
+#elif defined(__aarch64__)
+            u64 frequency;
+            asm volatile("mrs %0, cntfrq_el0" : "=r"(frequency));
+            return 1e9 / CAST<f64>(frequency);
+#else
+            return 1.0;
+#endif
+        }();
+        return scale;
+    }
+
+    // One probe location. Sites are constant-initialized statics, numbered on first use; past
+    // kMaxSites they are timed but not counted.
+    struct Site {
+        static constexpr u32 kUnassigned = ~0u;
+
+        const char* name;
+        const char* file;
+        u32 line;
+        std::atomic<u32> id {kUnassigned};
+#if defined(RIEGER_PROFILE_TRACY)
+        ___tracy_source_location_data tracy;
+
+        constexpr Site(const char* name, const char* file, const u32 line) noexcept
+            : name(name), file(file), line(line), tracy {name, name, file, line, 0} {}
+#else
+        constexpr Site(const char* name, const char* file, const u32 line) noexcept
+            : name(name), file(file), line(line) {}
+#endif
+    };
+
+    namespace Detail {
+        // Only the owning thread writes these, so updates are a relaxed load and store rather
+        // than an atomic read-modify-write; readers may see a call's fields from mid-update.
+        struct Counters {
+            std::atomic<u64> calls {0};
+            std::atomic<u64> bytes {0};
+            std::atomic<u64> ticks {0};
+            std::atomic<u64> histogram[kHistogramBuckets] {};
+        };
+
+        struct Span {
+            u32 site;
+            u32 depth;
+            u64 start;
+            u64 duration;
+            u64 bytes;
+        };
+
+        struct ThreadData {
+            u32 index  = 0;
+            u32 depth  = 0;
+            bool inUse = false;  // Guarded by Registry::mutex.
+            Counters counters[kMaxSites];
+            std::atomic<Span*> spans {nullptr};
+            std::atomic<u64> spanCount {0};
+            Unique<Span[]> spanStorage;
+        };
+
+        inline void Bump(std::atomic<u64>& counter, const u64 amount) noexcept {
+            counter.store(counter.load(std::memory_order_relaxed) + amount,
+                          std::memory_order_relaxed);
+        }
+
+        struct Registry {
+            std::atomic<const Site*> sites[kMaxSites] {};
+            std::atomic<u32> siteCount {0};
+            std::atomic<bool> tracing {false};
+            u64 epoch = Now();
+            std::mutex mutex;
+            Vector<Unique<ThreadData>> threads;
+        };
+
+        // Built in static storage and never destroyed, so getting it cannot fail and probes in
+        // other statics' destructors stay safe.
+        inline Registry& GlobalRegistry() noexcept {
+            alignas(Registry) static std::byte storage[sizeof(Registry)];
+            static Registry* registry = new (storage) Registry;
+            return *registry;
+        }
+
+        inline u32 SiteId(Site& site) noexcept {
+            u32 id = site.id.load(std::memory_order_acquire);
+            if (id != Site::kUnassigned) {
+                return id;
+            }
+
+            auto& registry = GlobalRegistry();
+            std::lock_guard lock(registry.mutex);
+            id = site.id.load(std::memory_order_relaxed);
+            if (id == Site::kUnassigned) {
+                id = registry.siteCount.load(std::memory_order_relaxed);
+                if (id < kMaxSites) {
+                    registry.sites[id].store(&site, std::memory_order_release);
+                    registry.siteCount.store(id + 1, std::memory_order_release);
+                }
+
+                site.id.store(id, std::memory_order_release);
+            }
+
+            return id;
+        }
+
+        // Gives the thread's data back to the registry when the thread exits. The next thread
+        // to start takes it over, counts and spans included, so memory stays bounded by the
+        // most threads alive at once rather than every thread ever started.
+        struct ThreadRelease {
+            ThreadData** slot = nullptr;
+            bool* exiting     = nullptr;
+
+            ~ThreadRelease() {
+                *exiting = true;
+                if (*slot == nullptr) {
+                    return;
+                }
+
+                auto& registry = GlobalRegistry();
+                std::lock_guard lock(registry.mutex);
+                (*slot)->inUse = false;
+                *slot          = nullptr;
+            }
+        };
+
+        // Null if no data could be allocated, or once the thread has started exiting; that
+        // thread's probes then record nothing.
+        inline ThreadData* CurrentThread() noexcept {
+            // Trivially destructible, so it stays readable from other thread_local destructors.
+            thread_local ThreadData* data = nullptr;
+            thread_local bool exiting     = false;
+            if (data != nullptr || exiting) {
+                return data;
+            }
+
+            thread_local ThreadRelease release {&data, &exiting};
+
+            auto& registry = GlobalRegistry();
+            std::lock_guard lock(registry.mutex);
+            for (const auto& thread : registry.threads) {
+                if (!thread->inUse) {
+                    data = thread.get();
+                    break;
+                }
+            }
+
+            if (data == nullptr) {
+                Unique<ThreadData> created(new (std::nothrow) ThreadData);
+                if (created == nullptr) {
+                    return nullptr;
+                }
+
+                try {
+                    registry.threads.push_back(std::move(created));
+                } catch (...) {
+                    return nullptr;
+                }
+
+                data        = registry.threads.back().get();
+                data->index = CAST<u32>(registry.threads.size());
+            }
+
+            data->inUse = true;
+            data->depth = 0;
+            return data;
+        }
+
+        inline void Record(ThreadData& thread,
+                           Site& site,
+                           const u64 start,
+                           const u64 duration,
+                           const u64 bytes) noexcept {
+            const u32 id = SiteId(site);
+            if (id >= kMaxSites) {
+                return;
+            }
+
+            auto& counters      = thread.counters[id];
+            const size_t bucket = std::min<size_t>(std::bit_width(duration), kHistogramBuckets - 1);
+            Bump(counters.calls, 1);
+            Bump(counters.bytes, bytes);
+            Bump(counters.ticks, duration);
+            Bump(counters.histogram[bucket], 1);
+
+            if (!GlobalRegistry().tracing.load(std::memory_order_relaxed)) {
+                return;
+            }
+
+            // Probes run in destructors and noexcept code, so a failed allocation drops the span.
+            Span* spans = thread.spans.load(std::memory_order_relaxed);
+            if (spans == nullptr) {
+                thread.spanStorage.reset(new (std::nothrow) Span[kTraceCapacity]);
+                spans = thread.spanStorage.get();
+                if (spans == nullptr) {
+                    return;
+                }
+
+                thread.spans.store(spans, std::memory_order_release);
+            }
+
+            const u64 count              = thread.spanCount.load(std::memory_order_relaxed);
+            spans[count % kTraceCapacity] = {id, thread.depth, start, duration, bytes};
+            thread.spanCount.store(count + 1, std::memory_order_release);
+        }
+    }  // namespace Detail
+
+    // Times the enclosing block against a Site. Use through RIEGER_PROFILE_SCOPE.
+    class Scope {
+    public:
+        explicit Scope(Site& site) noexcept : site(site), thread(Detail::CurrentThread()) {
+            if (thread == nullptr) {
+                return;
+            }
+
+            ++thread->depth;
+#if defined(RIEGER_PROFILE_TRACY)
+            zone = ___tracy_emit_zone_begin(&site.tracy, 1);
+#endif
+            start = Now();
+        }
+
+        ~Scope() {
+            if (thread == nullptr) {
+                return;
+            }
+
+            const u64 end = Now();
+            --thread->depth;
+            Detail::Record(*thread, site, start, end - start, bytes);
+#if defined(RIEGER_PROFILE_TRACY)
+            if (bytes > 0) {
+                ___tracy_emit_zone_value(zone, bytes);
+            }
+
+            ___tracy_emit_zone_end(zone);
+#endif
+        }
+
+        Scope(const Scope&)            = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        void AddBytes(const u64 count) noexcept {
+            bytes += count;
+        }
+
+    private:
+        Site& site;
+        Detail::ThreadData* thread;
+        u64 start = 0;
+        u64 bytes = 0;
+#if defined(RIEGER_PROFILE_TRACY)
+        TracyCZoneCtx zone;
+#endif
+    };
+
+    struct SiteStats {
+        str name;
+        u64 calls     = 0;
+        u64 bytes     = 0;
+        f64 totalNs   = 0;
+        // Bucket i counts calls that took [2^(i-1), 2^i) ticks; see BucketUpperBoundNs.
+        std::array<u64, kHistogramBuckets> histogram {};
+
+        [[nodiscard]] static f64 BucketUpperBoundNs(const size_t bucket) noexcept {
+            return std::ldexp(1.0, CAST<int>(bucket)) * NanosecondsPerTick();
+        }
+    };
+
+    // Every site that has been hit, totalled over all threads. Safe to call while probes run,
+    // though a call in flight may show in some fields and not yet in others.
+    inline Vector<SiteStats> Snapshot() {
+        auto& registry = Detail::GlobalRegistry();
+        std::lock_guard lock(registry.mutex);
+        const u32 siteCount = registry.siteCount.load(std::memory_order_acquire);
+        const f64 scale     = NanosecondsPerTick();
+
+        Vector<SiteStats> stats(siteCount);
+        for (u32 id = 0; id < siteCount; ++id) {
+            stats[id].name = registry.sites[id].load(std::memory_order_acquire)->name;
+            u64 ticks      = 0;
+            for (const auto& thread : registry.threads) {
+                const auto& counters = thread->counters[id];
+                stats[id].calls += counters.calls.load(std::memory_order_relaxed);
+                stats[id].bytes += counters.bytes.load(std::memory_order_relaxed);
+                ticks += counters.ticks.load(std::memory_order_relaxed);
+                for (size_t bucket = 0; bucket < kHistogramBuckets; ++bucket) {
+                    stats[id].histogram[bucket] +=
+                      counters.histogram[bucket].load(std::memory_order_relaxed);
+                }
+            }
+
+            stats[id].totalNs = CAST<f64>(ticks) * scale;
+        }
+
+        std::erase_if(stats, [](const SiteStats& site) { return site.calls == 0; });
+        return stats;
+    }
+
+    // Whether probes also keep spans for WriteChromeTrace. Off by default.
+    inline void SetTracing(const bool enabled) noexcept {
+        Detail::GlobalRegistry().tracing.store(enabled, std::memory_order_relaxed);
+    }
+
+    // Zeroes counters and drops kept spans. Only call it while no probes are running.
+    inline void Reset() {
+        auto& registry = Detail::GlobalRegistry();
+        std::lock_guard lock(registry.mutex);
+        for (auto& thread : registry.threads) {
+            for (auto& counters : thread->counters) {
+                counters.calls.store(0, std::memory_order_relaxed);
+                counters.bytes.store(0, std::memory_order_relaxed);
+                counters.ticks.store(0, std::memory_order_relaxed);
+                for (auto& bucket : counters.histogram) {
+                    bucket.store(0, std::memory_order_relaxed);
+                }
+            }
+
+            thread->spanCount.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    // Writes the kept spans as Chrome trace event JSON, one complete ("X") event per span with
+    // its byte count in args. Spans are read without stopping their threads, so call it once
+    // the traced work has quiesced.
+    inline bool WriteChromeTrace(const Path& filename) {
+        std::ofstream outfile(filename, std::ios::binary);
+        if (!outfile.is_open()) {
+            return false;
+        }
+
+        const f64 microsecondsPerTick = NanosecondsPerTick() / 1000.0;
+        auto& registry                = Detail::GlobalRegistry();
+        std::lock_guard lock(registry.mutex);
+
+        const auto escape = [](const char* text) {
+            str escaped;
+            for (; *text != '\0'; ++text) {
+                if (*text == '"' || *text == '\\') {
+                    escaped += '\\';
+                }
+
+                escaped += *text;
+            }
+
+            return escaped;
+        };
+
+        outfile << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+        bool first = true;
+        char line[512];
+        for (const auto& thread : registry.threads) {
+            std::snprintf(line,
+                          sizeof(line),
+                          "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+                          "\"args\":{\"name\":\"thread %u\"}}",
+                          first ? "" : ",",
+                          thread->index,
+                          thread->index);
+            outfile << line;
+            first = false;
+
+            const Detail::Span* spans = thread->spans.load(std::memory_order_acquire);
+            const u64 count           = thread->spanCount.load(std::memory_order_acquire);
+            if (spans == nullptr) {
+                continue;
+            }
+
+            for (u64 i = count > kTraceCapacity ? count - kTraceCapacity : 0; i < count; ++i) {
+                const auto& span = spans[i % kTraceCapacity];
+                const Site* site = registry.sites[span.site].load(std::memory_order_acquire);
+                const f64 start =
+                  CAST<f64>(CAST<i64>(span.start - registry.epoch)) * microsecondsPerTick;
+                std::snprintf(line,
+                              sizeof(line),
+                              ",\n{\"name\":\"%s\",\"cat\":\"rieger\",\"ph\":\"X\",\"pid\":1,"
+                              "\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"bytes\":%llu}}",
+                              escape(site->name).c_str(),
+                              thread->index,
+                              start,
+                              CAST<f64>(span.duration) * microsecondsPerTick,
+                              CAST<unsigned long long>(span.bytes));
+                outfile << line;
+            }
+        }
+
+        outfile << "\n]}\n";
+        outfile.close();
+        return !outfile.fail();
+    }
+}  // namespace Profile
+
+#if defined(RIEGER_PROFILE)
+    // Times the rest of the enclosing block under name; at most one per block.
+    #define RIEGER_PROFILE_SCOPE(name)                                                     \
+        static constinit ::Profile::Site riegerProfileSite {name, __FILE__, __LINE__}; \
+        ::Profile::Scope riegerProfileScope {riegerProfileSite}
+    // Adds to the bytes the enclosing RIEGER_PROFILE_SCOPE reports.
+    #define RIEGER_PROFILE_BYTES(count) riegerProfileScope.AddBytes(CAST<u64>(count))
+#else
+    #define RIEGER_PROFILE_SCOPE(name)
+    // Unevaluated: keeps variables used only for counting from warning as unused.
+    #define RIEGER_PROFILE_BYTES(count) ((void)sizeof(count))
+#endif
+
+#if defined(_WIN32) || defined(_WIN64)
+
+// Unbuffered reads for large files. These live ahead of IO, which uses them for big
+// ReadAllBytes and ReadBlock calls; the rest of WindowsAPI follows the portable sections.
+namespace WindowsAPI {
+    // Reads at least this large bypass the system file cache.
+    inline constexpr size_t kUnbufferedThreshold = 4 * 1024 * 1024;
+
+    // One piece of a batched read. bytesRead is set by ReadBatch: the number of bytes stored
+    // (short only at end of file), or kNone if the read failed.
+    struct ReadRequest {
+        u64 offset = 0;
+        std::span<u8> destination;
+        Option<size_t> bytesRead;
+    };
+
+    namespace Detail {
+        inline constexpr size_t kUnbufferedChunk    = 1024 * 1024;
+        inline constexpr size_t kUnbufferedInFlight = 4;
+
+        struct VirtualFreeDeleter {
+            void operator()(u8* memory) const noexcept {
+                ::VirtualFree(memory, 0, MEM_RELEASE);
+            }
+        };
+
+        // OVERLAPPED comes first so the completion routine can recover its slot.
+        struct UnbufferedSlot {
+            OVERLAPPED overlapped {};
+            u8* target        = nullptr;
+            size_t request    = 0;
+            u64 start         = 0;
+            DWORD error       = ERROR_SUCCESS;
+            DWORD transferred = 0;
+            bool busy         = false;
+            bool done         = false;
+        };
+
+        inline VOID CALLBACK OnUnbufferedRead(DWORD error, DWORD transferred, LPOVERLAPPED io) {
+            auto* slot        = RCAST<UnbufferedSlot*>(io);
+            slot->error       = error;
+            slot->transferred = transferred;
+            slot->done        = true;
+        }
+    }  // namespace Detail
+
+    // A file opened with FILE_FLAG_NO_BUFFERING | FILE_FLAG_OVERLAPPED. Every request is
+    // widened to sector boundaries and issued with ReadFileEx, several at a time, into a ring
+    // of sector-aligned buffers; pieces that are already sector-aligned in both file offset
+    // and memory are read straight into the destination. (FILE_FLAG_SEQUENTIAL_SCAN is only a
+    // cache hint and has no effect once the cache is bypassed.)
+    class UnbufferedFile {
+    public:
+        UnbufferedFile() = default;
+
+        ~UnbufferedFile() {
+            Close();
+        }
+
+        UnbufferedFile(const UnbufferedFile&)            = delete;
+        UnbufferedFile& operator=(const UnbufferedFile&) = delete;
+
+        UnbufferedFile(UnbufferedFile&& other) noexcept
+            : handle(std::exchange(other.handle, INVALID_HANDLE_VALUE)),
+              sector(other.sector), buffers(std::move(other.buffers)) {}
+
+        UnbufferedFile& operator=(UnbufferedFile&& other) noexcept {
+            if (this != &other) {
+                Close();
+                handle  = std::exchange(other.handle, INVALID_HANDLE_VALUE);
+                sector  = other.sector;
+                buffers = std::move(other.buffers);
+            }
+
+            return *this;
+        }
+
+        static Option<UnbufferedFile> Open(const Path& filename, std::error_code& error) {
+            UnbufferedFile file;
+            file.handle = ::CreateFileW(filename.c_str(),
+                                        GENERIC_READ,
+                                        FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                        nullptr,
+                                        OPEN_EXISTING,
+                                        FILE_FLAG_NO_BUFFERING | FILE_FLAG_OVERLAPPED,
+                                        nullptr);
+            if (file.handle == INVALID_HANDLE_VALUE) {
+                error = {CAST<int>(::GetLastError()), std::system_category()};
+                return kNone;
+            }
+
+            FILE_STORAGE_INFO storage {};
+            if (::GetFileInformationByHandleEx(
+                  file.handle, FileStorageInfo, &storage, sizeof(storage)) &&
+                std::has_single_bit(storage.PhysicalBytesPerSectorForPerformance) &&
+                storage.PhysicalBytesPerSectorForPerformance <= 64 * 1024) {
+                file.sector = storage.PhysicalBytesPerSectorForPerformance;
+            }
+
+            error.clear();
+            return file;
+        }
+
+        static Option<UnbufferedFile> Open(const Path& filename) {
+            std::error_code error;
+            return Open(filename, error);
+        }
+
+        [[nodiscard]] Option<u64> Size() const {
+            LARGE_INTEGER size {};
+            if (!::GetFileSizeEx(handle, &size)) {
+                return kNone;
+            }
+
+            return CAST<u64>(size.QuadPart);
+        }
+
+        [[nodiscard]] u32 SectorSize() const noexcept {
+            return sector;
+        }
+
+        [[nodiscard]] bool IsOpen() const noexcept {
+            return handle != INVALID_HANDLE_VALUE;
+        }
+
+        void Close() noexcept {
+            if (handle != INVALID_HANDLE_VALUE) {
+                ::CloseHandle(handle);
+                handle = INVALID_HANDLE_VALUE;
+            }
+        }
+
+        // Bytes read into destination (short only at end of file), or kNone on error.
+        Option<size_t> Read(const u64 offset, const std::span<u8> destination) {
+            ReadRequest request {offset, destination};
+            ReadBatch({&request, 1});
+            return request.bytesRead;
+        }
+
+        // Issues every request through one shared queue of overlapped reads, waiting on
+        // completions in an alertable sleep. Returns false if any request failed.
+        bool ReadBatch(const std::span<ReadRequest> requests) {
+            using Detail::kUnbufferedChunk;
+            using Detail::kUnbufferedInFlight;
+
+            if (!buffers) {
+                void* memory = ::VirtualAlloc(nullptr,
+                                              kUnbufferedChunk * kUnbufferedInFlight,
+                                              MEM_COMMIT | MEM_RESERVE,
+                                              PAGE_READWRITE);
+                if (!memory) {
+                    for (auto& request : requests) {
+                        request.bytesRead = kNone;
+                    }
+
+                    return false;
+                }
+
+                buffers.reset(CAST<u8*>(memory));
+            }
+
+            for (auto& request : requests) {
+                request.bytesRead = 0;
+            }
+
+            std::array<Detail::UnbufferedSlot, kUnbufferedInFlight> slots {};
+            size_t nextRequest = 0;
+            u64 nextStart      = requests.empty() ? 0 : AlignDown(requests[0].offset);
+            size_t inFlight    = 0;
+            bool succeeded     = true;
+
+            const auto advance = [&] {
+                while (nextRequest < requests.size()) {
+                    const auto& request = requests[nextRequest];
+                    const u64 end       = request.offset + request.destination.size();
+                    if (request.bytesRead.has_value() && !request.destination.empty() &&
+                        nextStart < end) {
+                        return true;
+                    }
+
+                    if (++nextRequest < requests.size()) {
+                        nextStart = AlignDown(requests[nextRequest].offset);
+                    }
+                }
+
+                return false;
+            };
+
+            while (true) {
+                for (size_t s = 0; s < slots.size() && advance(); ++s) {
+                    auto& slot = slots[s];
+                    if (slot.busy) {
+                        continue;
+                    }
+
+                    Issue(slot, requests, nextRequest, nextStart, s);
+                    if (slot.busy) {
+                        ++inFlight;
+                    } else {
+                        Complete(slot, requests[slot.request]);
+                    }
+                }
+
+                if (inFlight == 0) {
+                    break;
+                }
+
+                ::SleepEx(INFINITE, TRUE);
+                for (auto& slot : slots) {
+                    if (slot.busy && slot.done) {
+                        slot.busy = false;
+                        --inFlight;
+                        Complete(slot, requests[slot.request]);
+                    }
+                }
+            }
+
+            for (const auto& request : requests) {
+                succeeded = succeeded && request.bytesRead.has_value();
+            }
+
+            return succeeded;
+        }
+
+    private:
+        HANDLE handle = INVALID_HANDLE_VALUE;
+        u32 sector    = 4096;
+        Unique<u8, Detail::VirtualFreeDeleter> buffers;
+
+        [[nodiscard]] u64 AlignDown(const u64 value) const noexcept {
+            return value & ~CAST<u64>(sector - 1);
+        }
+
+        // Starts the next chunk of requests[index] in slot, reading directly into the
+        // destination when alignment allows. A request that fails to start, or starts past
+        // the end of the file, completes immediately with busy left false.
+        void Issue(Detail::UnbufferedSlot& slot,
+                   const std::span<ReadRequest> requests,
+                   const size_t index,
+                   u64& start,
+                   const size_t slotIndex) {
+            using Detail::kUnbufferedChunk;
+
+            const auto& request = requests[index];
+            const u64 end       = request.offset + request.destination.size();
+            const u64 alignedEnd =
+              std::min(AlignDown(end + sector - 1), start + kUnbufferedChunk);
+
+            slot             = {};
+            slot.request     = index;
+            slot.start       = start;
+            slot.target      = buffers.get() + slotIndex * kUnbufferedChunk;
+            if (start >= request.offset && alignedEnd <= end) {
+                u8* direct = request.destination.data() + (start - request.offset);
+                if (RCAST<uintptr_t>(direct) % sector == 0) {
+                    slot.target = direct;
+                }
+            }
+
+            slot.overlapped.Offset     = CAST<DWORD>(start & 0xFFFFFFFF);
+            slot.overlapped.OffsetHigh = CAST<DWORD>(start >> 32);
+            start                      = alignedEnd;
+
+            const auto length = CAST<DWORD>(alignedEnd - slot.start);
+            if (::ReadFileEx(handle,
+                             slot.target,
+                             length,
+                             &slot.overlapped,
+                             Detail::OnUnbufferedRead)) {
+                slot.busy = true;
+            } else {
+                slot.error = ::GetLastError();
+            }
+        }
+
+        // Copies the part of a finished chunk that overlaps its request.
+        static void Complete(const Detail::UnbufferedSlot& slot, ReadRequest& request) {
+            if (!request.bytesRead.has_value()) {
+                return;
+            }
+
+            if (slot.error != ERROR_SUCCESS && slot.error != ERROR_HANDLE_EOF) {
+                request.bytesRead = kNone;
+                return;
+            }
+
+            const u64 end   = request.offset + request.destination.size();
+            const u64 first = std::max(slot.start, request.offset);
+            const u64 last  = std::min(slot.start + slot.transferred, end);
+            if (last <= first) {
+                return;
+            }
+
+            u8* target       = request.destination.data() + (first - request.offset);
+            const u8* source = slot.target + (first - slot.start);
+            if (source != target) {
+                std::copy_n(source, last - first, target);
+            }
+
+            *request.bytesRead += CAST<size_t>(last - first);
+        }
+    };
+}  // namespace WindowsAPI
+
+#endif
+
+namespace IO {
+    namespace Detail {
+        // memchr-style scan for '\n' over 16/32 bytes at a time. Returns end if there is none.
+        inline const char* FindNewline(const char* begin, const char* end) noexcept {
+            const char* cursor = begin;
+
+#if defined(__AVX2__)
+            const __m256i newlines32 = _mm256_set1_epi8('\n');
+            for (; end - cursor >= 32; cursor += 32) {
+                const __m256i block = _mm256_loadu_si256(RCAST<const __m256i*>(cursor));
+                const u32 mask =
+                  CAST<u32>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, newlines32)));
+                if (mask != 0) {
+                    return cursor + std::countr_zero(mask);
+                }
+            }
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+            const __m128i newlines = _mm_set1_epi8('\n');
+            for (; end - cursor >= 16; cursor += 16) {
+                const __m128i block = _mm_loadu_si128(RCAST<const __m128i*>(cursor));
+                const u32 mask      = CAST<u32>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, newlines)));
+                if (mask != 0) {
+                    return cursor + std::countr_zero(mask);
+                }
+            }
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+            const uint8x16_t newlines = vdupq_n_u8('\n');
+            for (; end - cursor >= 16; cursor += 16) {
+                const uint8x16_t block = vld1q_u8(RCAST<const u8*>(cursor));
+                const uint8x16_t equal = vceqq_u8(block, newlines);
+                // Narrow each byte lane to a nibble so the whole compare fits in one u64.
+                const uint8x8_t nibbles = vshrn_n_u16(vreinterpretq_u16_u8(equal), 4);
+                const u64 mask          = vget_lane_u64(vreinterpret_u64_u8(nibbles), 0);
+                if (mask != 0) {
+                    return cursor + std::countr_zero(mask) / 4;
+                }
+            }
+#endif
+
+            for (; cursor != end; ++cursor) {
+                if (*cursor == '\n') {
+                    return cursor;
+                }
+            }
+
+            return end;
+        }
+
+        // Input iterator over anything with an Option<Value> Next(), ending when Next() runs dry.
+        template<class Reader, class Value>
+        class ReaderIterator {
+        public:
+            using value_type      = Value;
+            using difference_type = std::ptrdiff_t;
+
+            ReaderIterator() = default;
+
+            explicit ReaderIterator(Reader* reader) : reader(reader), current(reader->Next()) {}
+
+            const Value& operator*() const {
+                return *current;
+            }
+
+            ReaderIterator& operator++() {
+                current = reader->Next();
+                return *this;
+            }
+
+            void operator++(int) {
+                ++*this;
+            }
+
+            bool operator==(std::default_sentinel_t) const {
+                return !current.has_value();
+            }
+
+        private:
+            Reader* reader = nullptr;
+            Option<Value> current;
+        };
+
+        // Feeds every item to the callback; a callback returning bool can stop early with false.
+        template<class Reader, class Value, class Callback>
+        bool Drain(Reader& reader, Callback& callback) {
+            while (const auto item = reader.Next()) {
+                if constexpr (std::is_same_v<std::invoke_result_t<Callback&, Value>, bool>) {
+                    if (!callback(*item)) {
+                        return true;
+                    }
+                } else {
+                    callback(*item);
+                }
+            }
+
+            return !reader.Failed();
+        }
+    }  // namespace Detail
+
+    enum class FileAccess : u8 {
+        Read,
+        ReadWrite,
+        // Write-only; creates the file or truncates an existing one.
+        Create,
+    };
+
+    namespace Detail {
+        inline std::error_code LastError() {
+#if defined(_WIN32) || defined(_WIN64)
+            return {CAST<int>(::GetLastError()), std::system_category()};
+#else
+            return {errno, std::system_category()};
+#endif
+        }
+
+#if defined(_WIN32) || defined(_WIN64)
+        // Per-thread event for waiting on overlapped requests against a shared handle.
+        inline HANDLE ThreadIoEvent() {
+            struct Event {
+                HANDLE handle = ::CreateEventW(nullptr, TRUE, FALSE, nullptr);
+
+                ~Event() {
+                    if (handle) {
+                        ::CloseHandle(handle);
+                    }
+                }
+            };
+
+            thread_local Event event;
+            return event.handle;
+        }
+#endif
+    }  // namespace Detail
+
+    // One open descriptor for positional reads and writes. There is no shared seek state
+    // (pread/pwrite, or overlapped ReadFile/WriteFile with an explicit offset), so any number
+    // of threads can use the same handle concurrently.
+    class FileHandle {
+    public:
+#if defined(_WIN32) || defined(_WIN64)
+        using Native                        = HANDLE;
+        static inline const Native kInvalid = INVALID_HANDLE_VALUE;
+#else
+        using Native                     = int;
+        static constexpr Native kInvalid = -1;
+#endif
+
+        FileHandle() = default;
+
+        ~FileHandle() {
+            Close();
+        }
+
+        FileHandle(const FileHandle&)            = delete;
+        FileHandle& operator=(const FileHandle&) = delete;
+
+        FileHandle(FileHandle&& other) noexcept : handle(std::exchange(other.handle, kInvalid)) {}
+
+        FileHandle& operator=(FileHandle&& other) noexcept {
+            if (this != &other) {
+                Close();
+                handle = std::exchange(other.handle, kInvalid);
+            }
+
+            return *this;
+        }
+
+        static Option<FileHandle> Open(const Path& filename,
+                                       const FileAccess access = FileAccess::Read) {
+            std::error_code error;
+            return Open(filename, access, error);
+        }
+
+        static Option<FileHandle>
+        Open(const Path& filename, const FileAccess access, std::error_code& error) {
+            FileHandle file;
+
+#if defined(_WIN32) || defined(_WIN64)
+            DWORD desiredAccess = GENERIC_READ;
+            DWORD shareMode     = FILE_SHARE_READ | FILE_SHARE_WRITE;
+            DWORD disposition   = OPEN_EXISTING;
+            if (access == FileAccess::ReadWrite) {
+                desiredAccess = GENERIC_READ | GENERIC_WRITE;
+                shareMode     = FILE_SHARE_READ;
+            } else if (access == FileAccess::Create) {
+                desiredAccess = GENERIC_WRITE;
+                shareMode     = FILE_SHARE_READ;
+                disposition   = CREATE_ALWAYS;
+            }
+
+            file.handle = ::CreateFileW(filename.c_str(),
+                                        desiredAccess,
+                                        shareMode,
+                                        nullptr,
+                                        disposition,
+                                        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED,
+                                        nullptr);
+#else
+            int flags = O_RDONLY | O_CLOEXEC;
+            if (access == FileAccess::ReadWrite) {
+                flags = O_RDWR | O_CLOEXEC;
+            } else if (access == FileAccess::Create) {
+                flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+            }
+
+            file.handle = ::open(filename.c_str(), flags, 0666);
+#endif
+
+            if (file.handle == kInvalid) {
+                error = Detail::LastError();
+                return kNone;
+            }
+
+            error.clear();
+            return file;
+        }
+
+        // Reads up to destination.size() bytes at offset; fewer only at end of file.
+        Option<size_t> ReadSomeAt(const u64 offset, const std::span<u8> destination) const {
+            return ReadSomeAt(offset, destination, std::numeric_limits<u64>::max());
+        }
+
+        // As above for a file known to end at expectedEnd: a short transfer that reaches it is
+        // taken as the end of the file, saving the zero-length read that would confirm it.
+        Option<size_t> ReadSomeAt(const u64 offset,
+                                  const std::span<u8> destination,
+                                  const u64 expectedEnd) const {
+            RIEGER_PROFILE_SCOPE("IO::FileHandle::ReadSomeAt");
+            size_t total = 0;
+            while (total < destination.size()) {
+                const size_t wanted = destination.size() - total;
+                const auto count =
+                  Transfer(offset + total, destination.data() + total, wanted, false);
+                if (!count.has_value()) {
+                    return kNone;
+                }
+
+                if (*count == 0) {
+                    break;
+                }
+
+                if (*count < wanted && offset + total + *count >= expectedEnd) {
+                    total += *count;
+                    break;
+                }
+
+                total += *count;
+            }
+
+            RIEGER_PROFILE_BYTES(total);
+            return total;
+        }
+
+        // Fills destination exactly; false on error or if the file ends first.
+        bool ReadAt(const u64 offset, const std::span<u8> destination) const {
+            const auto count = ReadSomeAt(offset, destination);
+            return count.has_value() && *count == destination.size();
+        }
+
+        bool WriteAt(const u64 offset, const std::span<const u8> source) const {
+            RIEGER_PROFILE_SCOPE("IO::FileHandle::WriteAt");
+            RIEGER_PROFILE_BYTES(source.size());
+            size_t total = 0;
+            while (total < source.size()) {
+                const auto count = Transfer(
+                  offset + total, CCAST<u8*>(source.data()) + total, source.size() - total, true);
+                if (!count.has_value() || *count == 0) {
+                    return false;
+                }
+
+                total += *count;
+            }
+
+            return true;
+        }
+
+        [[nodiscard]] Option<u64> Size() const {
+#if defined(_WIN32) || defined(_WIN64)
+            LARGE_INTEGER size {};
+            if (!::GetFileSizeEx(handle, &size)) {
+                return kNone;
+            }
+
+            return CAST<u64>(size.QuadPart);
+#else
+            struct stat info {};
+            if (::fstat(handle, &info) != 0) {
+                return kNone;
+            }
+
+            return CAST<u64>(info.st_size);
+#endif
+        }
+
+        [[nodiscard]] bool IsOpen() const noexcept {
+            return handle != kInvalid;
+        }
+
+        [[nodiscard]] Native NativeHandle() const noexcept {
+            return handle;
+        }
+
+        void Close() noexcept {
+            if (handle == kInvalid) {
+                return;
+            }
+
+#if defined(_WIN32) || defined(_WIN64)
+            ::CloseHandle(handle);
+#else
+            ::close(handle);
+#endif
+            handle = kInvalid;
+        }
+
+    private:
+        Native handle = kInvalid;
+
+        // One positional read or write; 0 means end of file.
+        Option<size_t>
+        Transfer(const u64 offset, u8* data, const size_t size, const bool write) const {
+#if defined(_WIN32) || defined(_WIN64)
+            constexpr size_t kMaxTransfer = 1u << 30;
+
+            OVERLAPPED request {};
+            request.Offset     = CAST<DWORD>(offset & 0xFFFFFFFF);
+            request.OffsetHigh = CAST<DWORD>(offset >> 32);
+            request.hEvent     = Detail::ThreadIoEvent();
+
+            const auto length = CAST<DWORD>(std::min(size, kMaxTransfer));
+            const BOOL issued = write ? ::WriteFile(handle, data, length, nullptr, &request)
+                                      : ::ReadFile(handle, data, length, nullptr, &request);
+            if (!issued && ::GetLastError() != ERROR_IO_PENDING) {
+                return ::GetLastError() == ERROR_HANDLE_EOF ? Option<size_t>(0) : kNone;
+            }
+
+            DWORD transferred = 0;
+            if (!::GetOverlappedResult(handle, &request, &transferred, TRUE)) {
+                return ::GetLastError() == ERROR_HANDLE_EOF ? Option<size_t>(0) : kNone;
+            }
+
+            return CAST<size_t>(transferred);
+#else
+            while (true) {
+                const auto position = CAST<off_t>(offset);
+                const ssize_t count = write ? ::pwrite(handle, data, size, position)
+                                            : ::pread(handle, data, size, position);
+                if (count >= 0) {
+                    return CAST<size_t>(count);
+                }
+
+                if (errno != EINTR) {
+                    return kNone;
+                }
+            }
+#endif
+        }
+    };
+
+    namespace Detail {
+        // A file opened for reading, sized from the open handle rather than a stat of the path.
+        struct ReadableFile {
+            FileHandle file;
+            u64 size      = 0;
+            bool seekable = true;
+
+            // Positional read, or a plain sequential one for pipes and character devices.
+            [[nodiscard]] Option<size_t> ReadSome(const u64 offset,
+                                                  const std::span<u8> destination) const {
+#if !defined(_WIN32) && !defined(_WIN64)
+                if (!seekable) {
+                    size_t total = 0;
+                    while (total < destination.size()) {
+                        const ssize_t count = ::read(file.NativeHandle(),
+                                                     destination.data() + total,
+                                                     destination.size() - total);
+                        if (count < 0 && errno == EINTR) {
+                            continue;
+                        }
+
+                        if (count < 0) {
+                            return kNone;
+                        }
+
+                        if (count == 0) {
+                            break;
+                        }
+
+                        total += CAST<size_t>(count);
+                    }
+
+                    return total;
+                }
+#endif
+
+                // A size of 0 may be a pseudo-file or device that reports none, so only a real
+                // size lets a short read stand for the end.
+                return file.ReadSomeAt(
+                  offset, destination, size > 0 ? size : std::numeric_limits<u64>::max());
+            }
+        };
+
+        inline Option<ReadableFile> OpenForReading(const Path& filename, std::error_code& error) {
+            auto file = FileHandle::Open(filename, FileAccess::Read, error);
+            if (!file.has_value()) {
+                return kNone;
+            }
+
+            ReadableFile readable;
+            readable.file = std::move(*file);
+
+#if defined(_WIN32) || defined(_WIN64)
+            LARGE_INTEGER fileSize {};
+            if (::GetFileSizeEx(readable.file.NativeHandle(), &fileSize)) {
+                readable.size = CAST<u64>(fileSize.QuadPart);
+            } else {
+                readable.seekable = false;
+            }
+#else
+            struct stat info {};
+            if (::fstat(readable.file.NativeHandle(), &info) != 0) {
+                error = LastError();
+                return kNone;
+            }
+
+            if (S_ISDIR(info.st_mode)) {
+                error = std::make_error_code(std::errc::is_a_directory);
+                return kNone;
+            }
+
+            readable.seekable = S_ISREG(info.st_mode) || S_ISBLK(info.st_mode);
+            readable.size     = S_ISREG(info.st_mode) ? CAST<u64>(info.st_size) : 0;
+#endif
+
+            return readable;
+        }
+
+        struct IgnoreBytes {
+            void Update(std::span<const u8>) noexcept {}
+        };
+
+        // ReadSome that hands the bytes to hasher a cache-sized piece at a time as they land,
+        // so they are hashed while still hot instead of in a second pass over the buffer.
+        template<class H>
+        Option<size_t> ReadSomeHashing(const ReadableFile& readable,
+                                       const u64 offset,
+                                       const std::span<u8> destination,
+                                       H& hasher) {
+            if constexpr (std::is_same_v<H, IgnoreBytes>) {
+                return readable.ReadSome(offset, destination);
+            } else {
+                constexpr size_t kPieceSize = 256 * 1024;
+
+                size_t total = 0;
+                while (total < destination.size()) {
+                    const auto piece = destination.subspan(
+                      total, std::min(kPieceSize, destination.size() - total));
+                    const auto count = readable.ReadSome(offset + total, piece);
+                    if (!count.has_value()) {
+                        return kNone;
+                    }
+
+                    hasher.Update(piece.first(*count));
+                    total += *count;
+                    if (*count < piece.size()) {
+                        break;
+                    }
+                }
+
+                return total;
+            }
+        }
+
+        // Fills the container with one allocation sized from the open file. The first read asks
+        // for one byte more than that, so coming up short is the end of file and a file read in
+        // full costs no extra call. Only a file that turns out longer (still growing, or a
+        // pseudo-file reporting 0) grows the container.
+        template<class Container, class H>
+        bool ReadToEnd(const ReadableFile& readable,
+                       Container& out,
+                       H& hasher,
+                       std::error_code& error) {
+            static_assert(sizeof(typename Container::value_type) == 1);
+            constexpr size_t kGrowSize = 64 * 1024;
+
+            out.resize(CAST<size_t>(readable.size) + 1);
+            size_t total = 0;
+            for (;;) {
+                auto* data       = RCAST<u8*>(out.data());
+                const auto count = ReadSomeHashing(
+                  readable, total, {data + total, out.size() - total}, hasher);
+                if (!count.has_value()) {
+                    error = LastError();
+                    return false;
+                }
+
+                total += *count;
+                if (total < out.size()) {
+                    break;
+                }
+
+                out.resize(out.size() + kGrowSize);
+            }
+
+            out.resize(total);
+            error.clear();
+            return true;
+        }
+
+        template<class Container>
+        bool ReadToEnd(const ReadableFile& readable, Container& out, std::error_code& error) {
+            IgnoreBytes ignore;
+            return ReadToEnd(readable, out, ignore, error);
+        }
+
+#if defined(_WIN32) || defined(_WIN64)
+        // Large files are read around the file cache. kNone sends the caller down the buffered
+        // path instead, e.g. when the volume refuses unbuffered handles.
+        inline Option<Vector<u8>> ReadAllUnbuffered(const Path& filename, const u64 size) {
+            auto file = WindowsAPI::UnbufferedFile::Open(filename);
+            if (!file.has_value()) {
+                return kNone;
+            }
+
+            Vector<u8> bytes(CAST<size_t>(size));
+            const auto count = file->Read(0, bytes);
+            if (!count.has_value() || *count != bytes.size()) {
+                return kNone;
+            }
+
+            return bytes;
+        }
+#endif
+
+        // Splits on '\n' the way std::getline does: no empty line after a trailing newline.
+        template<class Lines>
+        void SplitLines(const std::string_view content, Lines& lines) {
+            const char* cursor = content.data();
+            const char* end    = cursor + content.size();
+            while (cursor != end) {
+                const char* newline = FindNewline(cursor, end);
+                lines.emplace_back(cursor, newline);
+                cursor = newline == end ? end : newline + 1;
+            }
+        }
+
+        // std::ifstream's text mode on Windows turned CRLF into LF; keep that for Read and
+        // ReadAllLines now that they read raw bytes.
+        template<class String>
+        void TranslateNewlines([[maybe_unused]] String& content) {
+#if defined(_WIN32) || defined(_WIN64)
+            size_t write = 0;
+            for (size_t read = 0; read < content.size(); ++read) {
+                const bool crlf = content[read] == '\r' && read + 1 < content.size() &&
+                                  content[read + 1] == '\n';
+                if (!crlf) {
+                    content[write++] = content[read];
+                }
+            }
+
+            content.resize(write);
+#endif
+        }
+    }  // namespace Detail
+
+    // The overloads taking a std::error_code report why a read failed; the others just return
+    // kNone/false. None of them stat the path before opening it.
+    inline Option<str> Read(const Path& filename, std::error_code& error) {
+        RIEGER_PROFILE_SCOPE("IO::Read");
+        const auto file = Detail::OpenForReading(filename, error);
+        if (!file.has_value()) {
+            return kNone;
+        }
+
+        str content;
+        if (!Detail::ReadToEnd(*file, content, error)) {
+            return kNone;
+        }
+
+        RIEGER_PROFILE_BYTES(content.size());
+        Detail::TranslateNewlines(content);
+
+        return content;
+    }
+
+    inline Option<str> Read(const Path& filename) {
+        std::error_code error;
+        return Read(filename, error);
+    }
+
+    inline Option<Vector<u8>> ReadAllBytes(const Path& filename, std::error_code& error) {
+        RIEGER_PROFILE_SCOPE("IO::ReadAllBytes");
+        const auto file = Detail::OpenForReading(filename, error);
+        if (!file.has_value()) {
+            return kNone;
+        }
+
+#if defined(_WIN32) || defined(_WIN64)
+        if (file->seekable && file->size >= WindowsAPI::kUnbufferedThreshold) {
+            if (auto bytes = Detail::ReadAllUnbuffered(filename, file->size)) {
+                RIEGER_PROFILE_BYTES(bytes->size());
+                return bytes;
+            }
+        }
+#endif
+
+        Vector<u8> bytes;
+        if (!Detail::ReadToEnd(*file, bytes, error)) {
+            return kNone;
+        }
+
+        RIEGER_PROFILE_BYTES(bytes.size());
+        return bytes;
+    }
+
+    inline Option<Vector<u8>> ReadAllBytes(const Path& filename) {
+        std::error_code error;
+        return ReadAllBytes(filename, error);
+    }
+
+    // Hashes the content as it is read, e.g. into a Hash::XXH3State or Hash::CRC32CState, so
+    // checking a file against a known digest costs no second pass over memory.
+    template<Hash::Hasher H>
+    Option<Vector<u8>> ReadAllBytes(const Path& filename, H& hasher, std::error_code& error) {
+        RIEGER_PROFILE_SCOPE("IO::ReadAllBytes");
+        const auto file = Detail::OpenForReading(filename, error);
+        if (!file.has_value()) {
+            return kNone;
+        }
+
+#if defined(_WIN32) || defined(_WIN64)
+        if (file->seekable && file->size >= WindowsAPI::kUnbufferedThreshold) {
+            if (auto bytes = Detail::ReadAllUnbuffered(filename, file->size)) {
+                RIEGER_PROFILE_BYTES(bytes->size());
+                hasher.Update(*bytes);
+                return bytes;
+            }
+        }
+#endif
+
+        Vector<u8> bytes;
+        if (!Detail::ReadToEnd(*file, bytes, hasher, error)) {
+            return kNone;
+        }
+
+        RIEGER_PROFILE_BYTES(bytes.size());
+        return bytes;
+    }
+
+    template<Hash::Hasher H>
+    Option<Vector<u8>> ReadAllBytes(const Path& filename, H& hasher) {
+        std::error_code error;
+        return ReadAllBytes(filename, hasher, error);
+    }
+
+    inline Option<Vector<str>> ReadAllLines(const Path& filename, std::error_code& error) {
+        RIEGER_PROFILE_SCOPE("IO::ReadAllLines");
+        const auto content = Read(filename, error);
+        if (!content.has_value()) {
+            return kNone;
+        }
+
+        RIEGER_PROFILE_BYTES(content->size());
+
+        Vector<str> lines;
+        Detail::SplitLines(*content, lines);
+
+        return lines;
+    }
+
+    inline Option<Vector<str>> ReadAllLines(const Path& filename) {
+        std::error_code error;
+        return ReadAllLines(filename, error);
+    }
+
+    // Arena-backed variants: the result and everything it owns are allocated from the arena,
+    // so they are freed in bulk by Arena::Reset() and must not outlive it.
+    inline Option<ArenaString> Read(const Path& filename, Arena& arena, std::error_code& error) {
+        RIEGER_PROFILE_SCOPE("IO::Read");
+        const auto file = Detail::OpenForReading(filename, error);
+        if (!file.has_value()) {
+            return kNone;
+        }
+
+        ArenaString content(arena.Allocator<char>());
+        if (!Detail::ReadToEnd(*file, content, error)) {
+            return kNone;
+        }
+
+        RIEGER_PROFILE_BYTES(content.size());
+        Detail::TranslateNewlines(content);
+
+        return content;
+    }
+
+    inline Option<ArenaString> Read(const Path& filename, Arena& arena) {
+        std::error_code error;
+        return Read(filename, arena, error);
+    }
+
+    inline Option<ArenaVector<u8>>
+    ReadAllBytes(const Path& filename, Arena& arena, std::error_code& error) {
+        RIEGER_PROFILE_SCOPE("IO::ReadAllBytes");
+        const auto file = Detail::OpenForReading(filename, error);
+        if (!file.has_value()) {
+            return kNone;
+        }
+
+        ArenaVector<u8> bytes(arena.Allocator<u8>());
+        if (!Detail::ReadToEnd(*file, bytes, error)) {
+            return kNone;
+        }
+
+        RIEGER_PROFILE_BYTES(bytes.size());
+        return bytes;
+    }
+
+    inline Option<ArenaVector<u8>> ReadAllBytes(const Path& filename, Arena& arena) {
+        std::error_code error;
+        return ReadAllBytes(filename, arena, error);
+    }
+
+    // The whole file is read into one ordinary buffer first; only the lines go to the arena.
+    inline Option<ArenaVector<ArenaString>>
+    ReadAllLines(const Path& filename, Arena& arena, std::error_code& error) {
+        RIEGER_PROFILE_SCOPE("IO::ReadAllLines");
+        const auto content = Read(filename, error);
+        if (!content.has_value()) {
+            return kNone;
+        }
+
+        RIEGER_PROFILE_BYTES(content->size());
+
+        ArenaVector<ArenaString> lines(arena.Allocator<ArenaString>());
+        Detail::SplitLines(*content, lines);
+
+        return lines;
+    }
+
+    inline Option<ArenaVector<ArenaString>> ReadAllLines(const Path& filename, Arena& arena) {
+        std::error_code error;
+        return ReadAllLines(filename, arena, error);
+    }
+
+    inline bool ReadBlock(const Path& filename,
+                          const u64 blockOffset,
+                          const std::span<u8> destination,
+                          std::error_code& error) {
+        RIEGER_PROFILE_SCOPE("IO::ReadBlock");
+#if defined(_WIN32) || defined(_WIN64)
+        if (destination.size() >= WindowsAPI::kUnbufferedThreshold) {
+            if (auto unbuffered = WindowsAPI::UnbufferedFile::Open(filename)) {
+                const auto count = unbuffered->Read(blockOffset, destination);
+                if (count.has_value()) {
+                    if (*count != destination.size()) {
+                        error = std::make_error_code(std::errc::result_out_of_range);
+                        return false;
+                    }
+
+                    RIEGER_PROFILE_BYTES(*count);
+                    error.clear();
+                    return true;
+                }
+            }
+        }
+#endif
+
+        const auto file = FileHandle::Open(filename, FileAccess::Read, error);
+        if (!file.has_value()) {
+            return false;
+        }
+
+        const auto count = file->ReadSomeAt(blockOffset, destination);
+        if (!count.has_value()) {
+            error = Detail::LastError();
+            return false;
+        }
+
+        if (*count != destination.size()) {
+            error = std::make_error_code(std::errc::result_out_of_range);
+            return false;
+        }
+
+        RIEGER_PROFILE_BYTES(*count);
+        return true;
+    }
+
+    inline bool ReadBlock(const Path& filename, const u64 blockOffset, std::span<u8> destination) {
+        std::error_code error;
+        return ReadBlock(filename, blockOffset, destination, error);
+    }
+
+    inline Option<Vector<u8>> ReadBlock(const Path& filename,
+                                        const u64 blockOffset,
+                                        const size_t blockSize,
+                                        std::error_code& error) {
+        Vector<u8> buffer(blockSize);
+        if (!ReadBlock(filename, blockOffset, buffer, error)) {
+            return kNone;
+        }
+
+        return buffer;
+    }
+
+    inline Option<Vector<u8>>
+    ReadBlock(const Path& filename, const u64 blockOffset, const size_t blockSize) {
+        std::error_code error;
+        return ReadBlock(filename, blockOffset, blockSize, error);
+    }
+
+    enum class MapMode : u8 {
+        ReadOnly,
+        ReadWrite,
+    };
+
+    // Read-only or read-write view of a file's contents backed by the OS page cache. Unlike
+    // ReadAllBytes, nothing is copied; the view stays valid until the MappedFile is closed or
+    // destroyed.
+    class MappedFile {
+    public:
+        MappedFile() = default;
+
+        ~MappedFile() {
+            Close();
+        }
+
+        MappedFile(const MappedFile&)            = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        MappedFile(MappedFile&& other) noexcept {
+            *this = std::move(other);
+        }
+
+        MappedFile& operator=(MappedFile&& other) noexcept {
+            if (this != &other) {
+                Close();
+                data = std::exchange(other.data, nullptr);
+                size = std::exchange(other.size, 0);
+                mode = other.mode;
+#if defined(_WIN32) || defined(_WIN64)
+                file = std::exchange(other.file, INVALID_HANDLE_VALUE);
+#endif
+            }
+
+            return *this;
+        }
+
+        static Option<MappedFile> Open(const Path& filename,
+                                       const MapMode mode = MapMode::ReadOnly) {
+            RIEGER_PROFILE_SCOPE("IO::MappedFile::Open");
+            MappedFile mapped;
+            mapped.mode         = mode;
+            const bool writable = mode == MapMode::ReadWrite;
+
+#if defined(_WIN32) || defined(_WIN64)
+            const DWORD access = writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ;
+            mapped.file        = ::CreateFileW(filename.c_str(),
+                                               access,
+                                               FILE_SHARE_READ,
+                                               nullptr,
+                                               OPEN_EXISTING,
+                                               FILE_ATTRIBUTE_NORMAL,
+                                               nullptr);
+            if (mapped.file == INVALID_HANDLE_VALUE) {
+                return kNone;
+            }
+
+            LARGE_INTEGER fileSize {};
+            if (!::GetFileSizeEx(mapped.file, &fileSize)) {
+                return kNone;
+            }
+
+            mapped.size = CAST<size_t>(fileSize.QuadPart);
+            if (mapped.size == 0) {
+                return mapped;
+            }
+
+            HANDLE mapping = ::CreateFileMappingW(
+              mapped.file, nullptr, writable ? PAGE_READWRITE : PAGE_READONLY, 0, 0, nullptr);
+            if (!mapping) {
+                return kNone;
+            }
+
+            void* view = ::MapViewOfFile(
+              mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, mapped.size);
+            ::CloseHandle(mapping);
+            if (!view) {
+                return kNone;
+            }
+#else
+            const int fd = ::open(filename.c_str(), (writable ? O_RDWR : O_RDONLY) | O_CLOEXEC);
+            if (fd < 0) {
+                return kNone;
+            }
+
+            struct stat info {};
+            if (::fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+                ::close(fd);
+                return kNone;
+            }
+
+            mapped.size = CAST<size_t>(info.st_size);
+            if (mapped.size == 0) {
+                ::close(fd);
+                return mapped;
+            }
+
+            const int protection = writable ? PROT_READ | PROT_WRITE : PROT_READ;
+            void* view           = ::mmap(nullptr, mapped.size, protection, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (view == MAP_FAILED) {
+                return kNone;
+            }
+#endif
+
+            mapped.data = CAST<u8*>(view);
+            return mapped;
+        }
+
+        [[nodiscard]] std::span<const u8> View() const noexcept {
+            return {data, size};
+        }
+
+        // Empty unless the file was opened with MapMode::ReadWrite.
+        [[nodiscard]] std::span<u8> MutableView() noexcept {
+            if (mode != MapMode::ReadWrite) {
+                return {};
+            }
+
+            return {data, size};
+        }
+
+        [[nodiscard]] const u8* Data() const noexcept {
+            return data;
+        }
+
+        [[nodiscard]] size_t Size() const noexcept {
+            return size;
+        }
+
+        [[nodiscard]] bool Empty() const noexcept {
+            return size == 0;
+        }
+
+        [[nodiscard]] MapMode Mode() const noexcept {
+            return mode;
+        }
+
+        // Writes modified pages back to the file and waits for completion.
+        bool Flush() const {
+            if (mode != MapMode::ReadWrite || !data) {
+                return true;
+            }
+
+#if defined(_WIN32) || defined(_WIN64)
+            return ::FlushViewOfFile(data, size) && ::FlushFileBuffers(file);
+#else
+            return ::msync(data, size, MS_SYNC) == 0;
+#endif
+        }
+
+        void Close() noexcept {
+#if defined(_WIN32) || defined(_WIN64)
+            if (data) {
+                ::UnmapViewOfFile(data);
+            }
+
+            if (file != INVALID_HANDLE_VALUE) {
+                ::CloseHandle(file);
+                file = INVALID_HANDLE_VALUE;
+            }
+#else
+            if (data) {
+                ::munmap(data, size);
+            }
+#endif
+
+            data = nullptr;
+            size = 0;
+        }
+
+    private:
+        u8* data     = nullptr;
+        size_t size  = 0;
+        MapMode mode = MapMode::ReadOnly;
+#if defined(_WIN32) || defined(_WIN64)
+        HANDLE file = INVALID_HANDLE_VALUE;
+#endif
+    };
+
+    // Every line of a file as a string_view into one mapping of it, instead of a str per line.
+    // Lines split on '\n' like ReadAllLines; a trailing '\r' is dropped from each line so CRLF
+    // files need no copy. The views stay valid for the lifetime of the LineView.
+    class LineView {
+    public:
+        using Iterator = Vector<std::string_view>::const_iterator;
+
+        LineView() = default;
+
+        static Option<LineView> Open(const Path& filename) {
+            auto mapped = MappedFile::Open(filename);
+            if (!mapped.has_value()) {
+                return kNone;
+            }
+
+            LineView view;
+            view.file = std::move(*mapped);
+
+            const auto* cursor = RCAST<const char*>(view.file.Data());
+            const auto* end    = cursor + view.file.Size();
+            while (cursor != end) {
+                const char* newline = Detail::FindNewline(cursor, end);
+                const char* lineEnd = newline;
+                if (lineEnd != cursor && *(lineEnd - 1) == '\r') {
+                    --lineEnd;
+                }
+
+                view.lines.emplace_back(cursor, CAST<size_t>(lineEnd - cursor));
+                cursor = newline == end ? end : newline + 1;
+            }
+
+            return view;
+        }
+
+        [[nodiscard]] const Vector<std::string_view>& Lines() const noexcept {
+            return lines;
+        }
+
+        [[nodiscard]] std::string_view operator[](const size_t index) const noexcept {
+            return lines[index];
+        }
+
+        [[nodiscard]] size_t Count() const noexcept {
+            return lines.size();
+        }
+
+        [[nodiscard]] bool Empty() const noexcept {
+            return lines.empty();
+        }
+
+        [[nodiscard]] Iterator begin() const noexcept {
+            return lines.begin();
+        }
+
+        [[nodiscard]] Iterator end() const noexcept {
+            return lines.end();
+        }
+
+        // The mapped file contents the lines point into.
+        [[nodiscard]] std::string_view Contents() const noexcept {
+            return {RCAST<const char*>(file.Data()), file.Size()};
+        }
+
+    private:
+        MappedFile file;
+        Vector<std::string_view> lines;
+    };
+
+    // Streams a file through one reused buffer, yielding up to buffer-sized chunks in order so
+    // memory use stays constant regardless of file size. Each chunk is only valid until the next
+    // one is read. Use Next(), ForEach() or a range-for loop.
+    class ChunkReader {
+    public:
+        static constexpr size_t kDefaultChunkSize = 1024 * 1024;
+
+        using Iterator = Detail::ReaderIterator<ChunkReader, std::span<const u8>>;
+
+        ChunkReader() = default;
+
+        static Option<ChunkReader> Open(const Path& filename,
+                                        const size_t chunkSize = kDefaultChunkSize) {
+            if (chunkSize == 0) {
+                return kNone;
+            }
+
+            auto reader = OpenStream(filename);
+            if (reader.has_value()) {
+                reader->ownedBuffer.resize(chunkSize);
+                reader->buffer = reader->ownedBuffer;
+            }
+
+            return reader;
+        }
+
+        // Reads into caller-owned storage, which must outlive the reader.
+        static Option<ChunkReader> Open(const Path& filename, const std::span<u8> buffer) {
+            if (buffer.empty()) {
+                return kNone;
+            }
+
+            auto reader = OpenStream(filename);
+            if (reader.has_value()) {
+                reader->buffer = buffer;
+            }
+
+            return reader;
+        }
+
+        // The next chunk, or kNone at end of file or on a read error (see Failed()).
+        Option<std::span<const u8>> Next() {
+            if (finished) {
+                return kNone;
+            }
+
+            RIEGER_PROFILE_SCOPE("IO::ChunkReader::Next");
+            const auto count = file.ReadSome(position, buffer);
+            if (!count.has_value() || *count == 0) {
+                failed   = !count.has_value();
+                finished = true;
+                return kNone;
+            }
+
+            RIEGER_PROFILE_BYTES(*count);
+            position += *count;
+            return std::span<const u8>(buffer.data(), *count);
+        }
+
+        template<class Callback>
+        bool ForEach(Callback&& callback) {
+            return Detail::Drain<ChunkReader, std::span<const u8>>(*this, callback);
+        }
+
+        [[nodiscard]] bool Failed() const {
+            return failed;
+        }
+
+        [[nodiscard]] size_t ChunkSize() const noexcept {
+            return buffer.size();
+        }
+
+        Iterator begin() {
+            return Iterator(this);
+        }
+
+        std::default_sentinel_t end() const noexcept {
+            return {};
+        }
+
+    private:
+        Detail::ReadableFile file;
+        Vector<u8> ownedBuffer;
+        std::span<u8> buffer;
+        u64 position  = 0;
+        bool finished = false;
+        bool failed   = false;
+
+        static Option<ChunkReader> OpenStream(const Path& filename) {
+            std::error_code error;
+            auto file = Detail::OpenForReading(filename, error);
+            if (!file.has_value()) {
+                return kNone;
+            }
+
+            ChunkReader reader;
+            reader.file = std::move(*file);
+            return reader;
+        }
+    };
+
+    // Line-oriented ChunkReader. Lines split on '\n' with a trailing '\r' dropped, like
+    // LineView; a line that straddles chunks is stitched together in a reused carry string.
+    // Each line is only valid until the next one is read.
+    class LineReader {
+    public:
+        using Iterator = Detail::ReaderIterator<LineReader, std::string_view>;
+
+        LineReader() = default;
+
+        static Option<LineReader> Open(const Path& filename,
+                                       const size_t chunkSize = ChunkReader::kDefaultChunkSize) {
+            return FromChunks(ChunkReader::Open(filename, chunkSize));
+        }
+
+        static Option<LineReader> Open(const Path& filename, const std::span<u8> buffer) {
+            return FromChunks(ChunkReader::Open(filename, buffer));
+        }
+
+        Option<std::string_view> Next() {
+            if (carryReturned) {
+                carry.clear();
+                carryReturned = false;
+            }
+
+            while (true) {
+                if (position < chunk.size()) {
+                    const auto* begin   = RCAST<const char*>(chunk.data()) + position;
+                    const auto* end     = RCAST<const char*>(chunk.data()) + chunk.size();
+                    const char* newline = Detail::FindNewline(begin, end);
+
+                    if (newline == end) {
+                        carry.append(begin, end);
+                        position = chunk.size();
+                        continue;
+                    }
+
+                    position += CAST<size_t>(newline - begin) + 1;
+                    if (carry.empty()) {
+                        return TrimCarriageReturn({begin, CAST<size_t>(newline - begin)});
+                    }
+
+                    carry.append(begin, newline);
+                    carryReturned = true;
+                    return TrimCarriageReturn(carry);
+                }
+
+                const auto next = chunks.Next();
+                if (!next.has_value()) {
+                    if (carry.empty()) {
+                        return kNone;
+                    }
+
+                    carryReturned = true;
+                    return TrimCarriageReturn(carry);
+                }
+
+                chunk    = *next;
+                position = 0;
+            }
+        }
+
+        template<class Callback>
+        bool ForEach(Callback&& callback) {
+            return Detail::Drain<LineReader, std::string_view>(*this, callback);
+        }
+
+        [[nodiscard]] bool Failed() const {
+            return chunks.Failed();
+        }
+
+        Iterator begin() {
+            return Iterator(this);
+        }
+
+        std::default_sentinel_t end() const noexcept {
+            return {};
+        }
+
+    private:
+        ChunkReader chunks;
+        std::span<const u8> chunk;
+        size_t position = 0;
+        str carry;
+        bool carryReturned = false;
+
+        static Option<LineReader> FromChunks(Option<ChunkReader>&& chunks) {
+            if (!chunks.has_value()) {
+                return kNone;
+            }
+
+            LineReader reader;
+            reader.chunks = std::move(*chunks);
+            return reader;
+        }
+
+        static std::string_view TrimCarriageReturn(std::string_view line) {
+            if (!line.empty() && line.back() == '\r') {
+                line.remove_suffix(1);
+            }
+
+            return line;
+        }
+    };
+
+    enum class WriteMode : u8 {
+        // Truncate the target and write it in place.
+        InPlace,
+        // Write a sibling temporary file and rename it over the target, so readers and crashes
+        // see either the old or the new contents. Nothing is forced to disk, so a power loss can
+        // still drop the update.
+        Atomic,
+        // Atomic, plus syncing the temporary file's data before the rename and the directory
+        // entry after it.
+        AtomicDurable,
+    };
+
+    namespace Detail {
+        inline Path TemporarySibling(const Path& target) {
+            static std::atomic<u32> counter = 0;
+
+#if defined(_WIN32) || defined(_WIN64)
+            const auto process = CAST<u64>(::GetCurrentProcessId());
+#else
+            const auto process = CAST<u64>(::getpid());
+#endif
+
+            Path temporary = target;
+            temporary += ".~" + std::to_string(process) + "." + std::to_string(counter++) + ".tmp";
+            return temporary;
+        }
+
+        inline bool SyncFile(const Path& filename) {
+#if defined(_WIN32) || defined(_WIN64)
+            HANDLE file = ::CreateFileW(filename.c_str(),
+                                        GENERIC_WRITE,
+                                        FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                        nullptr,
+                                        OPEN_EXISTING,
+                                        FILE_ATTRIBUTE_NORMAL,
+                                        nullptr);
+            if (file == INVALID_HANDLE_VALUE) {
+                return false;
+            }
+
+            const bool synced = ::FlushFileBuffers(file) != 0;
+            ::CloseHandle(file);
+            return synced;
+#else
+            const int fd = ::open(filename.c_str(), O_WRONLY | O_CLOEXEC);
+            if (fd < 0) {
+                return false;
+            }
+
+    #if defined(__APPLE__)
+            const bool synced = ::fsync(fd) == 0;
+    #else
+            const bool synced = ::fdatasync(fd) == 0;
+    #endif
+            ::close(fd);
+            return synced;
+#endif
+        }
+
+        // Makes a completed rename survive power loss. NTFS journals the rename itself.
+        inline void SyncDirectory([[maybe_unused]] const Path& directory) {
+#if !defined(_WIN32) && !defined(_WIN64)
+            const int fd = ::open(directory.empty() ? "." : directory.c_str(),
+                                  O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            if (fd >= 0) {
+                ::fsync(fd);
+                ::close(fd);
+            }
+#endif
+        }
+
+        inline bool RenameOver(const Path& source, const Path& target) {
+#if defined(_WIN32) || defined(_WIN64)
+            // ReplaceFileW keeps the target's attributes and ACLs but needs it to exist.
+            if (::ReplaceFileW(target.c_str(),
+                               source.c_str(),
+                               nullptr,
+                               REPLACEFILE_IGNORE_MERGE_ERRORS,
+                               nullptr,
+                               nullptr)) {
+                return true;
+            }
+
+            return ::MoveFileExW(source.c_str(),
+                                 target.c_str(),
+                                 MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+            return ::rename(source.c_str(), target.c_str()) == 0;
+#endif
+        }
+
+        // Runs writeTemporary against a sibling of filename, then swaps it into place. The
+        // temporary is removed on any failure and the target is left untouched.
+        template<class WriteTemporary>
+        bool WriteReplacing(const Path& filename,
+                            const WriteMode mode,
+                            WriteTemporary&& writeTemporary) {
+            const Path temporary = TemporarySibling(filename);
+            const bool durable   = mode == WriteMode::AtomicDurable;
+
+            std::error_code error;
+            bool success = writeTemporary(temporary);
+            if (success) {
+                const auto existing = FileSystem::status(filename, error);
+                if (!error && FileSystem::exists(existing)) {
+                    FileSystem::permissions(temporary, existing.permissions(), error);
+                }
+            }
+
+            success = success && (!durable || SyncFile(temporary));
+            success = success && RenameOver(temporary, filename);
+            if (!success) {
+                FileSystem::remove(temporary, error);
+                return false;
+            }
+
+            if (durable) {
+                SyncDirectory(filename.parent_path());
+            }
+
+            return true;
+        }
+    }  // namespace Detail
+
+    inline bool Write(const Path& filename,
+                      const str& content,
+                      const WriteMode mode = WriteMode::InPlace) {
+        RIEGER_PROFILE_SCOPE("IO::Write");
+        if (mode != WriteMode::InPlace) {
+            return Detail::WriteReplacing(
+              filename, mode, [&](const Path& temporary) { return Write(temporary, content); });
+        }
+
+        std::ofstream outfile(filename);
+        if (!outfile.is_open()) {
+            return false;
+        }
+
+        outfile.write(content.c_str(), CAST<std::streamsize>(content.length()));
+        outfile.close();
+        RIEGER_PROFILE_BYTES(content.length());
+
+        return !outfile.fail();
+    }
+
+    inline bool WriteAllBytes(const Path& filename,
+                              const Vector<u8>& bytes,
+                              const WriteMode mode = WriteMode::InPlace) {
+        RIEGER_PROFILE_SCOPE("IO::WriteAllBytes");
+        if (mode != WriteMode::InPlace) {
+            return Detail::WriteReplacing(filename, mode, [&](const Path& temporary) {
+                return WriteAllBytes(temporary, bytes);
+            });
+        }
+
+        std::ofstream outfile(filename, std::ios::binary);
+        if (!outfile.is_open()) {
+            return false;
+        }
+
+        outfile.write(RCAST<const char*>(bytes.data()), CAST<std::streamsize>(bytes.size()));
+        outfile.close();
+        RIEGER_PROFILE_BYTES(bytes.size());
+
+        return !outfile.fail();
+    }
+
+    inline bool WriteAllLines(const Path& filename, const Vector<str>& lines) {
+        RIEGER_PROFILE_SCOPE("IO::WriteAllLines");
+        std::ofstream outfile(filename);
+        if (!outfile.is_open()) {
+            return false;
+        }
+
+        for (const auto& line : lines) {
+            outfile << line << '\n';
+            RIEGER_PROFILE_BYTES(line.size() + 1);
+        }
+
+        outfile.close();
+
+        return true;
+    }
+
+    // Buffered line output: lines are copied into one buffer and written when it fills, on
+    // Flush() or on destruction, instead of a flush per line. A line that does not fit is written
+    // straight from the caller's memory together with the buffered bytes in a single gather write
+    // (writev). Each line is terminated with '\n'. Write errors are sticky; check the return of
+    // Flush() or Close() since the destructor cannot report them.
+    class LineWriter {
+    public:
+        static constexpr size_t kDefaultBufferSize = 64 * 1024;
+
+        LineWriter() = default;
+
+        ~LineWriter() {
+            Close();
+        }
+
+        LineWriter(const LineWriter&)            = delete;
+        LineWriter& operator=(const LineWriter&) = delete;
+
+        LineWriter(LineWriter&& other) noexcept {
+            *this = std::move(other);
+        }
+
+        // Flushes and closes this writer's own file before taking over other's.
+        LineWriter& operator=(LineWriter&& other) noexcept {
+            if (this != &other) {
+                Close();
+                file   = std::move(other.file);
+                buffer = std::exchange(other.buffer, {});
+                used   = std::exchange(other.used, 0);
+                offset = std::exchange(other.offset, 0);
+                failed = std::exchange(other.failed, false);
+            }
+
+            return *this;
+        }
+
+        // Creates the file, truncating any existing contents.
+        static Option<LineWriter> Open(const Path& filename,
+                                       const size_t bufferSize = kDefaultBufferSize) {
+            auto file = FileHandle::Open(filename, FileAccess::Create);
+            if (!file.has_value()) {
+                return kNone;
+            }
+
+            LineWriter writer;
+            writer.file = std::move(*file);
+            writer.buffer.resize(std::max<size_t>(bufferSize, 1));
+            return writer;
+        }
+
+        bool WriteLine(const std::string_view line) {
+            if (failed) {
+                return false;
+            }
+
+            if (line.size() < buffer.size() - used) {
+                std::copy(line.begin(), line.end(), buffer.begin() + CAST<ptrdiff_t>(used));
+                used += line.size();
+                buffer[used++] = '\n';
+                return true;
+            }
+
+            const std::string_view pieces[] = {{buffer.data(), used}, line, "\n"};
+            used                            = 0;
+            return Gather(pieces);
+        }
+
+        bool WriteLines(const std::span<const std::string_view> lines) {
+            for (const auto line : lines) {
+                if (!WriteLine(line)) {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        bool WriteLines(const std::span<const str> lines) {
+            for (const auto& line : lines) {
+                if (!WriteLine(line)) {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        bool Flush() {
+            if (failed) {
+                return false;
+            }
+
+            const std::string_view pieces[] = {{buffer.data(), used}};
+            used                            = 0;
+            return Gather(pieces);
+        }
+
+        // Flushes and releases the file; returns false if any write failed.
+        bool Close() {
+            if (!file.IsOpen()) {
+                return !failed;
+            }
+
+            const bool flushed = Flush();
+            file.Close();
+            return flushed;
+        }
+
+    private:
+        FileHandle file;
+        Vector<char> buffer;
+        size_t used = 0;
+        u64 offset  = 0;
+        bool failed = false;
+
+        template<size_t Count>
+        bool Gather(const std::string_view (&pieces)[Count]) {
+            RIEGER_PROFILE_SCOPE("IO::LineWriter::Write");
+            for (const auto piece : pieces) {
+                RIEGER_PROFILE_BYTES(piece.size());
+            }
+
+#if defined(_WIN32) || defined(_WIN64)
+            // WriteFileGather only takes page-sized, unbuffered segments, so write in turn.
+            for (const auto piece : pieces) {
+                const auto* data = RCAST<const u8*>(piece.data());
+                if (!file.WriteAt(offset, {data, piece.size()})) {
+                    failed = true;
+                    return false;
+                }
+
+                offset += piece.size();
+            }
+#else
+            iovec vectors[Count];
+            int count = 0;
+            for (const auto piece : pieces) {
+                if (!piece.empty()) {
+                    vectors[count].iov_base = CCAST<char*>(piece.data());
+                    vectors[count].iov_len  = piece.size();
+                    ++count;
+                }
+            }
+
+            iovec* next = vectors;
+            while (count > 0) {
+                const auto position   = CAST<off_t>(offset);
+                const ssize_t written = ::pwritev(file.NativeHandle(), next, count, position);
+                if (written < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+
+                    failed = true;
+                    return false;
+                }
+
+                offset += CAST<u64>(written);
+                auto remaining = CAST<size_t>(written);
+                while (count > 0 && remaining >= next->iov_len) {
+                    remaining -= next->iov_len;
+                    ++next;
+                    --count;
+                }
+
+                if (count > 0) {
+                    next->iov_base = CAST<char*>(next->iov_base) + remaining;
+                    next->iov_len -= remaining;
+                }
+            }
+#endif
+
+            return true;
+        }
+    };
+
+    enum class AsyncBackend : u8 {
+        IoUring,
+        Iocp,
+        ThreadPool,
+    };
+
+    namespace Detail {
+        using AsyncReadCallback  = std::function<void(Option<Vector<u8>>)>;
+        using AsyncWriteCallback = std::function<void(bool)>;
+
+        struct AsyncOperation {
+            enum class Kind : u8 {
+                ReadAllBytes,
+                ReadBlock,
+                WriteAllBytes,
+            };
+
+#if defined(_WIN32) || defined(_WIN64)
+            // First member so a completed LPOVERLAPPED converts straight back to its operation.
+            OVERLAPPED overlapped {};
+#endif
+            Kind kind = Kind::ReadAllBytes;
+            Path filename;
+            u64 offset  = 0;
+            size_t size = 0;
+            size_t done = 0;
+            // Set for whole-file reads of files that report size 0, e.g. procfs and sysfs, which
+            // are read until a zero-byte transfer as ReadAllBytes does.
+            bool toEndOfFile = false;
+            Vector<u8> buffer;
+            FileHandle::Native handle = FileHandle::kInvalid;
+            AsyncReadCallback onRead;
+            AsyncWriteCallback onWrite;
+
+            enum class Progress : u8 {
+                Pending,
+                Done,
+                Failed,
+            };
+
+            static constexpr size_t kGrowSize = 64 * 1024;
+
+            // Opens the file and sizes the transfer for the native backends.
+            bool Prepare() {
+                const bool write = kind == Kind::WriteAllBytes;
+
+#if defined(_WIN32) || defined(_WIN64)
+                handle = ::CreateFileW(filename.c_str(),
+                                       write ? GENERIC_WRITE : GENERIC_READ,
+                                       write ? 0 : FILE_SHARE_READ,
+                                       nullptr,
+                                       write ? CREATE_ALWAYS : OPEN_EXISTING,
+                                       FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED,
+                                       nullptr);
+#else
+                constexpr int kWriteFlags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+                handle                    = write ? ::open(filename.c_str(), kWriteFlags, 0666)
+                               : ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+#endif
+                if (handle == FileHandle::kInvalid) {
+                    return false;
+                }
+
+                if (kind == Kind::ReadAllBytes) {
+#if defined(_WIN32) || defined(_WIN64)
+                    LARGE_INTEGER fileSize {};
+                    if (!::GetFileSizeEx(handle, &fileSize)) {
+                        return false;
+                    }
+
+                    size = CAST<size_t>(fileSize.QuadPart);
+#else
+                    struct stat info {};
+                    if (::fstat(handle, &info) != 0 || S_ISDIR(info.st_mode)) {
+                        return false;
+                    }
+
+                    size = CAST<size_t>(info.st_size);
+#endif
+                    if (size == 0) {
+                        toEndOfFile = true;
+                        size        = kGrowSize;
+                    }
+                }
+
+                if (kind != Kind::WriteAllBytes) {
+                    buffer.resize(size);
+                }
+
+                return true;
+            }
+
+            // Accounts for one completed transfer. A zero-byte transfer is end of file, which only
+            // whole-file reads accept (the file shrank since it was sized).
+            Progress Advance(const size_t transferred) {
+                if (transferred == 0) {
+                    if (kind != Kind::ReadAllBytes) {
+                        return Progress::Failed;
+                    }
+
+                    buffer.resize(done);
+                    return Progress::Done;
+                }
+
+                done += transferred;
+                if (toEndOfFile && done >= size) {
+                    size += kGrowSize;
+                    buffer.resize(size);
+                }
+
+                return done >= size ? Progress::Done : Progress::Pending;
+            }
+
+            // The next unfinished region of the transfer.
+            [[nodiscard]] u64 Position() const noexcept {
+                return offset + done;
+            }
+
+            [[nodiscard]] u8* Cursor() noexcept {
+                return buffer.data() + done;
+            }
+
+            [[nodiscard]] size_t Remaining() const noexcept {
+                return size - done;
+            }
+
+            void Complete(const bool success) {
+                if (handle != FileHandle::kInvalid) {
+#if defined(_WIN32) || defined(_WIN64)
+                    ::CloseHandle(handle);
+#else
+                    ::close(handle);
+#endif
+                    handle = FileHandle::kInvalid;
+                }
+
+                if (kind == Kind::WriteAllBytes) {
+                    if (onWrite) {
+                        onWrite(success);
+                    }
+                } else if (onRead) {
+                    onRead(success ? Option<Vector<u8>>(std::move(buffer)) : kNone);
+                }
+            }
+        };
+
+        using AsyncBatch = Vector<Unique<AsyncOperation>>;
+
+        class AsyncEngine {
+        public:
+            virtual ~AsyncEngine() = default;
+
+            [[nodiscard]] virtual AsyncBackend Backend() const noexcept = 0;
+
+            void Enqueue(AsyncBatch batch) {
+                if (batch.empty()) {
+                    return;
+                }
+
+                {
+                    std::lock_guard lock(stateMutex);
+                    outstanding += batch.size();
+                }
+
+                Submit(std::move(batch));
+            }
+
+            void Wait() {
+                std::unique_lock lock(stateMutex);
+                idle.wait(lock, [this] { return outstanding == 0; });
+            }
+
+        protected:
+            virtual void Submit(AsyncBatch batch) = 0;
+
+            void Finish(Unique<AsyncOperation> operation, const bool success) {
+                operation->Complete(success);
+                operation.reset();
+
+                std::lock_guard lock(stateMutex);
+                if (--outstanding == 0) {
+                    idle.notify_all();
+                }
+            }
+
+            // Native operations that complete without touching the device (failed opens, empty
+            // transfers) finish on the submitting thread; the rest are returned for submission.
+            AsyncBatch PrepareBatch(AsyncBatch batch) {
+                AsyncBatch ready;
+                ready.reserve(batch.size());
+                for (auto& operation : batch) {
+                    if (!operation->Prepare()) {
+                        Finish(std::move(operation), false);
+                    } else if (operation->Remaining() == 0) {
+                        Finish(std::move(operation), true);
+                    } else {
+                        ready.push_back(std::move(operation));
+                    }
+                }
+
+                return ready;
+            }
+
+        private:
+            std::mutex stateMutex;
+            std::condition_variable idle;
+            size_t outstanding = 0;
+        };
+
+        // Portable fallback: a fixed set of workers running the synchronous IO functions.
+        class ThreadPoolEngine final : public AsyncEngine {
+        public:
+            explicit ThreadPoolEngine(const u32 workerCount) {
+                workers.reserve(workerCount);
+                for (u32 i = 0; i < workerCount; ++i) {
+                    try {
+                        workers.emplace_back([this] { Run(); });
+                    } catch (const std::system_error&) {
+                        // Short of threads: run with the workers that started, if any did.
+                        if (workers.empty()) {
+                            throw;
+                        }
+
+                        break;
+                    }
+                }
+            }
+
+            ~ThreadPoolEngine() override {
+                {
+                    std::lock_guard lock(queueMutex);
+                    stopping = true;
+                }
+
+                available.notify_all();
+                for (auto& worker : workers) {
+                    worker.join();
+                }
+            }
+
+            [[nodiscard]] AsyncBackend Backend() const noexcept override {
+                return AsyncBackend::ThreadPool;
+            }
+
+        protected:
+            void Submit(AsyncBatch batch) override {
+                {
+                    std::lock_guard lock(queueMutex);
+                    for (auto& operation : batch) {
+                        queue.push_back(std::move(operation));
+                    }
+                }
+
+                available.notify_all();
+            }
+
+        private:
+            Vector<std::thread> workers;
+            std::mutex queueMutex;
+            std::condition_variable available;
+            std::deque<Unique<AsyncOperation>> queue;
+            bool stopping = false;
+
+            void Run() {
+                while (true) {
+                    Unique<AsyncOperation> operation;
+                    {
+                        std::unique_lock lock(queueMutex);
+                        available.wait(lock, [this] { return stopping || !queue.empty(); });
+                        if (queue.empty()) {
+                            return;
+                        }
+
+                        operation = std::move(queue.front());
+                        queue.pop_front();
+                    }
+
+                    Execute(std::move(operation));
+                }
+            }
+
+            void Execute(Unique<AsyncOperation> operation) {
+                using Kind = AsyncOperation::Kind;
+
+                bool success = true;
+                switch (operation->kind) {
+                    case Kind::ReadAllBytes: {
+                        auto bytes = ReadAllBytes(operation->filename);
+                        success    = bytes.has_value();
+                        if (success) {
+                            operation->buffer = std::move(*bytes);
+                        }
+                    } break;
+                    case Kind::ReadBlock: {
+                        operation->buffer.resize(operation->size);
+                        success =
+                          ReadBlock(operation->filename, operation->offset, operation->buffer);
+                    } break;
+                    case Kind::WriteAllBytes:
+                        success = WriteAllBytes(operation->filename, operation->buffer);
+                        break;
+                }
+
+                Finish(std::move(operation), success);
+            }
+        };
+
+#if defined(RIEGER_HAS_IO_URING)
+        // Raw io_uring (no liburing): one shared submission ring guarded by a mutex and a
+        // dedicated thread reaping completions. Files are opened on the submitting thread; reads
+        // and writes are batched into a single io_uring_enter per submission.
+        class IoUringEngine final : public AsyncEngine {
+        public:
+            ~IoUringEngine() override {
+                if (completions.joinable()) {
+                    {
+                        std::lock_guard lock(submitMutex);
+                        io_uring_sqe stop {};
+                        stop.opcode    = IORING_OP_NOP;
+                        stop.user_data = kStopToken;
+                        PushEntry(stop);
+                        Enter(0);
+                    }
+
+                    completions.join();
+                }
+
+                if (sqes) {
+                    ::munmap(sqes, entries * sizeof(io_uring_sqe));
+                }
+
+                if (cqRing && cqRing != sqRing) {
+                    ::munmap(cqRing, cqRingSize);
+                }
+
+                if (sqRing) {
+                    ::munmap(sqRing, sqRingSize);
+                }
+
+                if (ring >= 0) {
+                    ::close(ring);
+                }
+            }
+
+            // Null when the kernel refuses io_uring (too old, or blocked by a sandbox).
+            static Unique<IoUringEngine> Create(const u32 queueDepth) {
+                Unique<IoUringEngine> engine(new IoUringEngine());
+                if (!engine->Setup(queueDepth)) {
+                    return nullptr;
+                }
+
+                try {
+                    engine->completions = std::thread([raw = engine.get()] { raw->Reap(); });
+                } catch (const std::system_error&) {
+                    // No thread to reap with; AsyncQueue falls back to the thread pool.
+                    return nullptr;
+                }
+
+                return engine;
+            }
+
+            [[nodiscard]] AsyncBackend Backend() const noexcept override {
+                return AsyncBackend::IoUring;
+            }
+
+        protected:
+            void Submit(AsyncBatch batch) override {
+                AsyncBatch ready = PrepareBatch(std::move(batch));
+                if (ready.empty()) {
+                    return;
+                }
+
+                // The completion thread may submit from inside a callback; it must never wait for
+                // a slot only it can free, so it is allowed to overcommit the depth.
+                const bool onCompletionThread = std::this_thread::get_id() == completions.get_id();
+
+                std::unique_lock lock(submitMutex);
+                for (auto& operation : ready) {
+                    if (!onCompletionThread && inFlight >= depth) {
+                        Enter(0);
+                        slotAvailable.wait(lock, [this] { return inFlight < depth; });
+                    }
+
+                    ++inFlight;
+                    Push(operation.release());
+                }
+
+                Enter(0);
+            }
+
+        private:
+            static constexpr u64 kStopToken = 0;
+
+            int ring           = -1;
+            u32 entries        = 0;
+            u32 depth          = 0;
+            void* sqRing       = nullptr;
+            void* cqRing       = nullptr;
+            size_t sqRingSize  = 0;
+            size_t cqRingSize  = 0;
+            io_uring_sqe* sqes = nullptr;
+
+            u32* sqHead        = nullptr;
+            u32* sqTail        = nullptr;
+            u32 sqMask         = 0;
+            u32* sqArray       = nullptr;
+            u32* cqHead        = nullptr;
+            u32* cqTail        = nullptr;
+            u32 cqMask         = 0;
+            io_uring_cqe* cqes = nullptr;
+
+            std::mutex submitMutex;
+            std::condition_variable slotAvailable;
+            u32 inFlight = 0;
+            std::thread completions;
+
+            IoUringEngine() = default;
+
+            bool Setup(const u32 queueDepth) {
+                constexpr u32 kMaxEntries = 4096;
+
+                io_uring_params params {};
+                const u32 requested = std::min(queueDepth, kMaxEntries);
+                ring = CAST<int>(::syscall(__NR_io_uring_setup, requested, &params));
+                if (ring < 0) {
+                    return false;
+                }
+
+                entries    = params.sq_entries;
+                depth      = std::min(requested, entries);
+                sqRingSize = params.sq_off.array + params.sq_entries * sizeof(u32);
+                cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+                const bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+                if (singleMap) {
+                    sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+                }
+
+                constexpr int kProtection = PROT_READ | PROT_WRITE;
+                constexpr int kFlags      = MAP_SHARED | MAP_POPULATE;
+
+                sqRing = ::mmap(nullptr, sqRingSize, kProtection, kFlags, ring, IORING_OFF_SQ_RING);
+                if (sqRing == MAP_FAILED) {
+                    sqRing = nullptr;
+                    return false;
+                }
+
+                cqRing = singleMap ? sqRing
+                                   : ::mmap(nullptr,
+                                            cqRingSize,
+                                            kProtection,
+                                            kFlags,
+                                            ring,
+                                            IORING_OFF_CQ_RING);
+                if (cqRing == MAP_FAILED) {
+                    cqRing = nullptr;
+                    return false;
+                }
+
+                void* entriesMap = ::mmap(nullptr,
+                                          params.sq_entries * sizeof(io_uring_sqe),
+                                          kProtection,
+                                          kFlags,
+                                          ring,
+                                          IORING_OFF_SQES);
+                if (entriesMap == MAP_FAILED) {
+                    return false;
+                }
+
+                sqes = CAST<io_uring_sqe*>(entriesMap);
+
+                auto* sq = CAST<u8*>(sqRing);
+                sqHead   = RCAST<u32*>(sq + params.sq_off.head);
+                sqTail   = RCAST<u32*>(sq + params.sq_off.tail);
+                sqMask   = *RCAST<u32*>(sq + params.sq_off.ring_mask);
+                sqArray  = RCAST<u32*>(sq + params.sq_off.array);
+
+                auto* cq = CAST<u8*>(cqRing);
+                cqHead   = RCAST<u32*>(cq + params.cq_off.head);
+                cqTail   = RCAST<u32*>(cq + params.cq_off.tail);
+                cqMask   = *RCAST<u32*>(cq + params.cq_off.ring_mask);
+                cqes     = RCAST<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+                return true;
+            }
+
+            // Requires submitMutex. Flushes the ring to the kernel first if it is full.
+            void PushEntry(const io_uring_sqe& entry) {
+                const u32 tail = *sqTail;
+                if (tail - std::atomic_ref(*sqHead).load(std::memory_order_acquire) >= entries) {
+                    Enter(0);
+                }
+
+                const u32 index = tail & sqMask;
+                sqes[index]     = entry;
+                sqArray[index]  = index;
+                std::atomic_ref(*sqTail).store(tail + 1, std::memory_order_release);
+            }
+
+            // Requires submitMutex.
+            void Push(AsyncOperation* operation) {
+                const bool write = operation->kind == AsyncOperation::Kind::WriteAllBytes;
+
+                io_uring_sqe entry {};
+                entry.opcode    = write ? IORING_OP_WRITE : IORING_OP_READ;
+                entry.fd        = operation->handle;
+                entry.off       = operation->Position();
+                entry.addr      = RCAST<u64>(operation->Cursor());
+                entry.len       = CAST<u32>(std::min<size_t>(operation->Remaining(), 1u << 30));
+                entry.user_data = RCAST<u64>(operation);
+                PushEntry(entry);
+            }
+
+            // Requires submitMutex. Hands every queued entry to the kernel, optionally waiting for
+            // completions as well.
+            void Enter(const u32 minComplete) {
+                while (true) {
+                    const u32 pending =
+                      *sqTail - std::atomic_ref(*sqHead).load(std::memory_order_acquire);
+                    if (pending == 0 && minComplete == 0) {
+                        return;
+                    }
+
+                    const u32 flags = minComplete > 0 ? IORING_ENTER_GETEVENTS : 0;
+                    const long result =
+                      ::syscall(__NR_io_uring_enter, ring, pending, minComplete, flags, nullptr, 0);
+                    if (result >= 0 || (errno != EINTR && errno != EAGAIN && errno != EBUSY)) {
+                        return;
+                    }
+                }
+            }
+
+            void Reap() {
+                while (true) {
+                    ::syscall(__NR_io_uring_enter, ring, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+
+                    u32 head       = *cqHead;
+                    const u32 tail = std::atomic_ref(*cqTail).load(std::memory_order_acquire);
+                    bool stop      = false;
+                    for (; head != tail; ++head) {
+                        const io_uring_cqe& cqe = cqes[head & cqMask];
+                        if (cqe.user_data == kStopToken) {
+                            stop = true;
+                            continue;
+                        }
+
+                        OnCompletion(RCAST<AsyncOperation*>(cqe.user_data), cqe.res);
+                    }
+
+                    std::atomic_ref(*cqHead).store(head, std::memory_order_release);
+                    if (stop) {
+                        return;
+                    }
+                }
+            }
+
+            void OnCompletion(AsyncOperation* operation, const i32 result) {
+                using Progress = AsyncOperation::Progress;
+
+                // Taking the submission lock also orders this thread after the one that pushed
+                // the entry; the kernel handoff in between is invisible to the memory model.
+                Progress progress = Progress::Failed;
+                {
+                    std::lock_guard lock(submitMutex);
+                    if (result >= 0) {
+                        progress = operation->Advance(CAST<size_t>(result));
+                    }
+
+                    if (progress == Progress::Pending) {
+                        Push(operation);
+                        Enter(0);
+                        return;
+                    }
+
+                    --inFlight;
+                }
+
+                slotAvailable.notify_one();
+                Finish(Unique<AsyncOperation>(operation), progress == Progress::Done);
+            }
+        };
+#endif
+
+#if defined(_WIN32) || defined(_WIN64)
+        // IOCP: every file is opened overlapped and associated with one completion port drained
+        // by a dedicated thread.
+        class IocpEngine final : public AsyncEngine {
+        public:
+            ~IocpEngine() override {
+                if (completions.joinable()) {
+                    ::PostQueuedCompletionStatus(port, 0, kStopKey, nullptr);
+                    completions.join();
+                }
+
+                if (port) {
+                    ::CloseHandle(port);
+                }
+            }
+
+            static Unique<IocpEngine> Create(const u32 queueDepth) {
+                Unique<IocpEngine> engine(new IocpEngine());
+                engine->depth = queueDepth;
+                engine->port  = ::CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 1);
+                if (!engine->port) {
+                    return nullptr;
+                }
+
+                try {
+                    engine->completions = std::thread([raw = engine.get()] { raw->Reap(); });
+                } catch (const std::system_error&) {
+                    // No thread to reap with; AsyncQueue falls back to the thread pool.
+                    return nullptr;
+                }
+
+                return engine;
+            }
+
+            [[nodiscard]] AsyncBackend Backend() const noexcept override {
+                return AsyncBackend::Iocp;
+            }
+
+        protected:
+            void Submit(AsyncBatch batch) override {
+                AsyncBatch ready              = PrepareBatch(std::move(batch));
+                const bool onCompletionThread = std::this_thread::get_id() == completions.get_id();
+
+                for (auto& operation : ready) {
+                    if (!::CreateIoCompletionPort(operation->handle, port, kIoKey, 0)) {
+                        Finish(std::move(operation), false);
+                        continue;
+                    }
+
+                    {
+                        std::unique_lock lock(slotMutex);
+                        if (!onCompletionThread) {
+                            slotAvailable.wait(lock, [this] { return inFlight < depth; });
+                        }
+
+                        ++inFlight;
+                    }
+
+                    Issue(operation.release());
+                }
+            }
+
+        private:
+            static constexpr ULONG_PTR kIoKey   = 0;
+            static constexpr ULONG_PTR kStopKey = 1;
+
+            HANDLE port = nullptr;
+            u32 depth   = 0;
+            std::mutex slotMutex;
+            std::condition_variable slotAvailable;
+            u32 inFlight = 0;
+            std::thread completions;
+
+            IocpEngine() = default;
+
+            void Issue(AsyncOperation* operation) {
+                constexpr size_t kMaxTransfer = 1u << 30;
+
+                const u64 position               = operation->Position();
+                operation->overlapped            = {};
+                operation->overlapped.Offset     = CAST<DWORD>(position & 0xFFFFFFFF);
+                operation->overlapped.OffsetHigh = CAST<DWORD>(position >> 32);
+
+                const auto length   = CAST<DWORD>(std::min(operation->Remaining(), kMaxTransfer));
+                HANDLE file         = operation->handle;
+                u8* cursor          = operation->Cursor();
+                LPOVERLAPPED target = &operation->overlapped;
+                const BOOL issued   = operation->kind == AsyncOperation::Kind::WriteAllBytes
+                                        ? ::WriteFile(file, cursor, length, nullptr, target)
+                                        : ::ReadFile(file, cursor, length, nullptr, target);
+
+                // Synchronous successes still post a completion packet; only failures that never
+                // reached the device are handled here.
+                if (!issued && ::GetLastError() != ERROR_IO_PENDING) {
+                    OnCompletion(operation, 0, ::GetLastError() == ERROR_HANDLE_EOF);
+                }
+            }
+
+            void Reap() {
+                while (true) {
+                    DWORD transferred       = 0;
+                    ULONG_PTR key           = 0;
+                    LPOVERLAPPED overlapped = nullptr;
+                    const BOOL ok           = ::GetQueuedCompletionStatus(
+                      port, &transferred, &key, &overlapped, INFINITE);
+
+                    if (key == kStopKey || !overlapped) {
+                        return;
+                    }
+
+                    auto* operation = RCAST<AsyncOperation*>(overlapped);
+                    OnCompletion(
+                      operation, transferred, ok || ::GetLastError() == ERROR_HANDLE_EOF);
+                }
+            }
+
+            void OnCompletion(AsyncOperation* operation, const DWORD transferred, const bool ok) {
+                using Progress = AsyncOperation::Progress;
+
+                const Progress progress = ok ? operation->Advance(transferred) : Progress::Failed;
+                if (progress == Progress::Pending) {
+                    Issue(operation);
+                    return;
+                }
+
+                {
+                    std::lock_guard lock(slotMutex);
+                    --inFlight;
+                }
+
+                slotAvailable.notify_one();
+                Finish(Unique<AsyncOperation>(operation), progress == Progress::Done);
+            }
+        };
+#endif
+    }  // namespace Detail
+
+    // Batched asynchronous reads and writes with ReadAllBytes/ReadBlock/WriteAllBytes semantics.
+    // Requests go through io_uring on Linux and an I/O completion port on Windows, with at most
+    // queueDepth in flight; elsewhere (or when the kernel refuses io_uring) a pool of queueDepth
+    // worker threads runs the synchronous functions. Completion is reported through a future or
+    // a callback; callbacks run on the backend's completion thread and should be brief. The
+    // destructor waits for everything outstanding.
+    class AsyncQueue {
+    public:
+        static constexpr u32 kDefaultQueueDepth = 64;
+
+        using ReadCallback       = Detail::AsyncReadCallback;
+        using WriteCallback      = Detail::AsyncWriteCallback;
+        using BatchReadCallback  = std::function<void(size_t index, Option<Vector<u8>>)>;
+        using BatchWriteCallback = std::function<void(size_t index, bool)>;
+
+        struct ReadRequest {
+            Path filename;
+            u64 offset = 0;
+            // kNone reads the whole file like ReadAllBytes; otherwise exactly this many bytes at
+            // offset like ReadBlock.
+            Option<size_t> size;
+        };
+
+        struct WriteRequest {
+            Path filename;
+            Vector<u8> bytes;
+        };
+
+        explicit AsyncQueue(const u32 queueDepth = kDefaultQueueDepth) {
+            const u32 depth = std::max(queueDepth, 1u);
+#if defined(RIEGER_HAS_IO_URING)
+            engine = Detail::IoUringEngine::Create(depth);
+#elif defined(_WIN32) || defined(_WIN64)
+            engine = Detail::IocpEngine::Create(depth);
+#endif
+            if (!engine) {
+                engine = std::make_unique<Detail::ThreadPoolEngine>(std::min(depth, kMaxWorkers));
+            }
+        }
+
+        ~AsyncQueue() {
+            Wait();
+        }
+
+        AsyncQueue(const AsyncQueue&)            = delete;
+        AsyncQueue& operator=(const AsyncQueue&) = delete;
+
+        void ReadAllBytes(const Path& filename, ReadCallback callback) {
+            Enqueue(MakeRead({filename, 0, kNone}, std::move(callback)));
+        }
+
+        std::future<Option<Vector<u8>>> ReadAllBytes(const Path& filename) {
+            auto promise = std::make_shared<std::promise<Option<Vector<u8>>>>();
+            auto future  = promise->get_future();
+            ReadAllBytes(filename, [promise](auto result) {
+                promise->set_value(std::move(result));
+            });
+            return future;
+        }
+
+        void ReadBlock(const Path& filename,
+                       const u64 blockOffset,
+                       const size_t blockSize,
+                       ReadCallback callback) {
+            Enqueue(MakeRead({filename, blockOffset, blockSize}, std::move(callback)));
+        }
+
+        std::future<Option<Vector<u8>>>
+        ReadBlock(const Path& filename, const u64 blockOffset, const size_t blockSize) {
+            auto promise = std::make_shared<std::promise<Option<Vector<u8>>>>();
+            auto future  = promise->get_future();
+            ReadBlock(filename, blockOffset, blockSize, [promise](auto result) {
+                promise->set_value(std::move(result));
+            });
+            return future;
+        }
+
+        void WriteAllBytes(const Path& filename, Vector<u8> bytes, WriteCallback callback) {
+            Enqueue(MakeWrite({filename, std::move(bytes)}, std::move(callback)));
+        }
+
+        std::future<bool> WriteAllBytes(const Path& filename, Vector<u8> bytes) {
+            auto promise = std::make_shared<std::promise<bool>>();
+            auto future  = promise->get_future();
+            WriteAllBytes(filename, std::move(bytes), [promise](const bool result) {
+                promise->set_value(result);
+            });
+            return future;
+        }
+
+        // Submits every request in one go; the callback receives each request's index.
+        void ReadBatch(const std::span<const ReadRequest> requests, BatchReadCallback callback) {
+            auto shared = std::make_shared<BatchReadCallback>(std::move(callback));
+
+            Detail::AsyncBatch batch;
+            batch.reserve(requests.size());
+            for (size_t i = 0; i < requests.size(); ++i) {
+                batch.push_back(MakeRead(requests[i], [shared, i](auto result) {
+                    (*shared)(i, std::move(result));
+                }));
+            }
+
+            engine->Enqueue(std::move(batch));
+        }
+
+        Vector<std::future<Option<Vector<u8>>>>
+        ReadBatch(const std::span<const ReadRequest> requests) {
+            Vector<std::future<Option<Vector<u8>>>> futures;
+            futures.reserve(requests.size());
+
+            Detail::AsyncBatch batch;
+            batch.reserve(requests.size());
+            for (const auto& request : requests) {
+                auto promise = std::make_shared<std::promise<Option<Vector<u8>>>>();
+                futures.push_back(promise->get_future());
+                batch.push_back(MakeRead(request, [promise](auto result) {
+                    promise->set_value(std::move(result));
+                }));
+            }
+
+            engine->Enqueue(std::move(batch));
+            return futures;
+        }
+
+        void WriteBatch(Vector<WriteRequest> requests, BatchWriteCallback callback) {
+            auto shared = std::make_shared<BatchWriteCallback>(std::move(callback));
+
+            Detail::AsyncBatch batch;
+            batch.reserve(requests.size());
+            for (size_t i = 0; i < requests.size(); ++i) {
+                batch.push_back(MakeWrite(std::move(requests[i]), [shared, i](const bool result) {
+                    (*shared)(i, result);
+                }));
+            }
+
+            engine->Enqueue(std::move(batch));
+        }
+
+        Vector<std::future<bool>> WriteBatch(Vector<WriteRequest> requests) {
+            Vector<std::future<bool>> futures;
+            futures.reserve(requests.size());
+
+            Detail::AsyncBatch batch;
+            batch.reserve(requests.size());
+            for (auto& request : requests) {
+                auto promise = std::make_shared<std::promise<bool>>();
+                futures.push_back(promise->get_future());
+                batch.push_back(MakeWrite(std::move(request), [promise](const bool result) {
+                    promise->set_value(result);
+                }));
+            }
+
+            engine->Enqueue(std::move(batch));
+            return futures;
+        }
+
+        // Blocks until every request submitted so far has completed.
+        void Wait() {
+            engine->Wait();
+        }
+
+        [[nodiscard]] AsyncBackend Backend() const noexcept {
+            return engine->Backend();
+        }
+
+    private:
+        static constexpr u32 kMaxWorkers = 256;
+
+        Unique<Detail::AsyncEngine> engine;
+
+        void Enqueue(Unique<Detail::AsyncOperation> operation) {
+            Detail::AsyncBatch batch;
+            batch.push_back(std::move(operation));
+            engine->Enqueue(std::move(batch));
+        }
+
+        static Unique<Detail::AsyncOperation> MakeRead(const ReadRequest& request,
+                                                       ReadCallback callback) {
+            using Kind = Detail::AsyncOperation::Kind;
+
+            auto operation      = std::make_unique<Detail::AsyncOperation>();
+            operation->kind     = request.size.has_value() ? Kind::ReadBlock : Kind::ReadAllBytes;
+            operation->filename = request.filename;
+            operation->offset   = request.offset;
+            operation->size     = request.size.value_or(0);
+            operation->onRead   = std::move(callback);
+            return operation;
+        }
+
+        static Unique<Detail::AsyncOperation> MakeWrite(WriteRequest request,
+                                                        WriteCallback callback) {
+            auto operation      = std::make_unique<Detail::AsyncOperation>();
+            operation->kind     = Detail::AsyncOperation::Kind::WriteAllBytes;
+            operation->filename = std::move(request.filename);
+            operation->size     = request.bytes.size();
+            operation->buffer   = std::move(request.bytes);
+            operation->onWrite  = std::move(callback);
+            return operation;
+        }
+    };
+
+    namespace Detail {
+        // Suspends the awaiting coroutine until the queue reports completion. Whichever of
+        // await_suspend and the completion callback finishes second resumes it, so a request that
+        // completes during submission simply continues without suspending.
+        template<class T, class Submit>
+        class [[nodiscard]] AsyncAwaitable {
+        public:
+            explicit AsyncAwaitable(Submit submit) : submit(std::move(submit)) {}
+
+            AsyncAwaitable(const AsyncAwaitable&)            = delete;
+            AsyncAwaitable& operator=(const AsyncAwaitable&) = delete;
+
+            bool await_ready() const noexcept {
+                return false;
+            }
+
+            bool await_suspend(std::coroutine_handle<> handle) {
+                continuation = handle;
+                submit([this](T value) {
+                    result.emplace(std::move(value));
+                    if (arrived.exchange(true, std::memory_order_acq_rel)) {
+                        continuation.resume();
+                    }
+                });
+
+                return !arrived.exchange(true, std::memory_order_acq_rel);
+            }
+
+            T await_resume() {
+                return std::move(*result);
+            }
+
+        private:
+            Submit submit;
+            std::coroutine_handle<> continuation;
+            Option<T> result;
+            std::atomic<bool> arrived = false;
+        };
+
+        template<class T, class Submit>
+        AsyncAwaitable<T, Submit> MakeAwaitable(Submit submit) {
+            return AsyncAwaitable<T, Submit>(std::move(submit));
+        }
+    }  // namespace Detail
+
+    // Shared queue used by the *Async awaitables when none is passed in.
+    inline AsyncQueue& DefaultAsyncQueue() {
+        static AsyncQueue queue;
+        return queue;
+    }
+
+    // co_await-able counterparts of ReadAllBytes, ReadBlock and WriteAllBytes. The coroutine
+    // resumes on the queue's completion thread; hop to your own executor before heavy work so
+    // other completions are not held up.
+    inline auto ReadAsync(const Path& filename, AsyncQueue& queue = DefaultAsyncQueue()) {
+        return Detail::MakeAwaitable<Option<Vector<u8>>>([&queue, filename](auto callback) {
+            queue.ReadAllBytes(filename, std::move(callback));
+        });
+    }
+
+    inline auto ReadBlockAsync(const Path& filename,
+                               const u64 blockOffset,
+                               const size_t blockSize,
+                               AsyncQueue& queue = DefaultAsyncQueue()) {
+        return Detail::MakeAwaitable<Option<Vector<u8>>>(
+          [&queue, filename, blockOffset, blockSize](auto callback) {
+              queue.ReadBlock(filename, blockOffset, blockSize, std::move(callback));
+          });
+    }
+
+    inline auto WriteAllBytesAsync(const Path& filename,
+                                   Vector<u8> bytes,
+                                   AsyncQueue& queue = DefaultAsyncQueue()) {
+        return Detail::MakeAwaitable<bool>(
+          [&queue, filename, bytes = std::move(bytes)](auto callback) mutable {
+              queue.WriteAllBytes(filename, std::move(bytes), std::move(callback));
+          });
+    }
+
+    // Every file loaded by LoadTree, packed back to back into one buffer. Entries are sorted by
+    // path (relative to the root) so Find can binary search.
+    struct FileTree {
+        struct Entry {
+            Path path;
+            u64 offset  = 0;
+            u64 size    = 0;
+            bool loaded = false;
+        };
+
+        Unique<u8[]> data;
+        u64 totalSize = 0;
+        Vector<Entry> entries;
+
+        [[nodiscard]] std::span<const u8> Contents(const Entry& entry) const noexcept {
+            return {data.get() + entry.offset, CAST<size_t>(entry.size)};
+        }
+
+        [[nodiscard]] Option<std::span<const u8>> Find(const Path& relative) const {
+            const auto it = std::lower_bound(
+              entries.begin(), entries.end(), relative, [](const Entry& entry, const Path& path) {
+                  return entry.path < path;
+              });
+            if (it == entries.end() || it->path != relative || !it->loaded) {
+                return kNone;
+            }
+
+            return Contents(*it);
+        }
+    };
+
+    namespace Detail {
+        // Work-stealing split of [0, count) across workers. Each worker owns a contiguous range
+        // packed into one atomic word (begin << 32 | end), takes work from its front, and when
+        // it runs dry steals the back half of another worker's range.
+        class StealingRanges {
+        public:
+            StealingRanges(const u32 count, const u32 workers) : ranges(workers) {
+                for (u32 i = 0; i < workers; ++i) {
+                    const u32 begin = CAST<u32>(CAST<u64>(count) * i / workers);
+                    const u32 end   = CAST<u32>(CAST<u64>(count) * (i + 1) / workers);
+                    ranges[i].store(Pack(begin, end), std::memory_order_relaxed);
+                }
+            }
+
+            Option<u32> Next(const u32 worker) {
+                while (true) {
+                    if (const auto index = Pop(worker)) {
+                        return index;
+                    }
+
+                    if (!Steal(worker)) {
+                        return kNone;
+                    }
+                }
+            }
+
+        private:
+            Vector<std::atomic<u64>> ranges;
+
+            static constexpr u64 Pack(const u32 begin, const u32 end) {
+                return (CAST<u64>(begin) << 32) | end;
+            }
+
+            Option<u32> Pop(const u32 worker) {
+                auto& range  = ranges[worker];
+                u64 expected = range.load(std::memory_order_acquire);
+                while (true) {
+                    const auto begin = CAST<u32>(expected >> 32);
+                    const auto end   = CAST<u32>(expected);
+                    if (begin >= end) {
+                        return kNone;
+                    }
+
+                    if (range.compare_exchange_weak(expected, Pack(begin + 1, end))) {
+                        return begin;
+                    }
+                }
+            }
+
+            bool Steal(const u32 worker) {
+                const auto workers = CAST<u32>(ranges.size());
+                for (u32 step = 1; step < workers; ++step) {
+                    auto& victim = ranges[(worker + step) % workers];
+                    u64 expected = victim.load(std::memory_order_acquire);
+                    while (true) {
+                        const auto begin = CAST<u32>(expected >> 32);
+                        const auto end   = CAST<u32>(expected);
+                        if (begin >= end) {
+                            break;
+                        }
+
+                        const u32 middle = end - (end - begin + 1) / 2;
+                        if (victim.compare_exchange_weak(expected, Pack(begin, middle))) {
+                            ranges[worker].store(Pack(middle, end), std::memory_order_release);
+                            return true;
+                        }
+                    }
+                }
+
+                return false;
+            }
+        };
+    }  // namespace Detail
+
+    // Loads every regular file under root that the predicate accepts (it is given the
+    // FileSystem::directory_entry) into a single FileTree buffer, reading with threadCount
+    // workers (0 picks the hardware concurrency). Sizes are taken while walking; a file that
+    // fails to open or has changed size by the time it is read is kept with loaded == false,
+    // rather than with truncated contents. kNone only if root cannot be walked.
+    template<class Predicate>
+    Option<FileTree> LoadTree(const Path& root, Predicate&& predicate, u32 threadCount = 0) {
+        RIEGER_PROFILE_SCOPE("IO::LoadTree");
+        constexpr auto kOptions = FileSystem::directory_options::skip_permission_denied;
+
+        std::error_code error;
+        FileSystem::recursive_directory_iterator walker(root, kOptions, error);
+        if (error) {
+            return kNone;
+        }
+
+        FileTree tree;
+        for (; walker != FileSystem::recursive_directory_iterator(); walker.increment(error)) {
+            if (error) {
+                return kNone;
+            }
+
+            std::error_code entryError;
+            const auto& entry = *walker;
+            if (!entry.is_regular_file(entryError) || !predicate(entry)) {
+                continue;
+            }
+
+            const auto size = entry.file_size(entryError);
+            if (!entryError) {
+                tree.entries.push_back({entry.path().lexically_relative(root), 0, size, false});
+            }
+        }
+
+        const auto byPath = [](const FileTree::Entry& a, const FileTree::Entry& b) {
+            return a.path < b.path;
+        };
+        std::sort(tree.entries.begin(), tree.entries.end(), byPath);
+
+        for (auto& entry : tree.entries) {
+            entry.offset = tree.totalSize;
+            tree.totalSize += entry.size;
+        }
+
+        // Left uninitialised: the workers fault the pages in as they fill them.
+        tree.data = std::make_unique_for_overwrite<u8[]>(CAST<size_t>(tree.totalSize));
+
+        const auto count = CAST<u32>(tree.entries.size());
+        if (threadCount == 0) {
+            threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+        }
+
+        threadCount = std::clamp(threadCount, 1u, std::max(count, 1u));
+
+        Detail::StealingRanges ranges(count, threadCount);
+        const auto work = [&](const u32 worker) {
+            while (const auto index = ranges.Next(worker)) {
+                auto& entry     = tree.entries[*index];
+                const auto file = FileHandle::Open(root / entry.path);
+                if (!file.has_value()) {
+                    continue;
+                }
+
+                const std::span<u8> destination(tree.data.get() + entry.offset,
+                                                CAST<size_t>(entry.size));
+                // The buffer has no room past the walked size, so a file that grew since is
+                // caught by its size after the read rather than by reading on.
+                const auto read = file->ReadSomeAt(0, destination);
+                entry.loaded    = read.has_value() && *read == destination.size() &&
+                                  file->Size() == entry.size;
+            }
+        };
+
+        // jthread joins on every way out, including a throw from work(0).
+        Vector<std::jthread> workers;
+        workers.reserve(threadCount - 1);
+        for (u32 i = 1; i < threadCount; ++i) {
+            try {
+                workers.emplace_back(work, i);
+            } catch (const std::system_error&) {
+                // Out of threads: the running workers steal the unstarted ones' ranges.
+                break;
+            }
+        }
+
+        work(0);
+        for (auto& worker : workers) {
+            worker.join();
+        }
+
+        RIEGER_PROFILE_BYTES(tree.totalSize);
+        return tree;
+    }
+
+    inline Option<FileTree> LoadTree(const Path& root, const u32 threadCount = 0) {
+        return LoadTree(
+          root, [](const FileSystem::directory_entry&) { return true; }, threadCount);
+    }
+
+    // Compressed container written by WriteAllBytes with CompressionOptions and read back by
+    // CompressedFile. The content is cut into fixed-size blocks that are compressed
+    // independently, so they can be compressed and expanded on several threads and any byte
+    // range can be read by expanding only the blocks it touches. Layout, little-endian:
+    //
+    //     header  u32 magic, u8 codec, 3 reserved bytes, u32 block size, u32 reserved
+    //     blocks  compressed bodies, in order
+    //     index   u32 stored size per block; the top bit marks a block stored uncompressed
+    //     footer  u64 content size, u64 index offset, u32 block count, u32 magic
+    struct CompressionOptions {
+        Compression::Codec codec = Compression::Codec::LZ4;
+        // The unit of compression and of random access; at most 1 GiB.
+        u32 blockSize = 1024 * 1024;
+        // 0 uses every hardware thread.
+        u32 threadCount = 0;
+        // Codec-specific; 0 picks the codec's default.
+        i32 level = 0;
+    };
+
+    namespace Detail {
+        inline constexpr u32 kCompressedMagic = 0x315A4752;  // "RGZ1"
+        inline constexpr size_t kHeaderSize   = 16;
+        inline constexpr size_t kFooterSize   = 24;
+        inline constexpr u32 kStoredRaw       = 0x80000000;
+        inline constexpr u32 kMaxBlockSize    = 1u << 30;
+
+        // Runs work(index) for every index in [0, count) on up to threadCount threads.
+        template<class Work>
+        void ParallelFor(const u32 count, u32 threadCount, Work&& work) {
+            if (threadCount == 0) {
+                threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+            }
+
+            threadCount = std::clamp(threadCount, 1u, std::max(count, 1u));
+
+            StealingRanges ranges(count, threadCount);
+            const auto run = [&](const u32 worker) {
+                while (const auto index = ranges.Next(worker)) {
+                    work(*index);
+                }
+            };
+
+            // As in LoadTree: joined on every way out, and short of threads the running workers
+            // steal the unstarted ones' ranges.
+            Vector<std::jthread> workers;
+            workers.reserve(threadCount - 1);
+            for (u32 i = 1; i < threadCount; ++i) {
+                try {
+                    workers.emplace_back(run, i);
+                } catch (const std::system_error&) {
+                    break;
+                }
+            }
+
+            run(0);
+            for (auto& worker : workers) {
+                worker.join();
+            }
+        }
+    }  // namespace Detail
+
+    inline bool WriteAllBytes(const Path& filename,
+                              const std::span<const u8> bytes,
+                              const CompressionOptions& compression,
+                              const WriteMode mode = WriteMode::InPlace) {
+        if (mode != WriteMode::InPlace) {
+            return Detail::WriteReplacing(filename, mode, [&](const Path& temporary) {
+                return WriteAllBytes(temporary, bytes, compression);
+            });
+        }
+
+        RIEGER_PROFILE_SCOPE("IO::WriteAllBytes(compressed)");
+        RIEGER_PROFILE_BYTES(bytes.size());
+        const u32 blockSize = compression.blockSize;
+        if (!Compression::IsAvailable(compression.codec) || blockSize == 0 ||
+            blockSize > Detail::kMaxBlockSize) {
+            return false;
+        }
+
+        const u64 blockCount = (bytes.size() + blockSize - 1) / blockSize;
+        if (blockCount > std::numeric_limits<u32>::max()) {
+            return false;
+        }
+
+        // Each block keeps whichever is smaller of its compressed and raw forms.
+        Vector<Vector<u8>> blocks(CAST<size_t>(blockCount));
+        Vector<u32> index(blocks.size());
+        Detail::ParallelFor(CAST<u32>(blockCount), compression.threadCount, [&](const u32 i) {
+            const auto block = bytes.subspan(CAST<size_t>(i) * blockSize).first(
+              std::min<size_t>(blockSize, bytes.size() - CAST<size_t>(i) * blockSize));
+
+            auto& stored = blocks[i];
+            stored.resize(Compression::CompressBound(compression.codec, block.size()));
+            const auto size =
+              Compression::Compress(compression.codec, block, stored, compression.level);
+            if (size.has_value() && *size < block.size()) {
+                stored.resize(*size);
+                index[i] = CAST<u32>(*size);
+            } else {
+                stored.assign(block.begin(), block.end());
+                index[i] = CAST<u32>(block.size()) | Detail::kStoredRaw;
+            }
+        });
+
+        const auto file = FileHandle::Open(filename, FileAccess::Create);
+        if (!file.has_value()) {
+            return false;
+        }
+
+        u8 header[Detail::kHeaderSize] {};
+        Compression::Detail::Store32(header, Detail::kCompressedMagic);
+        header[4] = CAST<u8>(compression.codec);
+        Compression::Detail::Store32(header + 8, blockSize);
+        if (!file->WriteAt(0, header)) {
+            return false;
+        }
+
+        u64 offset = Detail::kHeaderSize;
+        for (const auto& stored : blocks) {
+            if (!file->WriteAt(offset, stored)) {
+                return false;
+            }
+
+            offset += stored.size();
+        }
+
+        Vector<u8> trailer(index.size() * sizeof(u32) + Detail::kFooterSize);
+        for (size_t i = 0; i < index.size(); ++i) {
+            Compression::Detail::Store32(trailer.data() + i * sizeof(u32), index[i]);
+        }
+
+        u8* footer = trailer.data() + index.size() * sizeof(u32);
+        Compression::Detail::Store64(footer, bytes.size());
+        Compression::Detail::Store64(footer + 8, offset);
+        Compression::Detail::Store32(footer + 16, CAST<u32>(blockCount));
+        Compression::Detail::Store32(footer + 20, Detail::kCompressedMagic);
+        return file->WriteAt(offset, trailer);
+    }
+
+    // Reader for files written by WriteAllBytes with CompressionOptions. ReadAll expands every
+    // block in parallel; ReadAt expands only the blocks a range overlaps, caching the last
+    // one; Next/ForEach/begin/end walk the content block by block like ChunkReader. ReadAll is
+    // safe to call concurrently, the other members are not.
+    class CompressedFile {
+    public:
+        using Iterator = Detail::ReaderIterator<CompressedFile, std::span<const u8>>;
+
+        CompressedFile() = default;
+
+        static Option<CompressedFile> Open(const Path& filename, std::error_code& error) {
+            using Compression::Detail::Load32;
+            using Compression::Detail::Load64;
+
+            auto file = FileHandle::Open(filename, FileAccess::Read, error);
+            if (!file.has_value()) {
+                return kNone;
+            }
+
+            const auto corrupt = [&] {
+                error = std::make_error_code(std::errc::illegal_byte_sequence);
+                return kNone;
+            };
+
+            const auto fileSize = file->Size();
+            u8 header[Detail::kHeaderSize];
+            u8 footer[Detail::kFooterSize];
+            if (!fileSize.has_value() || *fileSize < Detail::kHeaderSize + Detail::kFooterSize ||
+                !file->ReadAt(0, header) ||
+                !file->ReadAt(*fileSize - Detail::kFooterSize, footer)) {
+                return corrupt();
+            }
+
+            CompressedFile compressed;
+            compressed.codec      = CAST<Compression::Codec>(header[4]);
+            compressed.blockSize  = Load32(header + 8);
+            compressed.size       = Load64(footer);
+            const u64 indexOffset = Load64(footer + 8);
+            const u32 blockCount  = Load32(footer + 16);
+            const u64 indexSize   = CAST<u64>(blockCount) * sizeof(u32);
+
+            const u64 blockSize = compressed.blockSize;
+            const bool magic    = Load32(header) == Detail::kCompressedMagic &&
+                               Load32(footer + 20) == Detail::kCompressedMagic;
+            const bool blocks   = blockSize > 0 && blockSize <= Detail::kMaxBlockSize &&
+                                compressed.size / blockSize + (compressed.size % blockSize != 0) ==
+                                  blockCount;
+            const bool layout   = indexOffset >= Detail::kHeaderSize && indexOffset <= *fileSize &&
+                                *fileSize - indexOffset == indexSize + Detail::kFooterSize;
+            if (!magic || !blocks || !layout || !Compression::IsAvailable(compressed.codec)) {
+                return corrupt();
+            }
+
+            Vector<u8> index(CAST<size_t>(indexSize));
+            if (!file->ReadAt(indexOffset, index)) {
+                return corrupt();
+            }
+
+            compressed.stored.resize(blockCount);
+            compressed.offsets.resize(blockCount + 1);
+            compressed.offsets[0] = Detail::kHeaderSize;
+            for (u32 i = 0; i < blockCount; ++i) {
+                const u32 entry           = Load32(index.data() + size_t {i} * sizeof(u32));
+                const u64 storedSize      = entry & ~Detail::kStoredRaw;
+                compressed.stored[i]      = entry;
+                compressed.offsets[i + 1] = compressed.offsets[i] + storedSize;
+                if ((entry & Detail::kStoredRaw) && storedSize != compressed.BlockLength(i)) {
+                    return corrupt();
+                }
+            }
+
+            if (compressed.offsets[blockCount] != indexOffset) {
+                return corrupt();
+            }
+
+            compressed.file = std::move(*file);
+            error.clear();
+            return compressed;
+        }
+
+        static Option<CompressedFile> Open(const Path& filename) {
+            std::error_code error;
+            return Open(filename, error);
+        }
+
+        // Uncompressed size of the content.
+        [[nodiscard]] u64 Size() const noexcept {
+            return size;
+        }
+
+        [[nodiscard]] u32 BlockSize() const noexcept {
+            return blockSize;
+        }
+
+        [[nodiscard]] u32 BlockCount() const noexcept {
+            return CAST<u32>(stored.size());
+        }
+
+        [[nodiscard]] Compression::Codec Codec() const noexcept {
+            return codec;
+        }
+
+        [[nodiscard]] Option<Vector<u8>> ReadAll(const u32 threadCount = 0) const {
+            RIEGER_PROFILE_SCOPE("IO::CompressedFile::ReadAll");
+            Vector<u8> content(CAST<size_t>(size));
+            std::atomic<bool> failed = false;
+            Detail::ParallelFor(BlockCount(), threadCount, [&](const u32 i) {
+                thread_local Vector<u8> scratch;
+                const std::span<u8> target(content.data() + CAST<size_t>(i) * blockSize,
+                                           BlockLength(i));
+                if (!failed && !ExpandBlock(i, target, scratch)) {
+                    failed = true;
+                }
+            });
+
+            if (failed) {
+                return kNone;
+            }
+
+            RIEGER_PROFILE_BYTES(content.size());
+            return content;
+        }
+
+        // Fills destination from offset; false on error or if the content ends first.
+        bool ReadAt(const u64 offset, const std::span<u8> destination) {
+            RIEGER_PROFILE_SCOPE("IO::CompressedFile::ReadAt");
+            if (offset > size || destination.size() > size - offset) {
+                return false;
+            }
+
+            u64 position = offset;
+            size_t done  = 0;
+            while (done < destination.size()) {
+                const auto block   = CAST<u32>(position / blockSize);
+                const auto skip    = CAST<size_t>(position - CAST<u64>(block) * blockSize);
+                const size_t count = std::min(BlockLength(block) - skip, destination.size() - done);
+
+                if (skip == 0 && count == BlockLength(block)) {
+                    // A whole block expands straight into the caller's buffer.
+                    if (!ExpandBlock(block, destination.subspan(done, count), scratch)) {
+                        return false;
+                    }
+                } else {
+                    const auto cached = CachedBlock(block);
+                    if (!cached.has_value()) {
+                        return false;
+                    }
+
+                    std::copy_n(cached->data() + skip, count, destination.data() + done);
+                }
+
+                done += count;
+                position += count;
+            }
+
+            RIEGER_PROFILE_BYTES(done);
+            return true;
+        }
+
+        Option<Vector<u8>> ReadAt(const u64 offset, const size_t count) {
+            Vector<u8> buffer(count);
+            if (!ReadAt(offset, buffer)) {
+                return kNone;
+            }
+
+            return buffer;
+        }
+
+        // The next block of content, or kNone at the end or on error (see Failed()).
+        Option<std::span<const u8>> Next() {
+            if (nextBlock >= BlockCount()) {
+                return kNone;
+            }
+
+            const auto block = CachedBlock(nextBlock);
+            if (!block.has_value()) {
+                failed    = true;
+                nextBlock = BlockCount();
+                return kNone;
+            }
+
+            ++nextBlock;
+            return block;
+        }
+
+        template<class Callback>
+        bool ForEach(Callback&& callback) {
+            return Detail::Drain<CompressedFile, std::span<const u8>>(*this, callback);
+        }
+
+        [[nodiscard]] bool Failed() const {
+            return failed;
+        }
+
+        Iterator begin() {
+            return Iterator(this);
+        }
+
+        std::default_sentinel_t end() const noexcept {
+            return {};
+        }
+
+    private:
+        FileHandle file;
+        Compression::Codec codec = Compression::Codec::None;
+        u32 blockSize            = 0;
+        u64 size                 = 0;
+        Vector<u32> stored;
+        Vector<u64> offsets;
+        Vector<u8> scratch;
+        Vector<u8> cache;
+        Option<u32> cachedIndex;
+        u32 nextBlock = 0;
+        bool failed   = false;
+
+        [[nodiscard]] size_t BlockLength(const u32 block) const noexcept {
+            return CAST<size_t>(std::min<u64>(blockSize, size - CAST<u64>(block) * blockSize));
+        }
+
+        // Expands one block into target, which must be exactly its length. Raw blocks are
+        // read in place; compressed ones go through scratch.
+        bool ExpandBlock(const u32 block, const std::span<u8> target, Vector<u8>& buffer) const {
+            const auto storedSize = CAST<size_t>(offsets[block + 1] - offsets[block]);
+            if (stored[block] & Detail::kStoredRaw) {
+                return file.ReadAt(offsets[block], target);
+            }
+
+            buffer.resize(storedSize);
+            if (!file.ReadAt(offsets[block], buffer)) {
+                return false;
+            }
+
+            const auto count = Compression::Decompress(codec, buffer, target);
+            return count.has_value() && *count == target.size();
+        }
+
+        Option<std::span<const u8>> CachedBlock(const u32 block) {
+            if (cachedIndex != block) {
+                cachedIndex.reset();
+                cache.resize(BlockLength(block));
+                if (!ExpandBlock(block, cache, scratch)) {
+                    return kNone;
+                }
+
+                cachedIndex = block;
+            }
+
+            return std::span<const u8>(cache);
+        }
+    };
+
+    // Remembers XXH3 digests by path, keyed on each file's size and last-write time, so asking
+    // again about an unchanged file costs a stat rather than a read. A rewrite that keeps both
+    // the size and the timestamp goes unnoticed. Save and Load carry entries across runs; all
+    // members are safe to call concurrently.
+    class HashCache {
+    public:
+        // The cached digest while the file is unchanged. Otherwise the file is streamed through
+        // XXH3, without keeping its content, and the result cached.
+        Option<u64> Digest(const Path& filename, std::error_code& error) {
+            RIEGER_PROFILE_SCOPE("IO::HashCache::Digest");
+            const auto before = StampOf(filename, error);
+            if (!before.has_value()) {
+                return kNone;
+            }
+
+            const auto key = Key(filename);
+            {
+                std::shared_lock lock(mutex);
+                const auto entry = entries.find(key);
+                if (entry != entries.end() && entry->second.stamp == *before) {
+                    return entry->second.digest;
+                }
+            }
+
+            const auto file = Detail::OpenForReading(filename, error);
+            if (!file.has_value()) {
+                return kNone;
+            }
+
+            Hash::XXH3State state;
+            Vector<u8> chunk(kChunkSize);
+            for (u64 offset = 0;;) {
+                const auto count = file->ReadSome(offset, chunk);
+                if (!count.has_value()) {
+                    error = Detail::LastError();
+                    return kNone;
+                }
+
+                if (*count == 0) {
+                    break;
+                }
+
+                RIEGER_PROFILE_BYTES(*count);
+                state.Update(std::span<const u8>(chunk.data(), *count));
+                offset += *count;
+            }
+
+            // A file that changed while it was read is hashed but not remembered.
+            const u64 digest = state.Digest();
+            std::error_code ignored;
+            if (StampOf(filename, ignored) == before) {
+                std::unique_lock lock(mutex);
+                entries.insert_or_assign(key, Entry {*before, digest});
+            }
+
+            return digest;
+        }
+
+        Option<u64> Digest(const Path& filename) {
+            std::error_code error;
+            return Digest(filename, error);
+        }
+
+        // True if the file's content hashes to expected; a cache hit skips the read entirely.
+        bool Verify(const Path& filename, const u64 expected) {
+            return Digest(filename) == expected;
+        }
+
+        // The cached digest if there is one and the file has not changed since; never reads.
+        [[nodiscard]] Option<u64> Lookup(const Path& filename) const {
+            std::error_code error;
+            const auto stamp = StampOf(filename, error);
+            if (!stamp.has_value()) {
+                return kNone;
+            }
+
+            std::shared_lock lock(mutex);
+            const auto entry = entries.find(Key(filename));
+            if (entry == entries.end() || entry->second.stamp != *stamp) {
+                return kNone;
+            }
+
+            return entry->second.digest;
+        }
+
+        // Records a digest computed elsewhere, e.g. by ReadAllBytes into a Hash::XXH3State.
+        // The entry takes the file's current stamp, so store right after the read.
+        bool Store(const Path& filename, const u64 digest) {
+            std::error_code error;
+            const auto stamp = StampOf(filename, error);
+            if (!stamp.has_value()) {
+                return false;
+            }
+
+            std::unique_lock lock(mutex);
+            entries.insert_or_assign(Key(filename), Entry {*stamp, digest});
+            return true;
+        }
+
+        void Forget(const Path& filename) {
+            std::unique_lock lock(mutex);
+            entries.erase(Key(filename));
+        }
+
+        void Clear() {
+            std::unique_lock lock(mutex);
+            entries.clear();
+        }
+
+        [[nodiscard]] size_t Size() const {
+            std::shared_lock lock(mutex);
+            return entries.size();
+        }
+
+        // Stamps are only meaningful on the machine that took them, so a saved cache should
+        // not travel with the files it describes.
+        bool Save(const Path& filename, const WriteMode mode = WriteMode::Atomic) const {
+            using Compression::Detail::Store32;
+            using Compression::Detail::Store64;
+
+            Vector<u8> bytes(kHeaderSize);
+            {
+                std::shared_lock lock(mutex);
+                Store32(bytes.data(), kMagic);
+                Store32(bytes.data() + 4, kVersion);
+                Store64(bytes.data() + 8, entries.size());
+                for (const auto& [key, entry] : entries) {
+                    const auto path   = Path(key).u8string();
+                    const size_t used = bytes.size();
+                    bytes.resize(used + kEntrySize + path.size());
+                    u8* target = bytes.data() + used;
+                    Store64(target, CAST<u64>(entry.stamp.modified));
+                    Store64(target + 8, entry.stamp.size);
+                    Store64(target + 16, entry.digest);
+                    Store32(target + 24, CAST<u32>(path.size()));
+                    std::memcpy(target + kEntrySize, path.data(), path.size());
+                }
+            }
+
+            return WriteAllBytes(filename, bytes, mode);
+        }
+
+        // Merges a saved cache into this one. False, with nothing merged, if the file is
+        // missing or malformed.
+        bool Load(const Path& filename) {
+            using Compression::Detail::Load32;
+            using Compression::Detail::Load64;
+
+            const auto bytes = ReadAllBytes(filename);
+            if (!bytes.has_value() || bytes->size() < kHeaderSize ||
+                Load32(bytes->data()) != kMagic || Load32(bytes->data() + 4) != kVersion) {
+                return false;
+            }
+
+            const u64 count = Load64(bytes->data() + 8);
+            std::unordered_map<Path::string_type, Entry> loaded;
+            size_t offset = kHeaderSize;
+            for (u64 i = 0; i < count; ++i) {
+                if (bytes->size() - offset < kEntrySize) {
+                    return false;
+                }
+
+                const u8* source    = bytes->data() + offset;
+                const size_t length = Load32(source + 24);
+                if (bytes->size() - offset - kEntrySize < length) {
+                    return false;
+                }
+
+                const auto* text = RCAST<const char8_t*>(source + kEntrySize);
+                Entry entry {{CAST<i64>(Load64(source)), Load64(source + 8)}, Load64(source + 16)};
+                loaded.insert_or_assign(Path(std::u8string(text, length)).native(), entry);
+                offset += kEntrySize + length;
+            }
+
+            std::unique_lock lock(mutex);
+            for (auto& [key, entry] : loaded) {
+                entries.insert_or_assign(std::move(key), entry);
+            }
+
+            return true;
+        }
+
+    private:
+        static constexpr size_t kChunkSize  = 1024 * 1024;
+        static constexpr u32 kMagic         = 0x43484752;  // "RGHC"
+        static constexpr u32 kVersion       = 1;
+        static constexpr size_t kHeaderSize = 16;
+        static constexpr size_t kEntrySize  = 28;
+
+        struct Stamp {
+            i64 modified = 0;
+            u64 size     = 0;
+
+            bool operator==(const Stamp&) const = default;
+        };
+
+        struct Entry {
+            Stamp stamp;
+            u64 digest = 0;
+        };
+
+        mutable std::shared_mutex mutex;
+        std::unordered_map<Path::string_type, Entry> entries;
+
+        static Path::string_type Key(const Path& filename) {
+            return filename.lexically_normal().native();
+        }
+
+        static Option<Stamp> StampOf(const Path& filename, std::error_code& error) {
+#if defined(_WIN32) || defined(_WIN64)
+            WIN32_FILE_ATTRIBUTE_DATA data {};
+            if (!::GetFileAttributesExW(filename.c_str(), GetFileExInfoStandard, &data)) {
+                error = Detail::LastError();
+                return kNone;
+            }
+
+            if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+                error = std::make_error_code(std::errc::is_a_directory);
+                return kNone;
+            }
+
+            const u64 modified = (CAST<u64>(data.ftLastWriteTime.dwHighDateTime) << 32) |
+                                 data.ftLastWriteTime.dwLowDateTime;
+            const u64 size     = (CAST<u64>(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+            return Stamp {CAST<i64>(modified), size};
+#else
+            struct stat info {};
+            if (::stat(filename.c_str(), &info) != 0) {
+                error = Detail::LastError();
+                return kNone;
+            }
+
+            if (!S_ISREG(info.st_mode)) {
+                error = std::make_error_code(std::errc::invalid_argument);
+                return kNone;
+            }
+
+    #if defined(__APPLE__)
+            const auto& modified = info.st_mtimespec;
+    #else
+            const auto& modified = info.st_mtim;
+    #endif
+            return Stamp {CAST<i64>(modified.tv_sec) * 1000000000 + modified.tv_nsec,
+                          CAST<u64>(info.st_size)};
+#endif
+        }
+    };
+}  // namespace IO
+
+// Binary serialization on top of IO. Everything goes out little-endian. Scalars and trivially
+// copyable structs are copied as their object representation (padding included), and
+// contiguous runs of them with a single memcpy, so large arrays save and load at memory
+// bandwidth rather than field by field. Other types opt in with a member pair
+//
+//     void Serialize(Serialization::Writer& writer) const;
+//     bool Deserialize(Serialization::Reader& reader);
+//
+// Sized ranges are written as a u64 count followed by their elements and std::optional as a
+// presence flag. Serialize/Save frame the payload with a magic number and a caller-chosen
+// version that Deserialize implementations can branch on through Reader::Version().
+namespace Serialization {
+    class Writer;
+    class Reader;
+
+    template<typename T>
+    concept Serializable = requires(const T& value, T& target, Writer& writer, Reader& reader) {
+        value.Serialize(writer);
+        { target.Deserialize(reader) } -> std::convertible_to<bool>;
+    };
+
+    template<typename T>
+    concept Scalar = std::is_arithmetic_v<T> || std::is_enum_v<T>;
+
+    // Types whose bytes are their wire format. Scalars are byte-swapped on big-endian hosts,
+    // where structs need their own Serialize instead.
+    template<typename T>
+    concept TriviallyCopyableAggregate =
+      (std::is_class_v<T> || std::is_array_v<T>) && std::is_trivially_copyable_v<T> &&
+      std::is_standard_layout_v<T>;
+
+    template<typename T>
+    concept BulkCopyable =
+      !Serializable<T> &&
+      (Scalar<T> || (TriviallyCopyableAggregate<T> && std::endian::native == std::endian::little));
+
+    inline constexpr u32 kMagic = 0x31534752;  // "RGS1"
+
+    namespace Detail {
+        template<typename T>
+        inline constexpr bool kIsOptional = false;
+
+        template<typename T>
+        inline constexpr bool kIsOptional<std::optional<T>> = true;
+
+        template<std::unsigned_integral T>
+        constexpr T ByteSwap(T value) noexcept {
+            T result = 0;
+            for (size_t i = 0; i < sizeof(T); ++i) {
+                result = CAST<T>((result << 8) | (value & 0xFF));
+                value  = CAST<T>(value >> 8);
+            }
+
+            return result;
+        }
+
+        // Converts between host and wire (little-endian) order; the same operation both ways.
+        template<Scalar T>
+        T ToWire(const T value) noexcept {
+            if constexpr (std::endian::native == std::endian::little || sizeof(T) == 1) {
+                return value;
+            } else {
+                static_assert(sizeof(T) <= sizeof(u64), "no wire format for this scalar");
+                using Bits = std::conditional_t<sizeof(T) == 2,
+                                                u16,
+                                                std::conditional_t<sizeof(T) == 4, u32, u64>>;
+                return std::bit_cast<T>(ByteSwap(std::bit_cast<Bits>(value)));
+            }
+        }
+    }  // namespace Detail
+
+    class Writer {
+    public:
+        // Counts bytes without storing them; see Measure.
+        Writer() = default;
+
+        // Appends to buffer, which grows geometrically.
+        explicit Writer(Vector<u8>& buffer) noexcept : buffer(&buffer) {}
+
+        // Fixed storage such as a MappedFile view. Running out of room fails the writer.
+        explicit Writer(const std::span<u8> target) noexcept
+            : cursor(target.data()), end(target.data() + target.size()), bounded(true) {}
+
+        void WriteBytes(const void* data, const size_t size) {
+            if (failed || size == 0) {
+                return;
+            }
+
+            const auto* bytes = CAST<const u8*>(data);
+            if (buffer) {
+                buffer->insert(buffer->end(), bytes, bytes + size);
+            } else if (bounded) {
+                if (CAST<size_t>(end - cursor) < size) {
+                    failed = true;
+                    return;
+                }
+
+                std::memcpy(cursor, bytes, size);
+                cursor += size;
+            }
+
+            written += size;
+        }
+
+        template<typename T>
+        void Write(const T& value) {
+            if constexpr (Serializable<T>) {
+                value.Serialize(*this);
+            } else if constexpr (BulkCopyable<T>) {
+                WriteRun(&value, 1);
+            } else if constexpr (Detail::kIsOptional<T>) {
+                Write(value.has_value());
+                if (value.has_value()) {
+                    Write(*value);
+                }
+            } else if constexpr (std::ranges::sized_range<T>) {
+                using Element = std::ranges::range_value_t<T>;
+                Write(CAST<u64>(std::ranges::size(value)));
+                if constexpr (std::ranges::contiguous_range<T> && BulkCopyable<Element>) {
+                    WriteRun(std::ranges::data(value), std::ranges::size(value));
+                } else {
+                    for (const auto& element : value) {
+                        Write(element);
+                    }
+                }
+            } else {
+                static_assert(sizeof(T) == 0, "type is not serializable");
+            }
+        }
+
+        [[nodiscard]] size_t Size() const noexcept {
+            return written;
+        }
+
+        [[nodiscard]] bool Failed() const noexcept {
+            return failed;
+        }
+
+    private:
+        Vector<u8>* buffer = nullptr;
+        u8* cursor         = nullptr;
+        u8* end            = nullptr;
+        size_t written     = 0;
+        bool bounded       = false;
+        bool failed        = false;
+
+        template<typename T>
+        void WriteRun(const T* data, const size_t count) {
+            if constexpr (std::endian::native == std::endian::little || sizeof(T) == 1) {
+                WriteBytes(data, count * sizeof(T));
+            } else {
+                for (size_t i = 0; i < count; ++i) {
+                    const T wire = Detail::ToWire(data[i]);
+                    WriteBytes(&wire, sizeof(T));
+                }
+            }
+        }
+    };
+
+    // Reads what Writer wrote. Failures are sticky and every length is checked against the
+    // remaining input, so truncated or corrupt data fails cleanly rather than over-allocating.
+    class Reader {
+    public:
+        explicit Reader(const std::span<const u8> source, const u32 version = 0) noexcept
+            : cursor(source.data()), end(source.data() + source.size()), version(version) {}
+
+        bool ReadBytes(void* data, const size_t size) {
+            if (failed || Remaining() < size) {
+                return Fail();
+            }
+
+            if (size > 0) {
+                std::memcpy(data, cursor, size);
+                cursor += size;
+            }
+
+            return true;
+        }
+
+        template<typename T>
+        bool Read(T& value) {
+            if (failed) {
+                return false;
+            }
+
+            if constexpr (Serializable<T>) {
+                return value.Deserialize(*this) && !failed ? true : Fail();
+            } else if constexpr (BulkCopyable<T>) {
+                return ReadRun(&value, 1);
+            } else if constexpr (Detail::kIsOptional<T>) {
+                bool present = false;
+                if (!Read(present)) {
+                    return false;
+                }
+
+                if (!present) {
+                    value.reset();
+                    return true;
+                }
+
+                return Read(value.emplace());
+            } else if constexpr (std::ranges::contiguous_range<T> &&
+                                 BulkCopyable<std::ranges::range_value_t<T>> &&
+                                 requires(T target) { target.resize(size_t {}); }) {
+                using Element = std::ranges::range_value_t<T>;
+                u64 count     = 0;
+                if (!Read(count) || count > Remaining() / sizeof(Element)) {
+                    return Fail();
+                }
+
+                value.resize(CAST<size_t>(count));
+                return ReadRun(std::ranges::data(value), CAST<size_t>(count));
+            } else if constexpr (requires(T target, std::ranges::range_value_t<T> element) {
+                                     target.clear();
+                                     target.push_back(std::move(element));
+                                 }) {
+                u64 count = 0;
+                if (!Read(count)) {
+                    return false;
+                }
+
+                value.clear();
+                if constexpr (requires { value.reserve(size_t {}); }) {
+                    value.reserve(CAST<size_t>(std::min<u64>(count, Remaining())));
+                }
+
+                for (u64 i = 0; i < count; ++i) {
+                    std::ranges::range_value_t<T> element {};
+                    if (!Read(element)) {
+                        return false;
+                    }
+
+                    value.push_back(std::move(element));
+                }
+
+                return true;
+            } else {
+                static_assert(sizeof(T) == 0, "type is not deserializable");
+            }
+        }
+
+        template<std::default_initializable T>
+        Option<T> Read() {
+            T value {};
+            if (!Read(value)) {
+                return kNone;
+            }
+
+            return value;
+        }
+
+        // For Deserialize implementations that reject a field value.
+        bool Fail() noexcept {
+            failed = true;
+            return false;
+        }
+
+        [[nodiscard]] size_t Remaining() const noexcept {
+            return CAST<size_t>(end - cursor);
+        }
+
+        [[nodiscard]] u32 Version() const noexcept {
+            return version;
+        }
+
+        [[nodiscard]] bool Failed() const noexcept {
+            return failed;
+        }
+
+    private:
+        const u8* cursor = nullptr;
+        const u8* end    = nullptr;
+        u32 version      = 0;
+        bool failed      = false;
+
+        template<typename T>
+        bool ReadRun(T* data, const size_t count) {
+            const size_t size = count * sizeof(T);
+            if constexpr (std::same_as<std::remove_all_extents_t<T>, bool>) {
+                // Anything but 0 or 1 in a bool is undefined behavior once loaded.
+                if (Remaining() >= size && std::any_of(cursor, cursor + size, [](u8 b) {
+                        return b > 1;
+                    })) {
+                    return Fail();
+                }
+            }
+
+            if (!ReadBytes(data, size)) {
+                return false;
+            }
+
+            if constexpr (std::endian::native != std::endian::little && sizeof(T) > 1) {
+                for (size_t i = 0; i < count; ++i) {
+                    data[i] = Detail::ToWire(data[i]);
+                }
+            }
+
+            return true;
+        }
+    };
+
+    // Header plus payload size of Serialize(value).
+    template<typename T>
+    size_t Measure(const T& value) {
+        Writer writer;
+        writer.Write(kMagic);
+        writer.Write(u32 {});
+        writer.Write(value);
+        return writer.Size();
+    }
+
+    // Appends the framed encoding of value to buffer.
+    template<typename T>
+    void Serialize(const T& value, Vector<u8>& buffer, const u32 version = 0) {
+        Writer writer(buffer);
+        writer.Write(kMagic);
+        writer.Write(version);
+        writer.Write(value);
+    }
+
+    template<typename T>
+    Vector<u8> Serialize(const T& value, const u32 version = 0) {
+        Vector<u8> buffer;
+        Serialize(value, buffer, version);
+        return buffer;
+    }
+
+    // kNone unless bytes hold exactly one framed value of type T.
+    template<std::default_initializable T>
+    Option<T> Deserialize(const std::span<const u8> bytes) {
+        Reader header(bytes);
+        u32 magic   = 0;
+        u32 version = 0;
+        if (!header.Read(magic) || magic != kMagic || !header.Read(version)) {
+            return kNone;
+        }
+
+        Reader reader(bytes.subspan(bytes.size() - header.Remaining()), version);
+        auto value = reader.Read<T>();
+        if (!value.has_value() || reader.Remaining() != 0) {
+            return kNone;
+        }
+
+        return value;
+    }
+
+    template<typename T>
+    bool Save(const Path& filename,
+              const T& value,
+              const u32 version        = 0,
+              const IO::WriteMode mode = IO::WriteMode::InPlace) {
+        return IO::WriteAllBytes(filename, Serialize(value, version), mode);
+    }
+
+    // Sizes the file up front and writes straight into a mapping of it, with no intermediate
+    // buffer however large the value.
+    template<typename T>
+    bool SaveMapped(const Path& filename, const T& value, const u32 version = 0) {
+        const size_t size = Measure(value);
+        if (!IO::FileHandle::Open(filename, IO::FileAccess::Create).has_value()) {
+            return false;
+        }
+
+        std::error_code error;
+        FileSystem::resize_file(filename, size, error);
+        if (error) {
+            return false;
+        }
+
+        auto mapped = IO::MappedFile::Open(filename, IO::MapMode::ReadWrite);
+        if (!mapped.has_value()) {
+            return false;
+        }
+
+        Writer writer(mapped->MutableView());
+        writer.Write(kMagic);
+        writer.Write(version);
+        writer.Write(value);
+        return !writer.Failed() && writer.Size() == size;
+    }
+
+    // Deserializes directly out of a read-only mapping of the file.
+    template<std::default_initializable T>
+    Option<T> Load(const Path& filename) {
+        const auto mapped = IO::MappedFile::Open(filename);
+        if (!mapped.has_value()) {
+            return kNone;
+        }
+
+        return Deserialize<T>(mapped->View());
+    }
+}  // namespace Serialization
+
+// UTF-8 <-> UTF-16 transcoding. The span overloads write into caller storage and return the
+// number of code units written, or kNone for malformed input (overlong forms, surrogates in
+// UTF-8, unpaired surrogates in UTF-16, code points past U+10FFFF) or a buffer that is too
+// small. A UTF-16 result never has more units than the UTF-8 input has bytes, and a UTF-8
+// result takes at most three bytes per UTF-16 unit, so buffers of those sizes always suffice.
+// Runs of ASCII are converted 16 characters at a time with SIMD.
+namespace Unicode {
+    namespace Detail {
+        // Length of the leading run of ASCII that can be widened (or narrowed) wholesale into
+        // out, a multiple of 16 characters.
+        inline size_t WidenAscii(const char* in, const size_t count, char16_t* out) noexcept {
+            size_t i = 0;
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+            const __m128i zero = _mm_setzero_si128();
+            for (; i + 16 <= count; i += 16) {
+                const __m128i bytes = _mm_loadu_si128(RCAST<const __m128i*>(in + i));
+                if (_mm_movemask_epi8(bytes) != 0) {
+                    break;
+                }
+
+                _mm_storeu_si128(RCAST<__m128i*>(out + i), _mm_unpacklo_epi8(bytes, zero));
+                _mm_storeu_si128(RCAST<__m128i*>(out + i + 8), _mm_unpackhi_epi8(bytes, zero));
+            }
+#elif defined(__aarch64__) || defined(_M_ARM64)
+            for (; i + 16 <= count; i += 16) {
+                const uint8x16_t bytes = vld1q_u8(RCAST<const u8*>(in + i));
+                if (vmaxvq_u8(bytes) >= 0x80) {
+                    break;
+                }
+
+                vst1q_u16(RCAST<u16*>(out + i), vmovl_u8(vget_low_u8(bytes)));
+                vst1q_u16(RCAST<u16*>(out + i + 8), vmovl_high_u8(bytes));
+            }
+#endif
+            return i;
+        }
+
+        inline size_t NarrowAscii(const char16_t* in, const size_t count, char* out) noexcept {
+            size_t i = 0;
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+            const __m128i nonAscii = _mm_set1_epi16(CAST<i16>(0xFF80));
+            for (; i + 16 <= count; i += 16) {
+                const __m128i low  = _mm_loadu_si128(RCAST<const __m128i*>(in + i));
+                const __m128i high = _mm_loadu_si128(RCAST<const __m128i*>(in + i + 8));
+                const __m128i bits = _mm_and_si128(_mm_or_si128(low, high), nonAscii);
+                if (_mm_movemask_epi8(_mm_cmpeq_epi16(bits, _mm_setzero_si128())) != 0xFFFF) {
+                    break;
+                }
+
+                _mm_storeu_si128(RCAST<__m128i*>(out + i), _mm_packus_epi16(low, high));
+            }
+#elif defined(__aarch64__) || defined(_M_ARM64)
+            for (; i + 16 <= count; i += 16) {
+                const uint16x8_t low  = vld1q_u16(RCAST<const u16*>(in + i));
+                const uint16x8_t high = vld1q_u16(RCAST<const u16*>(in + i + 8));
+                if (vmaxvq_u16(vorrq_u16(low, high)) >= 0x80) {
+                    break;
+                }
+
+                vst1q_u8(RCAST<u8*>(out + i), vcombine_u8(vmovn_u16(low), vmovn_u16(high)));
+            }
+#endif
+            return i;
+        }
+    }  // namespace Detail
+
+    inline Option<size_t> Utf8ToUtf16(const std::string_view in, std::span<char16_t> out) noexcept {
+        const auto* bytes = RCAST<const u8*>(in.data());
+        const size_t size = in.size();
+        size_t i          = 0;
+        size_t written    = 0;
+        while (i < size) {
+            if (bytes[i] < 0x80) {
+                const size_t room = std::min(size - i, out.size() - written);
+                const size_t run  = Detail::WidenAscii(in.data() + i, room, out.data() + written);
+                i += run;
+                written += run;
+                // Finish the run one character at a time up to the next multibyte sequence.
+                while (i < size && bytes[i] < 0x80) {
+                    if (written == out.size()) {
+                        return kNone;
+                    }
+
+                    out[written++] = bytes[i++];
+                }
+
+                continue;
+            }
+
+            const u8 lead = bytes[i];
+            size_t length;
+            u32 codePoint;
+            u32 minimum;
+            if ((lead & 0xE0) == 0xC0) {
+                length    = 2;
+                codePoint = lead & 0x1F;
+                minimum   = 0x80;
+            } else if ((lead & 0xF0) == 0xE0) {
+                length    = 3;
+                codePoint = lead & 0x0F;
+                minimum   = 0x800;
+            } else if ((lead & 0xF8) == 0xF0) {
+                length    = 4;
+                codePoint = lead & 0x07;
+                minimum   = 0x10000;
+            } else {
+                return kNone;
+            }
+
+            if (size - i < length) {
+                return kNone;
+            }
+
+            for (size_t k = 1; k < length; ++k) {
+                if ((bytes[i + k] & 0xC0) != 0x80) {
+                    return kNone;
+                }
+
+                codePoint = (codePoint << 6) | (bytes[i + k] & 0x3F);
+            }
+
+            if (codePoint < minimum || codePoint > 0x10FFFF ||
+                (codePoint >= 0xD800 && codePoint <= 0xDFFF)) {
+                return kNone;
+            }
+
+            const size_t units = codePoint >= 0x10000 ? 2 : 1;
+            if (out.size() - written < units) {
+                return kNone;
+            }
+
+            if (units == 2) {
+                codePoint -= 0x10000;
+                out[written++] = CAST<char16_t>(0xD800 + (codePoint >> 10));
+                out[written++] = CAST<char16_t>(0xDC00 + (codePoint & 0x3FF));
+            } else {
+                out[written++] = CAST<char16_t>(codePoint);
+            }
+
+            i += length;
+        }
+
+        return written;
+    }
+
+    inline Option<size_t> Utf16ToUtf8(const std::u16string_view in, std::span<char> out) noexcept {
+        const size_t size = in.size();
+        size_t i          = 0;
+        size_t written    = 0;
+        while (i < size) {
+            if (in[i] < 0x80) {
+                const size_t room = std::min(size - i, out.size() - written);
+                const size_t run  = Detail::NarrowAscii(in.data() + i, room, out.data() + written);
+                i += run;
+                written += run;
+                while (i < size && in[i] < 0x80) {
+                    if (written == out.size()) {
+                        return kNone;
+                    }
+
+                    out[written++] = CAST<char>(in[i++]);
+                }
+
+                continue;
+            }
+
+            u32 codePoint = in[i];
+            size_t units  = 1;
+            if (codePoint >= 0xD800 && codePoint <= 0xDFFF) {
+                const bool paired = codePoint <= 0xDBFF && i + 1 < size && in[i + 1] >= 0xDC00 &&
+                                    in[i + 1] <= 0xDFFF;
+                if (!paired) {
+                    return kNone;
+                }
+
+                codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (in[i + 1] - 0xDC00);
+                units     = 2;
+            }
+
+            const size_t length = codePoint < 0x800 ? 2 : (codePoint < 0x10000 ? 3 : 4);
+            if (out.size() - written < length) {
+                return kNone;
+            }
+
+            auto* target = RCAST<u8*>(out.data() + written);
+            if (length == 2) {
+                target[0] = CAST<u8>(0xC0 | (codePoint >> 6));
+            } else if (length == 3) {
+                target[0] = CAST<u8>(0xE0 | (codePoint >> 12));
+                target[1] = CAST<u8>(0x80 | ((codePoint >> 6) & 0x3F));
+            } else {
+                target[0] = CAST<u8>(0xF0 | (codePoint >> 18));
+                target[1] = CAST<u8>(0x80 | ((codePoint >> 12) & 0x3F));
+                target[2] = CAST<u8>(0x80 | ((codePoint >> 6) & 0x3F));
+            }
+
+            target[length - 1] = CAST<u8>(0x80 | (codePoint & 0x3F));
+            written += length;
+            i += units;
+        }
+
+        return written;
+    }
+
+    // String forms: size out for the worst case once, convert, then trim. out keeps its
+    // capacity across calls; on failure it is left empty.
+    inline bool Utf8ToUtf16(const std::string_view in, std::u16string& out) {
+        out.resize(in.size());
+        const auto written = Utf8ToUtf16(in, std::span(out));
+        out.resize(written.value_or(0));
+        return written.has_value();
+    }
+
+    inline bool Utf16ToUtf8(const std::u16string_view in, str& out) {
+        out.resize(in.size() * 3);
+        const auto written = Utf16ToUtf8(in, std::span(out));
+        out.resize(written.value_or(0));
+        return written.has_value();
+    }
+}  // namespace Unicode
+
+#if defined(_WIN32) || defined(_WIN64)
+
+namespace WindowsAPI {
+    namespace Detail {
+        // System messages keyed by HRESULT. FormatMessageA runs once per code; after that a
+        // lookup is a shared lock and a copy. Growth stops at kMaxCachedMessages so a stream of
+        // distinct codes cannot grow the table without bound.
+        inline constexpr size_t kMaxCachedMessages = 128;
+
+        struct HResultMessageCache {
+            std::shared_mutex mutex;
+            std::unordered_map<HRESULT, str> messages;
+        };
+
+        inline HResultMessageCache& MessageCache() noexcept {
+            static HResultMessageCache cache;
+            return cache;
+        }
+
+        // Copies the message for hr into out, null-terminated and truncated to fit, and
+        // returns its length. Trailing line breaks from FormatMessage are dropped.
+        inline size_t CopyHResultMessage(HRESULT hr, std::span<char> out) noexcept {
+            if (out.empty()) {
+                return 0;
+            }
+
+            auto& cache = MessageCache();
+            const auto copy = [&](std::string_view message) {
+                const size_t count = std::min(message.size(), out.size() - 1);
+                std::copy_n(message.data(), count, out.data());
+                out[count] = '\0';
+                return count;
+            };
+
+            {
+                std::shared_lock lock(cache.mutex);
+                if (const auto it = cache.messages.find(hr); it != cache.messages.end()) {
+                    return copy(it->second);
+                }
+            }
+
+            char buffer[512];
+            DWORD length = FormatMessageA(
+              FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_IGNORE_INSERTS,
+              nullptr,
+              hr,
+              MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT),
+              buffer,
+              CAST<DWORD>(std::size(buffer)),
+              nullptr);
+            while (length > 0 && (buffer[length - 1] == '\n' || buffer[length - 1] == '\r')) {
+                --length;
+            }
+
+            const std::string_view message =
+              length > 0 ? std::string_view(buffer, length) : std::string_view("Unknown error");
+            try {
+                std::unique_lock lock(cache.mutex);
+                if (cache.messages.size() < kMaxCachedMessages) {
+                    cache.messages.try_emplace(hr, message);
+                }
+            } catch (...) {
+                // Caching is an optimization; a failed insert still returns the message.
+            }
+
+            return copy(message);
+        }
+    }  // namespace Detail
+
+    inline std::string GetHResultErrorMessage(HRESULT hr) {
+        char buffer[512];
+        const size_t length = Detail::CopyHResultMessage(hr, std::span(buffer));
+        return std::string(buffer, length);
+    }
+
+    // The message is formatted on the first what() call into storage owned by the exception,
+    // so concurrent exceptions never share a buffer and repeated what() calls do no work.
+    class ComError final : public std::exception {
+    public:
+        explicit ComError(HRESULT hr) noexcept : result(hr) {}
+
+        ComError(const ComError& other) noexcept : std::exception(other), result(other.result) {
+            CopyMessageFrom(other);
+        }
+
+        ComError& operator=(const ComError& other) noexcept {
+            if (this != &other) {
+                std::exception::operator=(other);
+                result = other.result;
+                state.store(kEmpty, std::memory_order_relaxed);
+                CopyMessageFrom(other);
+            }
+
+            return *this;
+        }
+
+        [[nodiscard]] HRESULT Result() const noexcept {
+            return result;
+        }
+
+        [[nodiscard]] const char* what() const noexcept override {
+            if (state.load(std::memory_order_acquire) == kReady) {
+                return message;
+            }
+
+            u8 expected = kEmpty;
+            if (state.compare_exchange_strong(expected, kFormatting, std::memory_order_acquire)) {
+                char system[192];
+                Detail::CopyHResultMessage(result, std::span(system));
+                snprintf(message,
+                         sizeof(message),
+                         "Failure with HRESULT of %08X.\nError: %s\n",
+                         CAST<u32>(result),
+                         system);
+                state.store(kReady, std::memory_order_release);
+            } else {
+                // Another thread holding the same exception object is formatting it.
+                while (state.load(std::memory_order_acquire) != kReady) {
+                    std::this_thread::yield();
+                }
+            }
+
+            return message;
+        }
+
+    private:
+        static constexpr u8 kEmpty      = 0;
+        static constexpr u8 kFormatting = 1;
+        static constexpr u8 kReady      = 2;
+
+        HRESULT result;
+        mutable std::atomic<u8> state {kEmpty};
+        mutable char message[256] {};
+
+        void CopyMessageFrom(const ComError& other) noexcept {
+            if (other.state.load(std::memory_order_acquire) == kReady) {
+                std::copy_n(other.message, sizeof(message), message);
+                state.store(kReady, std::memory_order_release);
+            }
+        }
+    };
+
+    inline void ThrowIfFailed(HRESULT hr) {
+        if (FAILED(hr)) {
+            throw ComError(hr);
+        }
+    }
+
+    enum class AlertSeverity : u32 {
+        Info    = MB_ICONINFORMATION | MB_OK,
+        Warning = MB_ICONWARNING | MB_OK,
+        Error   = MB_ICONERROR | MB_OK,
+    };
+
+    inline void ShowMessage(const str& message,
+                            const AlertSeverity severity,
+                            const str& caption = "Alert",
+                            HWND window        = nullptr) {
+        ::MessageBoxA(window, message.c_str(), caption.c_str(), CAST<u32>(severity));
+    }
+
+    // UTF-16 to UTF-8 (despite the name) through WideCharToMultiByte. The buffer overload
+    // returns the bytes written, or kNone for invalid input or a buffer that is too small.
+    inline Option<size_t> WideToANSI(const std::wstring_view value, std::span<char> buffer) {
+        if (value.empty()) {
+            return 0;
+        }
+
+        const size_t capacity = std::min<size_t>(buffer.size(), std::numeric_limits<int>::max());
+
+        const int written = ::WideCharToMultiByte(CP_UTF8,
+                                                  WC_ERR_INVALID_CHARS,
+                                                  value.data(),
+                                                  CAST<int>(value.size()),
+                                                  buffer.data(),
+                                                  CAST<int>(capacity),
+                                                  nullptr,
+                                                  nullptr);
+        if (written <= 0) {
+            return kNone;
+        }
+
+        return CAST<size_t>(written);
+    }
+
+    // Sizes converted with one query and fills it with one conversion; throws std::range_error
+    // on invalid UTF-16, like the codecvt-based version did.
+    inline void WideToANSI(const std::wstring_view value, str& converted) {
+        if (value.empty()) {
+            converted.clear();
+            return;
+        }
+
+        const int size = ::WideCharToMultiByte(CP_UTF8,
+                                               WC_ERR_INVALID_CHARS,
+                                               value.data(),
+                                               CAST<int>(value.size()),
+                                               nullptr,
+                                               0,
+                                               nullptr,
+                                               nullptr);
+        if (size <= 0) {
+            throw std::range_error("WideToANSI: invalid UTF-16");
+        }
+
+        converted.resize(CAST<size_t>(size));
+        WideToANSI(value, std::span(converted));
+    }
+
+    // UTF-8 to UTF-16 through MultiByteToWideChar; same contract as WideToANSI.
+    inline Option<size_t> ANSIToWide(const std::string_view value, std::span<wchar_t> buffer) {
+        if (value.empty()) {
+            return 0;
+        }
+
+        const size_t capacity = std::min<size_t>(buffer.size(), std::numeric_limits<int>::max());
+
+        const int written = ::MultiByteToWideChar(CP_UTF8,
+                                                  MB_ERR_INVALID_CHARS,
+                                                  value.data(),
+                                                  CAST<int>(value.size()),
+                                                  buffer.data(),
+                                                  CAST<int>(capacity));
+        if (written <= 0) {
+            return kNone;
+        }
+
+        return CAST<size_t>(written);
+    }
+
+    inline void ANSIToWide(const std::string_view value, wstr& converted) {
+        if (value.empty()) {
+            converted.clear();
+            return;
+        }
+
+        const int size = ::MultiByteToWideChar(
+          CP_UTF8, MB_ERR_INVALID_CHARS, value.data(), CAST<int>(value.size()), nullptr, 0);
+        if (size <= 0) {
+            throw std::range_error("ANSIToWide: invalid UTF-8");
+        }
+
+        converted.resize(CAST<size_t>(size));
+        ANSIToWide(value, std::span(converted));
+    }
+}  // namespace WindowsAPI
+#endif
+
+namespace Math {
+    template<typename T>
+    concept FiniteFloat = std::floating_point<T> && requires(T value) {
+        { std::isfinite(value) } -> std::convertible_to<bool>;
+    };
+
+    // Interpolates in the wider of T and U, so Lerp(f32, f32, f32) stays in single precision
+    // while Lerp(f32, f32, f64) keeps the old double-precision behavior.
+    template<FiniteFloat T, class U = T>
+        requires std::is_arithmetic_v<U>
+    constexpr T Lerp(const T a, const T b, const U t) noexcept {
+        using Compute = std::conditional_t<std::floating_point<U>, std::common_type_t<T, U>, T>;
+        if (a == b) {
+            return a;
+        }
+
+        const auto weight = CAST<Compute>(t);
+        const auto result = CAST<Compute>(a) * (Compute(1) - weight) + CAST<Compute>(b) * weight;
+        return CAST<T>(result);
+    }
+
+    template<FiniteFloat T>
+    constexpr T Clamp01(const T value) noexcept {
+        return value < T(0) ? T(0) : (value > T(1) ? T(1) : value);
+    }
+
+    // Where value sits between a and b: 0 at a, 1 at b, unclamped. Returns 0 when a == b.
+    template<FiniteFloat T>
+    constexpr T InverseLerp(const T a, const T b, const T value) noexcept {
+        if (a == b) {
+            return T(0);
+        }
+
+        return (value - a) / (b - a);
+    }
+
+    // Maps value from [inMin, inMax] onto [outMin, outMax], extrapolating outside the range.
+    template<FiniteFloat T>
+    constexpr T
+    Remap(const T inMin, const T inMax, const T outMin, const T outMax, const T value) noexcept {
+        return Lerp(outMin, outMax, InverseLerp(inMin, inMax, value));
+    }
+
+    // Hermite ease between edge0 and edge1, matching GLSL smoothstep.
+    template<FiniteFloat T>
+    constexpr T SmoothStep(const T edge0, const T edge1, const T value) noexcept {
+        const T x = Clamp01(InverseLerp(edge0, edge1, value));
+        return x * x * (T(3) - T(2) * x);
+    }
+
+    // Branch-free Lerp that stays in T. Exact at t == 0 and t == 1, and a single rounding per
+    // step when the target has FMA.
+    template<FiniteFloat T>
+    T LerpFast(const T a, const T b, const T t) noexcept {
+        // MSVC defines no __FMA__, but its /arch:AVX2 implies FMA. GCC and Clang can target AVX2
+        // without FMA, where std::fma would be a libm call.
+#if defined(__FMA__) || defined(__ARM_FEATURE_FMA) || (defined(_MSC_VER) && defined(__AVX2__))
+        return std::fma(t, b, std::fma(-t, a, a));
+#else
+        return t * b + (a - t * a);
+#endif
+    }
+
+    namespace Detail {
+        template<class T>
+        using LerpKernel = void (*)(const T*, const T*, const T*, T*, size_t);
+
+        template<class T>
+        void LerpScalar(const T* a, const T* b, const T* t, T* out, const size_t count) {
+            for (size_t i = 0; i < count; ++i) {
+                out[i] = LerpFast(a[i], b[i], t[i]);
+            }
+        }
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+        // SSE2 has no FMA; the tail uses the same unfused formula so every lane agrees.
+        inline void LerpSse2(const f32* a, const f32* b, const f32* t, f32* out, size_t count) {
+            size_t i = 0;
+            for (; i + 4 <= count; i += 4) {
+                const __m128 va = _mm_loadu_ps(a + i);
+                const __m128 vt = _mm_loadu_ps(t + i);
+                const __m128 vb = _mm_loadu_ps(b + i);
+                const __m128 r =
+                  _mm_add_ps(_mm_mul_ps(vt, vb), _mm_sub_ps(va, _mm_mul_ps(vt, va)));
+                _mm_storeu_ps(out + i, r);
+            }
+
+            for (; i < count; ++i) {
+                out[i] = t[i] * b[i] + (a[i] - t[i] * a[i]);
+            }
+        }
+
+        inline void LerpSse2(const f64* a, const f64* b, const f64* t, f64* out, size_t count) {
+            size_t i = 0;
+            for (; i + 2 <= count; i += 2) {
+                const __m128d va = _mm_loadu_pd(a + i);
+                const __m128d vt = _mm_loadu_pd(t + i);
+                const __m128d vb = _mm_loadu_pd(b + i);
+                const __m128d r =
+                  _mm_add_pd(_mm_mul_pd(vt, vb), _mm_sub_pd(va, _mm_mul_pd(vt, va)));
+                _mm_storeu_pd(out + i, r);
+            }
+
+            for (; i < count; ++i) {
+                out[i] = t[i] * b[i] + (a[i] - t[i] * a[i]);
+            }
+        }
+
+        RIEGER_TARGET("avx2,fma")
+        inline void LerpAvx2(const f32* a, const f32* b, const f32* t, f32* out, size_t count) {
+            size_t i = 0;
+            for (; i + 8 <= count; i += 8) {
+                const __m256 va = _mm256_loadu_ps(a + i);
+                const __m256 vt = _mm256_loadu_ps(t + i);
+                const __m256 r =
+                  _mm256_fmadd_ps(vt, _mm256_loadu_ps(b + i), _mm256_fnmadd_ps(vt, va, va));
+                _mm256_storeu_ps(out + i, r);
+            }
+
+            for (; i < count; ++i) {
+                const __m128 va = _mm_set_ss(a[i]);
+                const __m128 vt = _mm_set_ss(t[i]);
+                const __m128 r  = _mm_fmadd_ss(vt, _mm_set_ss(b[i]), _mm_fnmadd_ss(vt, va, va));
+                out[i]          = _mm_cvtss_f32(r);
+            }
+        }
+
+        RIEGER_TARGET("avx2,fma")
+        inline void LerpAvx2(const f64* a, const f64* b, const f64* t, f64* out, size_t count) {
+            size_t i = 0;
+            for (; i + 4 <= count; i += 4) {
+                const __m256d va = _mm256_loadu_pd(a + i);
+                const __m256d vt = _mm256_loadu_pd(t + i);
+                const __m256d r =
+                  _mm256_fmadd_pd(vt, _mm256_loadu_pd(b + i), _mm256_fnmadd_pd(vt, va, va));
+                _mm256_storeu_pd(out + i, r);
+            }
+
+            for (; i < count; ++i) {
+                const __m128d va = _mm_set_sd(a[i]);
+                const __m128d vt = _mm_set_sd(t[i]);
+                const __m128d r  = _mm_fmadd_sd(vt, _mm_set_sd(b[i]), _mm_fnmadd_sd(vt, va, va));
+                out[i]           = _mm_cvtsd_f64(r);
+            }
+        }
+
+        // The tail is a masked pass of the main loop.
+        RIEGER_TARGET("avx512f")
+        inline void LerpAvx512(const f32* a, const f32* b, const f32* t, f32* out, size_t count) {
+            for (size_t i = 0; i < count; i += 16) {
+                const __mmask16 mask =
+                  count - i >= 16 ? __mmask16(0xFFFF) : CAST<__mmask16>((1u << (count - i)) - 1);
+                const __m512 va = _mm512_maskz_loadu_ps(mask, a + i);
+                const __m512 vt = _mm512_maskz_loadu_ps(mask, t + i);
+                const __m512 vb = _mm512_maskz_loadu_ps(mask, b + i);
+                _mm512_mask_storeu_ps(
+                  out + i, mask, _mm512_fmadd_ps(vt, vb, _mm512_fnmadd_ps(vt, va, va)));
+            }
+        }
+
+        RIEGER_TARGET("avx512f")
+        inline void LerpAvx512(const f64* a, const f64* b, const f64* t, f64* out, size_t count) {
+            for (size_t i = 0; i < count; i += 8) {
+                const __mmask8 mask =
+                  count - i >= 8 ? __mmask8(0xFF) : CAST<__mmask8>((1u << (count - i)) - 1);
+                const __m512d va = _mm512_maskz_loadu_pd(mask, a + i);
+                const __m512d vt = _mm512_maskz_loadu_pd(mask, t + i);
+                const __m512d vb = _mm512_maskz_loadu_pd(mask, b + i);
+                _mm512_mask_storeu_pd(
+                  out + i, mask, _mm512_fmadd_pd(vt, vb, _mm512_fnmadd_pd(vt, va, va)));
+            }
+        }
+#elif defined(__aarch64__) || defined(_M_ARM64)
+        inline void LerpNeon(const f32* a, const f32* b, const f32* t, f32* out, size_t count) {
+            size_t i = 0;
+            for (; i + 4 <= count; i += 4) {
+                const float32x4_t va = vld1q_f32(a + i);
+                const float32x4_t vt = vld1q_f32(t + i);
+                vst1q_f32(out + i, vfmaq_f32(vfmsq_f32(va, vt, va), vt, vld1q_f32(b + i)));
+            }
+
+            for (; i < count; ++i) {
+                out[i] = std::fma(t[i], b[i], std::fma(-t[i], a[i], a[i]));
+            }
+        }
+
+        inline void LerpNeon(const f64* a, const f64* b, const f64* t, f64* out, size_t count) {
+            size_t i = 0;
+            for (; i + 2 <= count; i += 2) {
+                const float64x2_t va = vld1q_f64(a + i);
+                const float64x2_t vt = vld1q_f64(t + i);
+                vst1q_f64(out + i, vfmaq_f64(vfmsq_f64(va, vt, va), vt, vld1q_f64(b + i)));
+            }
+
+            for (; i < count; ++i) {
+                out[i] = std::fma(t[i], b[i], std::fma(-t[i], a[i], a[i]));
+            }
+        }
+#endif
+
+        template<class T>
+        LerpKernel<T> SelectLerpKernel() noexcept {
+            if constexpr (std::is_same_v<T, f32> || std::is_same_v<T, f64>) {
+                switch (Cpu::ActiveSimd()) {
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+                    case Cpu::SimdLevel::Avx512:
+                        return LerpAvx512;
+                    case Cpu::SimdLevel::Avx2:
+                        return LerpAvx2;
+                    case Cpu::SimdLevel::Sse2:
+                        return LerpSse2;
+#elif defined(__aarch64__) || defined(_M_ARM64)
+                    case Cpu::SimdLevel::Neon:
+                        return LerpNeon;
+#endif
+                    default:
+                        break;
+                }
+            }
+
+            return LerpScalar<T>;
+        }
+    }  // namespace Detail
+
+    // out[i] = Lerp(a[i], b[i], t[i]) for the first out.size() elements; a, b and t must be at
+    // least that long and may alias out. The widest kernel the CPU supports is chosen on first
+    // use. Results match LerpFast up to FMA contraction, which varies between kernels.
+    template<FiniteFloat T>
+    void LerpBatch(std::span<const T> a,
+                   std::span<const T> b,
+                   std::span<const T> t,
+                   std::span<T> out) {
+        static const Detail::LerpKernel<T> kernel = Detail::SelectLerpKernel<T>();
+        const size_t count = std::min({out.size(), a.size(), b.size(), t.size()});
+        kernel(a.data(), b.data(), t.data(), out.data(), count);
+    }
+    // Small vector types. Vec3 and Vec4 are padded/aligned to a full SIMD register and Mat4 to a
+    // cache line; Mat4 is column-major. The f32 Dot, Cross, Normalize and Mat4 products use
+    // SSE or NEON at runtime and fall back to the scalar definitions in constant evaluation.
+    template<FiniteFloat T>
+    struct Vec2 {
+        T x = 0;
+        T y = 0;
+
+        constexpr T& operator[](const size_t index) noexcept {
+            return index == 0 ? x : y;
+        }
+
+        constexpr T operator[](const size_t index) const noexcept {
+            return index == 0 ? x : y;
+        }
+
+        friend constexpr bool operator==(const Vec2&, const Vec2&) = default;
+    };
+
+    template<FiniteFloat T>
+    struct alignas(4 * sizeof(T)) Vec3 {
+        T x = 0;
+        T y = 0;
+        T z = 0;
+
+        constexpr T& operator[](const size_t index) noexcept {
+            return index == 0 ? x : (index == 1 ? y : z);
+        }
+
+        constexpr T operator[](const size_t index) const noexcept {
+            return index == 0 ? x : (index == 1 ? y : z);
+        }
+
+        friend constexpr bool operator==(const Vec3&, const Vec3&) = default;
+    };
+
+    template<FiniteFloat T>
+    struct alignas(4 * sizeof(T)) Vec4 {
+        T x = 0;
+        T y = 0;
+        T z = 0;
+        T w = 0;
+
+        constexpr T& operator[](const size_t index) noexcept {
+            return index == 0 ? x : (index == 1 ? y : (index == 2 ? z : w));
+        }
+
+        constexpr T operator[](const size_t index) const noexcept {
+            return index == 0 ? x : (index == 1 ? y : (index == 2 ? z : w));
+        }
+
+        friend constexpr bool operator==(const Vec4&, const Vec4&) = default;
+    };
+
+    namespace Detail {
+        template<class V>
+        using ScalarOf = std::remove_cvref_t<decltype(std::declval<V>().x)>;
+
+        template<FiniteFloat T, class F>
+        constexpr Vec2<T> Apply(const Vec2<T>& a, const Vec2<T>& b, F op) noexcept {
+            return {op(a.x, b.x), op(a.y, b.y)};
+        }
+
+        template<FiniteFloat T, class F>
+        constexpr Vec3<T> Apply(const Vec3<T>& a, const Vec3<T>& b, F op) noexcept {
+            return {op(a.x, b.x), op(a.y, b.y), op(a.z, b.z)};
+        }
+
+        template<FiniteFloat T, class F>
+        constexpr Vec4<T> Apply(const Vec4<T>& a, const Vec4<T>& b, F op) noexcept {
+            return {op(a.x, b.x), op(a.y, b.y), op(a.z, b.z), op(a.w, b.w)};
+        }
+
+        template<class V>
+        constexpr V Splat(const ScalarOf<V> value) noexcept {
+            if constexpr (std::same_as<V, Vec2<ScalarOf<V>>>) {
+                return {value, value};
+            } else if constexpr (std::same_as<V, Vec3<ScalarOf<V>>>) {
+                return {value, value, value};
+            } else {
+                return {value, value, value, value};
+            }
+        }
+
+        template<class V>
+        inline constexpr bool kIsVec = false;
+
+        template<FiniteFloat T>
+        inline constexpr bool kIsVec<Vec2<T>> = true;
+
+        template<FiniteFloat T>
+        inline constexpr bool kIsVec<Vec3<T>> = true;
+
+        template<FiniteFloat T>
+        inline constexpr bool kIsVec<Vec4<T>> = true;
+    }  // namespace Detail
+
+    template<class V>
+        requires Detail::kIsVec<V>
+    constexpr V operator+(const V& a, const V& b) noexcept {
+        return Detail::Apply(a, b, [](auto l, auto r) { return l + r; });
+    }
+
+    template<class V>
+        requires Detail::kIsVec<V>
+    constexpr V operator-(const V& a, const V& b) noexcept {
+        return Detail::Apply(a, b, [](auto l, auto r) { return l - r; });
+    }
+
+    // Component-wise.
+    template<class V>
+        requires Detail::kIsVec<V>
+    constexpr V operator*(const V& a, const V& b) noexcept {
+        return Detail::Apply(a, b, [](auto l, auto r) { return l * r; });
+    }
+
+    template<class V>
+        requires Detail::kIsVec<V>
+    constexpr V operator/(const V& a, const V& b) noexcept {
+        return Detail::Apply(a, b, [](auto l, auto r) { return l / r; });
+    }
+
+    template<class V>
+        requires Detail::kIsVec<V>
+    constexpr V operator*(const V& v, const Detail::ScalarOf<V> scale) noexcept {
+        return v * Detail::Splat<V>(scale);
+    }
+
+    template<class V>
+        requires Detail::kIsVec<V>
+    constexpr V operator*(const Detail::ScalarOf<V> scale, const V& v) noexcept {
+        return v * Detail::Splat<V>(scale);
+    }
+
+    template<class V>
+        requires Detail::kIsVec<V>
+    constexpr V operator/(const V& v, const Detail::ScalarOf<V> scale) noexcept {
+        return v / Detail::Splat<V>(scale);
+    }
+
+    template<class V>
+        requires Detail::kIsVec<V>
+    constexpr V operator-(const V& v) noexcept {
+        return Detail::Splat<V>(0) - v;
+    }
+
+    template<class V>
+        requires Detail::kIsVec<V>
+    constexpr V& operator+=(V& a, const V& b) noexcept {
+        return a = a + b;
+    }
+
+    template<class V>
+        requires Detail::kIsVec<V>
+    constexpr V& operator-=(V& a, const V& b) noexcept {
+        return a = a - b;
+    }
+
+    template<class V>
+        requires Detail::kIsVec<V>
+    constexpr V& operator*=(V& a, const Detail::ScalarOf<V> scale) noexcept {
+        return a = a * scale;
+    }
+
+    namespace Detail {
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+        inline __m128 Load(const Vec3<f32>& v) noexcept {
+            return _mm_set_ps(0.0f, v.z, v.y, v.x);
+        }
+
+        inline __m128 Load(const Vec4<f32>& v) noexcept {
+            return _mm_load_ps(&v.x);
+        }
+
+        template<class V>
+        V Store(const __m128 value) noexcept {
+            alignas(16) f32 lanes[4];
+            _mm_store_ps(lanes, value);
+            if constexpr (std::same_as<V, Vec3<f32>>) {
+                return {lanes[0], lanes[1], lanes[2]};
+            } else {
+                return {lanes[0], lanes[1], lanes[2], lanes[3]};
+            }
+        }
+
+        // Every lane ends up holding the sum of the four.
+        inline __m128 HorizontalSum(const __m128 value) noexcept {
+            const __m128 swapped = _mm_add_ps(value, _mm_shuffle_ps(value, value, 0xB1));
+            return _mm_add_ps(swapped, _mm_shuffle_ps(swapped, swapped, 0x4E));
+        }
+
+        inline void MultiplyMat4(const f32* a, const f32* b, f32* out) noexcept {
+            const __m128 c0 = _mm_load_ps(a);
+            const __m128 c1 = _mm_load_ps(a + 4);
+            const __m128 c2 = _mm_load_ps(a + 8);
+            const __m128 c3 = _mm_load_ps(a + 12);
+            for (size_t column = 0; column < 4; ++column) {
+                const f32* source = b + column * 4;
+                __m128 sum        = _mm_mul_ps(c0, _mm_set1_ps(source[0]));
+                sum               = _mm_add_ps(sum, _mm_mul_ps(c1, _mm_set1_ps(source[1])));
+                sum               = _mm_add_ps(sum, _mm_mul_ps(c2, _mm_set1_ps(source[2])));
+                sum               = _mm_add_ps(sum, _mm_mul_ps(c3, _mm_set1_ps(source[3])));
+                _mm_store_ps(out + column * 4, sum);
+            }
+        }
+#elif defined(__aarch64__) || defined(_M_ARM64)
+        inline float32x4_t Load(const Vec3<f32>& v) noexcept {
+            const f32 lanes[4] = {v.x, v.y, v.z, 0.0f};
+            return vld1q_f32(lanes);
+        }
+
+        inline float32x4_t Load(const Vec4<f32>& v) noexcept {
+            return vld1q_f32(&v.x);
+        }
+
+        template<class V>
+        V Store(const float32x4_t value) noexcept {
+            alignas(16) f32 lanes[4];
+            vst1q_f32(lanes, value);
+            if constexpr (std::same_as<V, Vec3<f32>>) {
+                return {lanes[0], lanes[1], lanes[2]};
+            } else {
+                return {lanes[0], lanes[1], lanes[2], lanes[3]};
+            }
+        }
+
+        inline void MultiplyMat4(const f32* a, const f32* b, f32* out) noexcept {
+            const float32x4_t c0 = vld1q_f32(a);
+            const float32x4_t c1 = vld1q_f32(a + 4);
+            const float32x4_t c2 = vld1q_f32(a + 8);
+            const float32x4_t c3 = vld1q_f32(a + 12);
+            for (size_t column = 0; column < 4; ++column) {
+                const float32x4_t source = vld1q_f32(b + column * 4);
+                float32x4_t sum          = vmulq_laneq_f32(c0, source, 0);
+                sum                      = vfmaq_laneq_f32(sum, c1, source, 1);
+                sum                      = vfmaq_laneq_f32(sum, c2, source, 2);
+                sum                      = vfmaq_laneq_f32(sum, c3, source, 3);
+                vst1q_f32(out + column * 4, sum);
+            }
+        }
+#endif
+
+        template<class V>
+        constexpr bool UseSimd() noexcept {
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || defined(__aarch64__) ||          \
+  defined(_M_ARM64)
+            return (std::same_as<V, Vec3<f32>> || std::same_as<V, Vec4<f32>>);
+#else
+            return false;
+#endif
+        }
+    }  // namespace Detail
+
+    template<FiniteFloat T>
+    constexpr T Dot(const Vec2<T>& a, const Vec2<T>& b) noexcept {
+        return a.x * b.x + a.y * b.y;
+    }
+
+    template<class V>
+        requires(std::same_as<V, Vec3<Detail::ScalarOf<V>>> ||
+                 std::same_as<V, Vec4<Detail::ScalarOf<V>>>)
+    constexpr Detail::ScalarOf<V> Dot(const V& a, const V& b) noexcept {
+        if constexpr (Detail::UseSimd<V>()) {
+            if (!std::is_constant_evaluated()) {
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+                const __m128 product = _mm_mul_ps(Detail::Load(a), Detail::Load(b));
+                return _mm_cvtss_f32(Detail::HorizontalSum(product));
+#elif defined(__aarch64__) || defined(_M_ARM64)
+                return vaddvq_f32(vmulq_f32(Detail::Load(a), Detail::Load(b)));
+#endif
+            }
+        }
+
+        const V product = a * b;
+        if constexpr (std::same_as<V, Vec3<Detail::ScalarOf<V>>>) {
+            return product.x + product.y + product.z;
+        } else {
+            return product.x + product.y + product.z + product.w;
+        }
+    }
+
+    template<FiniteFloat T>
+    constexpr Vec3<T> Cross(const Vec3<T>& a, const Vec3<T>& b) noexcept {
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+        if constexpr (std::same_as<T, f32>) {
+            if (!std::is_constant_evaluated()) {
+                // a * b.yzx - a.yzx * b yields the result rotated to zxy.
+                const __m128 va    = Detail::Load(a);
+                const __m128 vb    = Detail::Load(b);
+                const __m128 aYzx  = _mm_shuffle_ps(va, va, _MM_SHUFFLE(3, 0, 2, 1));
+                const __m128 bYzx  = _mm_shuffle_ps(vb, vb, _MM_SHUFFLE(3, 0, 2, 1));
+                const __m128 mixed = _mm_sub_ps(_mm_mul_ps(va, bYzx), _mm_mul_ps(aYzx, vb));
+                const __m128 cross = _mm_shuffle_ps(mixed, mixed, _MM_SHUFFLE(3, 0, 2, 1));
+                return Detail::Store<Vec3<f32>>(cross);
+            }
+        }
+#endif
+        return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+    }
+
+    template<class V>
+        requires Detail::kIsVec<V>
+    constexpr auto LengthSquared(const V& v) noexcept {
+        return Dot(v, v);
+    }
+
+    template<class V>
+        requires Detail::kIsVec<V>
+    auto Length(const V& v) noexcept {
+        return std::sqrt(LengthSquared(v));
+    }
+
+    // Unit vector in the direction of v; a zero vector is returned unchanged.
+    template<class V>
+        requires Detail::kIsVec<V>
+    V Normalize(const V& v) noexcept {
+        if constexpr (Detail::UseSimd<V>()) {
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+            const __m128 value   = Detail::Load(v);
+            const __m128 squared = Detail::HorizontalSum(_mm_mul_ps(value, value));
+            if (_mm_cvtss_f32(squared) == 0.0f) {
+                return v;
+            }
+
+            return Detail::Store<V>(_mm_div_ps(value, _mm_sqrt_ps(squared)));
+#elif defined(__aarch64__) || defined(_M_ARM64)
+            const float32x4_t value = Detail::Load(v);
+            const f32 squared       = vaddvq_f32(vmulq_f32(value, value));
+            if (squared == 0.0f) {
+                return v;
+            }
+
+            return Detail::Store<V>(vdivq_f32(value, vdupq_n_f32(std::sqrt(squared))));
+#endif
+        } else {
+            const auto length = Length(v);
+            return length == 0 ? v : v / length;
+        }
+    }
+
+    template<class V>
+        requires Detail::kIsVec<V>
+    constexpr V Lerp(const V& a, const V& b, const Detail::ScalarOf<V> t) noexcept {
+        return Detail::Apply(a, b, [t](auto l, auto r) { return Lerp(l, r, t); });
+    }
+
+    template<FiniteFloat T>
+    struct alignas(std::max<size_t>(64, 16 * sizeof(T))) Mat4 {
+        Vec4<T> columns[4] {};
+
+        static constexpr Mat4 Identity() noexcept {
+            return Scale({1, 1, 1});
+        }
+
+        static constexpr Mat4 Translation(const Vec3<T>& offset) noexcept {
+            Mat4 result       = Identity();
+            result.columns[3] = {offset.x, offset.y, offset.z, 1};
+            return result;
+        }
+
+        static constexpr Mat4 Scale(const Vec3<T>& factors) noexcept {
+            Mat4 result;
+            result.columns[0].x = factors.x;
+            result.columns[1].y = factors.y;
+            result.columns[2].z = factors.z;
+            result.columns[3].w = 1;
+            return result;
+        }
+
+        constexpr T& operator()(const size_t row, const size_t column) noexcept {
+            return columns[column][row];
+        }
+
+        constexpr T operator()(const size_t row, const size_t column) const noexcept {
+            return columns[column][row];
+        }
+
+        friend constexpr bool operator==(const Mat4&, const Mat4&) = default;
+    };
+
+    template<FiniteFloat T>
+    constexpr Mat4<T> Transpose(const Mat4<T>& m) noexcept {
+        Mat4<T> result;
+        for (size_t row = 0; row < 4; ++row) {
+            for (size_t column = 0; column < 4; ++column) {
+                result(column, row) = m(row, column);
+            }
+        }
+
+        return result;
+    }
+
+    template<FiniteFloat T>
+    constexpr Vec4<T> operator*(const Mat4<T>& m, const Vec4<T>& v) noexcept {
+        return m.columns[0] * v.x + m.columns[1] * v.y + m.columns[2] * v.z + m.columns[3] * v.w;
+    }
+
+    template<FiniteFloat T>
+    constexpr Mat4<T> operator*(const Mat4<T>& a, const Mat4<T>& b) noexcept {
+        Mat4<T> result;
+        if constexpr (Detail::UseSimd<Vec4<T>>()) {
+            if (!std::is_constant_evaluated()) {
+                Detail::MultiplyMat4(&a.columns[0].x, &b.columns[0].x, &result.columns[0].x);
+                return result;
+            }
+        }
+
+        for (size_t column = 0; column < 4; ++column) {
+            result.columns[column] = a * b.columns[column];
+        }
+
+        return result;
+    }
+
+    // Applies m to a point (w = 1) without the projective divide.
+    template<FiniteFloat T>
+    constexpr Vec3<T> TransformPoint(const Mat4<T>& m, const Vec3<T>& p) noexcept {
+        const Vec4<T> result = m * Vec4<T> {p.x, p.y, p.z, 1};
+        return {result.x, result.y, result.z};
+    }
+
+    // Structure-of-arrays point storage, so a batch transform loads a full register of x, y or z
+    // at a time.
+    template<FiniteFloat T>
+    struct Vec3SoA {
+        Vector<T> x;
+        Vector<T> y;
+        Vector<T> z;
+
+        [[nodiscard]] size_t Size() const noexcept {
+            return x.size();
+        }
+
+        void Resize(const size_t count) {
+            x.resize(count);
+            y.resize(count);
+            z.resize(count);
+        }
+
+        void Reserve(const size_t count) {
+            x.reserve(count);
+            y.reserve(count);
+            z.reserve(count);
+        }
+
+        void Push(const Vec3<T>& point) {
+            x.push_back(point.x);
+            y.push_back(point.y);
+            z.push_back(point.z);
+        }
+
+        [[nodiscard]] Vec3<T> Get(const size_t index) const noexcept {
+            return {x[index], y[index], z[index]};
+        }
+
+        void Set(const size_t index, const Vec3<T>& point) noexcept {
+            x[index] = point.x;
+            y[index] = point.y;
+            z[index] = point.z;
+        }
+    };
+
+    namespace Detail {
+        // The top three rows of m, row-major, so each output coordinate reads one row.
+        template<FiniteFloat T>
+        struct AffineRows {
+            T rows[3][4];
+
+            explicit AffineRows(const Mat4<T>& m) noexcept {
+                for (size_t row = 0; row < 3; ++row) {
+                    for (size_t column = 0; column < 4; ++column) {
+                        rows[row][column] = m(row, column);
+                    }
+                }
+            }
+        };
+
+        template<FiniteFloat T>
+        using TransformKernel =
+          void (*)(const AffineRows<T>&, const T*, const T*, const T*, T*, T*, T*, size_t, size_t);
+
+        template<FiniteFloat T>
+        void TransformScalar(const AffineRows<T>& m,
+                             const T* x,
+                             const T* y,
+                             const T* z,
+                             T* outX,
+                             T* outY,
+                             T* outZ,
+                             const size_t begin,
+                             const size_t end) {
+            const auto& [r0, r1, r2] = m.rows;
+            for (size_t i = begin; i < end; ++i) {
+                const T px = x[i];
+                const T py = y[i];
+                const T pz = z[i];
+                outX[i]    = r0[0] * px + r0[1] * py + r0[2] * pz + r0[3];
+                outY[i]    = r1[0] * px + r1[1] * py + r1[2] * pz + r1[3];
+                outZ[i]    = r2[0] * px + r2[1] * py + r2[2] * pz + r2[3];
+            }
+        }
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+        inline void TransformSse2(const AffineRows<f32>& m,
+                                  const f32* x,
+                                  const f32* y,
+                                  const f32* z,
+                                  f32* outX,
+                                  f32* outY,
+                                  f32* outZ,
+                                  const size_t begin,
+                                  const size_t end) {
+            size_t i = begin;
+            for (; i + 4 <= end; i += 4) {
+                const __m128 px = _mm_loadu_ps(x + i);
+                const __m128 py = _mm_loadu_ps(y + i);
+                const __m128 pz = _mm_loadu_ps(z + i);
+                f32* outputs[3] = {outX, outY, outZ};
+                for (size_t row = 0; row < 3; ++row) {
+                    const f32* r = m.rows[row];
+                    __m128 sum   = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(r[0]), px), _mm_set1_ps(r[3]));
+                    sum          = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(r[1]), py));
+                    sum          = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(r[2]), pz));
+                    _mm_storeu_ps(outputs[row] + i, sum);
+                }
+            }
+
+            TransformScalar(m, x, y, z, outX, outY, outZ, i, end);
+        }
+
+        RIEGER_TARGET("avx2,fma")
+        inline void TransformAvx2(const AffineRows<f32>& m,
+                                  const f32* x,
+                                  const f32* y,
+                                  const f32* z,
+                                  f32* outX,
+                                  f32* outY,
+                                  f32* outZ,
+                                  const size_t begin,
+                                  const size_t end) {
+            size_t i = begin;
+            for (; i + 8 <= end; i += 8) {
+                const __m256 px = _mm256_loadu_ps(x + i);
+                const __m256 py = _mm256_loadu_ps(y + i);
+                const __m256 pz = _mm256_loadu_ps(z + i);
+                f32* outputs[3] = {outX, outY, outZ};
+                for (size_t row = 0; row < 3; ++row) {
+                    const f32* r = m.rows[row];
+                    __m256 sum   = _mm256_fmadd_ps(_mm256_set1_ps(r[0]), px, _mm256_set1_ps(r[3]));
+                    sum          = _mm256_fmadd_ps(_mm256_set1_ps(r[1]), py, sum);
+                    sum          = _mm256_fmadd_ps(_mm256_set1_ps(r[2]), pz, sum);
+                    _mm256_storeu_ps(outputs[row] + i, sum);
+                }
+            }
+
+            TransformSse2(m, x, y, z, outX, outY, outZ, i, end);
+        }
+
+        RIEGER_TARGET("avx512f")
+        inline void TransformAvx512(const AffineRows<f32>& m,
+                                    const f32* x,
+                                    const f32* y,
+                                    const f32* z,
+                                    f32* outX,
+                                    f32* outY,
+                                    f32* outZ,
+                                    const size_t begin,
+                                    const size_t end) {
+            size_t i = begin;
+            for (; i + 16 <= end; i += 16) {
+                const __m512 px = _mm512_loadu_ps(x + i);
+                const __m512 py = _mm512_loadu_ps(y + i);
+                const __m512 pz = _mm512_loadu_ps(z + i);
+                f32* outputs[3] = {outX, outY, outZ};
+                for (size_t row = 0; row < 3; ++row) {
+                    const f32* r = m.rows[row];
+                    __m512 sum   = _mm512_fmadd_ps(_mm512_set1_ps(r[0]), px, _mm512_set1_ps(r[3]));
+                    sum          = _mm512_fmadd_ps(_mm512_set1_ps(r[1]), py, sum);
+                    sum          = _mm512_fmadd_ps(_mm512_set1_ps(r[2]), pz, sum);
+                    _mm512_storeu_ps(outputs[row] + i, sum);
+                }
+            }
+
+            TransformSse2(m, x, y, z, outX, outY, outZ, i, end);
+        }
+#elif defined(__aarch64__) || defined(_M_ARM64)
+        inline void TransformNeon(const AffineRows<f32>& m,
+                                  const f32* x,
+                                  const f32* y,
+                                  const f32* z,
+                                  f32* outX,
+                                  f32* outY,
+                                  f32* outZ,
+                                  const size_t begin,
+                                  const size_t end) {
+            size_t i = begin;
+            for (; i + 4 <= end; i += 4) {
+                const float32x4_t px = vld1q_f32(x + i);
+                const float32x4_t py = vld1q_f32(y + i);
+                const float32x4_t pz = vld1q_f32(z + i);
+                f32* outputs[3]      = {outX, outY, outZ};
+                for (size_t row = 0; row < 3; ++row) {
+                    const f32* r    = m.rows[row];
+                    float32x4_t sum = vfmaq_n_f32(vdupq_n_f32(r[3]), px, r[0]);
+                    sum             = vfmaq_n_f32(sum, py, r[1]);
+                    sum             = vfmaq_n_f32(sum, pz, r[2]);
+                    vst1q_f32(outputs[row] + i, sum);
+                }
+            }
+
+            TransformScalar(m, x, y, z, outX, outY, outZ, i, end);
+        }
+#endif
+
+        template<FiniteFloat T>
+        TransformKernel<T> SelectTransformKernel() noexcept {
+            if constexpr (std::is_same_v<T, f32>) {
+                switch (Cpu::ActiveSimd()) {
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+                    case Cpu::SimdLevel::Avx512:
+                        return TransformAvx512;
+                    case Cpu::SimdLevel::Avx2:
+                        return TransformAvx2;
+                    case Cpu::SimdLevel::Sse2:
+                        return TransformSse2;
+#elif defined(__aarch64__) || defined(_M_ARM64)
+                    case Cpu::SimdLevel::Neon:
+                        return TransformNeon;
+#endif
+                    default:
+                        break;
+                }
+            }
+
+            return TransformScalar<T>;
+        }
+    }  // namespace Detail
+
+    // Applies TransformPoint(m, p) to every point; out is resized to match and may be points.
+    template<FiniteFloat T>
+    void TransformPoints(const Mat4<T>& m, const Vec3SoA<T>& points, Vec3SoA<T>& out) {
+        static const Detail::TransformKernel<T> kernel = Detail::SelectTransformKernel<T>();
+        out.Resize(points.Size());
+        kernel(Detail::AffineRows<T>(m),
+               points.x.data(),
+               points.y.data(),
+               points.z.data(),
+               out.x.data(),
+               out.y.data(),
+               out.z.data(),
+               0,
+               points.Size());
+    }
+}  // namespace Math
+
+namespace Color {
+    namespace Detail {
+        // byte / 255 rounded once to f32, the value HexToRGBA used to compute with a divide.
+        inline constexpr std::array<f32, 256> kByteToFloat = [] {
+            std::array<f32, 256> table {};
+            for (size_t i = 0; i < table.size(); ++i) {
+                table[i] = CAST<f32>(CAST<f64>(i) / 255.0);
+            }
+
+            return table;
+        }();
+
+        // Saturating, round-half-up conversion of a [0, 1] channel; NaN maps to 0. The
+        // max/min order is what makes NaN collapse to 0 and lets it compile to maxss/minss.
+        inline u32 ChannelToByte(const f32 value) noexcept {
+            const f32 clamped = std::min(std::max(0.0f, value * 255.0f), 255.0f);
+            return CAST<u32>(clamped + 0.5f);
+        }
+    }  // namespace Detail
+
+    // Which space the f32 channels are in. Hex colors are always sRGB-encoded; Linear decodes
+    // red, green and blue on the way to floats and encodes them on the way back. Alpha is
+    // linear either way.
+    enum class ColorSpace { SRGB, Linear };
+
+    namespace Detail {
+        // Minimax fits for the curved segment of each transfer function, taken in a fourth root
+        // so the power becomes smooth enough for a short polynomial.
+        // SRGBToLinear: y^2 * P(y^(1/4)) with y = (x + 0.055) / 1.055.
+        inline constexpr f32 kDecodeCoefficients[5] = {
+          -0.0204578048f, 0.298558627f, 0.908785003f, -0.231552174f, 0.0446679750f};
+        // LinearToSRGB: P(x^(1/4)).
+        inline constexpr f32 kEncodeCoefficients[6] = {
+          -0.0613402167f, 0.162026264f, 1.25540444f, -0.577482813f, 0.289533098f, -0.0681473420f};
+
+        inline f32 Saturate(const f32 value) noexcept {
+            return std::min(std::max(0.0f, value), 1.0f);
+        }
+
+        // Exact (std::pow) decode of every 8-bit sRGB value.
+        inline const std::array<f32, 256> kSRGBByteToLinear = [] {
+            std::array<f32, 256> table {};
+            for (size_t i = 0; i < table.size(); ++i) {
+                const f64 value = CAST<f64>(i) / 255.0;
+                const f64 decoded =
+                  value <= 0.04045 ? value / 12.92 : std::pow((value + 0.055) / 1.055, 2.4);
+                table[i] = CAST<f32>(decoded);
+            }
+
+            return table;
+        }();
+    }  // namespace Detail
+
+    // Polynomial approximation of the sRGB decode curve. Input is clamped to [0, 1] (NaN to 0);
+    // max relative error against std::pow is 2.1e-6.
+    inline f32 SRGBToLinear(const f32 value) noexcept {
+        const f32 x = Detail::Saturate(value);
+        if (x <= 0.04045f) {
+            return x * (1.0f / 12.92f);
+        }
+
+        const auto& c = Detail::kDecodeCoefficients;
+        const f32 y   = (x + 0.055f) * (1.0f / 1.055f);
+        const f32 u   = std::sqrt(std::sqrt(y));
+        return y * y * ((((c[4] * u + c[3]) * u + c[2]) * u + c[1]) * u + c[0]);
+    }
+
+    // Exact table lookup; only matches u8 arguments.
+    template<std::same_as<u8> Byte>
+    f32 SRGBToLinear(const Byte value) noexcept {
+        return Detail::kSRGBByteToLinear[value];
+    }
+
+    // Polynomial approximation of the sRGB encode curve. Input is clamped to [0, 1] (NaN to 0);
+    // max absolute error against std::pow is 7e-6, far below one 8-bit step.
+    inline f32 LinearToSRGB(const f32 value) noexcept {
+        const f32 x = Detail::Saturate(value);
+        if (x <= 0.0031308f) {
+            return x * 12.92f;
+        }
+
+        const auto& c = Detail::kEncodeCoefficients;
+        const f32 u   = std::sqrt(std::sqrt(x));
+        return ((((c[5] * u + c[4]) * u + c[3]) * u + c[2]) * u + c[1]) * u + c[0];
+    }
+
+    inline void HexToRGBA(const u32 hex,
+                          f32& r,
+                          f32& g,
+                          f32& b,
+                          f32& a,
+                          const ColorSpace space = ColorSpace::SRGB) {
+        const auto& table =
+          space == ColorSpace::Linear ? Detail::kSRGBByteToLinear : Detail::kByteToFloat;
+
+        a = Detail::kByteToFloat[(hex >> 24) & 0xFF];
+        r = table[(hex >> 16) & 0xFF];
+        g = table[(hex >> 8) & 0xFF];
+        b = table[hex & 0xFF];
+    }
+
+    inline void HexToRGBA(const u32 hex, u32& r, u32& g, u32& b, u32& a) {
+        const u8 alphaByte = (hex >> 24) & 0xFF;
+        const u8 redByte   = (hex >> 16) & 0xFF;
+        const u8 greenByte = (hex >> 8) & 0xFF;
+        const u8 blueByte  = hex & 0xFF;
+
+        a = CAST<u32>(alphaByte);
+        r = CAST<u32>(redByte);
+        g = CAST<u32>(greenByte);
+        b = CAST<u32>(blueByte);
+    }
+
+    // Channels are clamped to [0, 1] and rounded to nearest; NaN becomes 0.
+    inline u32 RGBAToHex(const f32 r,
+                         const f32 g,
+                         const f32 b,
+                         const f32 a,
+                         const ColorSpace space = ColorSpace::SRGB) {
+        const bool encode   = space == ColorSpace::Linear;
+        const u32 redByte   = Detail::ChannelToByte(encode ? LinearToSRGB(r) : r);
+        const u32 greenByte = Detail::ChannelToByte(encode ? LinearToSRGB(g) : g);
+        const u32 blueByte  = Detail::ChannelToByte(encode ? LinearToSRGB(b) : b);
+        const u32 alphaByte = Detail::ChannelToByte(a);
+
+        return (alphaByte << 24) | (redByte << 16) | (greenByte << 8) | blueByte;
+    }
+
+    // Channel order for float pixel buffers: Interleaved is r, g, b, a per pixel; Planar stores
+    // all reds, then all greens, blues and alphas, each plane one pixel count long.
+    enum class PixelLayout { Interleaved, Planar };
+
+    namespace Detail {
+        // The SIMD kernels divide rather than multiply by 1/255: that rounds once, to exactly
+        // kByteToFloat, so batch and per-pixel conversions agree bit for bit.
+        constexpr f32 kByteMax = 255.0f;
+
+        inline void HexToRGBAScalar(const u32* hex,
+                                    f32* out,
+                                    const size_t count,
+                                    const PixelLayout layout,
+                                    const size_t begin) {
+            for (size_t i = begin; i < count; ++i) {
+                const f32 channels[4] = {kByteToFloat[(hex[i] >> 16) & 0xFF],
+                                         kByteToFloat[(hex[i] >> 8) & 0xFF],
+                                         kByteToFloat[hex[i] & 0xFF],
+                                         kByteToFloat[hex[i] >> 24]};
+                for (size_t channel = 0; channel < 4; ++channel) {
+                    if (layout == PixelLayout::Interleaved) {
+                        out[i * 4 + channel] = channels[channel];
+                    } else {
+                        out[channel * count + i] = channels[channel];
+                    }
+                }
+            }
+        }
+
+        inline void RGBAToHexScalar(const f32* rgba,
+                                    u32* out,
+                                    const size_t count,
+                                    const PixelLayout layout,
+                                    const size_t begin) {
+            for (size_t i = begin; i < count; ++i) {
+                u32 channels[4];
+                for (size_t channel = 0; channel < 4; ++channel) {
+                    const size_t index = layout == PixelLayout::Interleaved ? i * 4 + channel
+                                                                            : channel * count + i;
+                    channels[channel]  = ChannelToByte(rgba[index]);
+                }
+
+                out[i] =
+                  (channels[3] << 24) | (channels[0] << 16) | (channels[1] << 8) | channels[2];
+            }
+        }
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+        inline void
+        HexToRGBASse2(const u32* hex, f32* out, const size_t count, const PixelLayout layout) {
+            const __m128i mask   = _mm_set1_epi32(0xFF);
+            const __m128 divisor = _mm_set1_ps(kByteMax);
+            size_t i             = 0;
+            for (; i + 4 <= count; i += 4) {
+                const __m128i pixels = _mm_loadu_si128(RCAST<const __m128i*>(hex + i));
+                __m128 r = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(pixels, 16), mask));
+                __m128 g = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(pixels, 8), mask));
+                __m128 b = _mm_cvtepi32_ps(_mm_and_si128(pixels, mask));
+                __m128 a = _mm_cvtepi32_ps(_mm_srli_epi32(pixels, 24));
+                r        = _mm_div_ps(r, divisor);
+                g        = _mm_div_ps(g, divisor);
+                b        = _mm_div_ps(b, divisor);
+                a        = _mm_div_ps(a, divisor);
+                if (layout == PixelLayout::Interleaved) {
+                    _MM_TRANSPOSE4_PS(r, g, b, a);
+                    _mm_storeu_ps(out + i * 4, r);
+                    _mm_storeu_ps(out + i * 4 + 4, g);
+                    _mm_storeu_ps(out + i * 4 + 8, b);
+                    _mm_storeu_ps(out + i * 4 + 12, a);
+                } else {
+                    _mm_storeu_ps(out + i, r);
+                    _mm_storeu_ps(out + count + i, g);
+                    _mm_storeu_ps(out + count * 2 + i, b);
+                    _mm_storeu_ps(out + count * 3 + i, a);
+                }
+            }
+
+            HexToRGBAScalar(hex, out, count, layout, i);
+        }
+
+        inline __m128i ChannelsToBytes(const __m128 values) noexcept {
+            const __m128 scaled  = _mm_mul_ps(values, _mm_set1_ps(255.0f));
+            const __m128 clamped =
+              _mm_min_ps(_mm_max_ps(scaled, _mm_setzero_ps()), _mm_set1_ps(255.0f));
+            return _mm_cvttps_epi32(_mm_add_ps(clamped, _mm_set1_ps(0.5f)));
+        }
+
+        inline void
+        RGBAToHexSse2(const f32* rgba, u32* out, const size_t count, const PixelLayout layout) {
+            size_t i = 0;
+            for (; i + 4 <= count; i += 4) {
+                __m128 r;
+                __m128 g;
+                __m128 b;
+                __m128 a;
+                if (layout == PixelLayout::Interleaved) {
+                    r = _mm_loadu_ps(rgba + i * 4);
+                    g = _mm_loadu_ps(rgba + i * 4 + 4);
+                    b = _mm_loadu_ps(rgba + i * 4 + 8);
+                    a = _mm_loadu_ps(rgba + i * 4 + 12);
+                    _MM_TRANSPOSE4_PS(r, g, b, a);
+                } else {
+                    r = _mm_loadu_ps(rgba + i);
+                    g = _mm_loadu_ps(rgba + count + i);
+                    b = _mm_loadu_ps(rgba + count * 2 + i);
+                    a = _mm_loadu_ps(rgba + count * 3 + i);
+                }
+
+                __m128i packed = _mm_slli_epi32(ChannelsToBytes(a), 24);
+                packed         = _mm_or_si128(packed, _mm_slli_epi32(ChannelsToBytes(r), 16));
+                packed         = _mm_or_si128(packed, _mm_slli_epi32(ChannelsToBytes(g), 8));
+                packed         = _mm_or_si128(packed, ChannelsToBytes(b));
+                _mm_storeu_si128(RCAST<__m128i*>(out + i), packed);
+            }
+
+            RGBAToHexScalar(rgba, out, count, layout, i);
+        }
+
+        // Swaps r and b inside each little-endian BGRA pixel, turning it into RGBA byte order.
+        RIEGER_TARGET("avx2")
+        inline __m256i SwapRedBlue(const __m256i pixels) noexcept {
+            const __m256i order = _mm256_setr_epi8(
+              2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+              2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+            return _mm256_shuffle_epi8(pixels, order);
+        }
+
+        RIEGER_TARGET("avx2")
+        inline void
+        HexToRGBAAvx2(const u32* hex, f32* out, const size_t count, const PixelLayout layout) {
+            const __m256i mask   = _mm256_set1_epi32(0xFF);
+            const __m256 divisor = _mm256_set1_ps(kByteMax);
+            size_t i             = 0;
+            for (; i + 8 <= count; i += 8) {
+                const __m256i pixels = _mm256_loadu_si256(RCAST<const __m256i*>(hex + i));
+                if (layout == PixelLayout::Interleaved) {
+                    // Widen two RGBA-ordered pixels (8 bytes) into 8 floats at a time.
+                    const __m256i ordered  = SwapRedBlue(pixels);
+                    const __m128i low      = _mm256_castsi256_si128(ordered);
+                    const __m128i high     = _mm256_extracti128_si256(ordered, 1);
+                    const __m128i pairs[4] = {
+                      low, _mm_srli_si128(low, 8), high, _mm_srli_si128(high, 8)};
+                    for (size_t pair = 0; pair < 4; ++pair) {
+                        const __m256 values = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(pairs[pair]));
+                        _mm256_storeu_ps(out + (i + pair * 2) * 4, _mm256_div_ps(values, divisor));
+                    }
+                } else {
+                    const __m256i channels[4] = {
+                      _mm256_and_si256(_mm256_srli_epi32(pixels, 16), mask),
+                      _mm256_and_si256(_mm256_srli_epi32(pixels, 8), mask),
+                      _mm256_and_si256(pixels, mask),
+                      _mm256_srli_epi32(pixels, 24),
+                    };
+                    for (size_t channel = 0; channel < 4; ++channel) {
+                        const __m256 values = _mm256_cvtepi32_ps(channels[channel]);
+                        _mm256_storeu_ps(out + channel * count + i, _mm256_div_ps(values, divisor));
+                    }
+                }
+            }
+
+            HexToRGBAScalar(hex, out, count, layout, i);
+        }
+
+        RIEGER_TARGET("avx2")
+        inline __m256i ChannelsToBytes(const __m256 values) noexcept {
+            const __m256 scaled  = _mm256_mul_ps(values, _mm256_set1_ps(255.0f));
+            const __m256 clamped =
+              _mm256_min_ps(_mm256_max_ps(scaled, _mm256_setzero_ps()), _mm256_set1_ps(255.0f));
+            return _mm256_cvttps_epi32(_mm256_add_ps(clamped, _mm256_set1_ps(0.5f)));
+        }
+
+        RIEGER_TARGET("avx2")
+        inline void
+        RGBAToHexAvx2(const f32* rgba, u32* out, const size_t count, const PixelLayout layout) {
+            size_t i = 0;
+            for (; i + 8 <= count; i += 8) {
+                __m256i packed;
+                if (layout == PixelLayout::Interleaved) {
+                    // The saturating packs work per 128-bit lane, leaving the pixels ordered
+                    // 0 2 4 6 | 1 3 5 7; the final permute restores 0..7.
+                    const f32* source = rgba + i * 4;
+                    const __m256i p01 = ChannelsToBytes(_mm256_loadu_ps(source));
+                    const __m256i p23 = ChannelsToBytes(_mm256_loadu_ps(source + 8));
+                    const __m256i p45 = ChannelsToBytes(_mm256_loadu_ps(source + 16));
+                    const __m256i p67 = ChannelsToBytes(_mm256_loadu_ps(source + 24));
+                    const __m256i bytes = _mm256_packus_epi16(_mm256_packus_epi32(p01, p23),
+                                                              _mm256_packus_epi32(p45, p67));
+                    packed = _mm256_permutevar8x32_epi32(SwapRedBlue(bytes),
+                                                         _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+                } else {
+                    const __m256i r = ChannelsToBytes(_mm256_loadu_ps(rgba + i));
+                    const __m256i g = ChannelsToBytes(_mm256_loadu_ps(rgba + count + i));
+                    const __m256i b = ChannelsToBytes(_mm256_loadu_ps(rgba + count * 2 + i));
+                    const __m256i a = ChannelsToBytes(_mm256_loadu_ps(rgba + count * 3 + i));
+                    packed = _mm256_or_si256(_mm256_slli_epi32(a, 24), _mm256_slli_epi32(r, 16));
+                    packed = _mm256_or_si256(packed, _mm256_slli_epi32(g, 8));
+                    packed = _mm256_or_si256(packed, b);
+                }
+
+                _mm256_storeu_si256(RCAST<__m256i*>(out + i), packed);
+            }
+
+            RGBAToHexScalar(rgba, out, count, layout, i);
+        }
+#elif defined(__aarch64__) || defined(_M_ARM64)
+        inline void
+        HexToRGBANeon(const u32* hex, f32* out, const size_t count, const PixelLayout layout) {
+            const uint32x4_t mask     = vdupq_n_u32(0xFF);
+            const float32x4_t divisor = vdupq_n_f32(kByteMax);
+            size_t i                  = 0;
+            for (; i + 4 <= count; i += 4) {
+                const uint32x4_t pixels = vld1q_u32(hex + i);
+                const uint32x4_t bytes[4] = {vandq_u32(vshrq_n_u32(pixels, 16), mask),
+                                             vandq_u32(vshrq_n_u32(pixels, 8), mask),
+                                             vandq_u32(pixels, mask),
+                                             vshrq_n_u32(pixels, 24)};
+                float32x4x4_t channels;
+                for (size_t channel = 0; channel < 4; ++channel) {
+                    channels.val[channel] = vdivq_f32(vcvtq_f32_u32(bytes[channel]), divisor);
+                }
+
+                if (layout == PixelLayout::Interleaved) {
+                    vst4q_f32(out + i * 4, channels);
+                } else {
+                    for (size_t channel = 0; channel < 4; ++channel) {
+                        vst1q_f32(out + channel * count + i, channels.val[channel]);
+                    }
+                }
+            }
+
+            HexToRGBAScalar(hex, out, count, layout, i);
+        }
+
+        inline uint32x4_t ChannelsToBytes(const float32x4_t values) noexcept {
+            const float32x4_t scaled = vmulq_n_f32(values, 255.0f);
+            const float32x4_t clamped =
+              vminq_f32(vmaxq_f32(scaled, vdupq_n_f32(0.0f)), vdupq_n_f32(255.0f));
+            return vcvtq_u32_f32(vaddq_f32(clamped, vdupq_n_f32(0.5f)));
+        }
+
+        inline void
+        RGBAToHexNeon(const f32* rgba, u32* out, const size_t count, const PixelLayout layout) {
+            size_t i = 0;
+            for (; i + 4 <= count; i += 4) {
+                float32x4x4_t channels;
+                if (layout == PixelLayout::Interleaved) {
+                    channels = vld4q_f32(rgba + i * 4);
+                } else {
+                    for (size_t channel = 0; channel < 4; ++channel) {
+                        channels.val[channel] = vld1q_f32(rgba + channel * count + i);
+                    }
+                }
+
+                const uint32x4_t r = ChannelsToBytes(channels.val[0]);
+                const uint32x4_t g = ChannelsToBytes(channels.val[1]);
+                const uint32x4_t b = ChannelsToBytes(channels.val[2]);
+                const uint32x4_t a = ChannelsToBytes(channels.val[3]);
+                uint32x4_t packed  = vorrq_u32(vshlq_n_u32(a, 24), vshlq_n_u32(r, 16));
+                packed             = vorrq_u32(packed, vorrq_u32(vshlq_n_u32(g, 8), b));
+                vst1q_u32(out + i, packed);
+            }
+
+            RGBAToHexScalar(rgba, out, count, layout, i);
+        }
+#endif
+    }  // namespace Detail
+
+    namespace Detail {
+        using TransferKernel = void (*)(const f32*, f32*, size_t);
+
+        constexpr f32 kInverse1055 = 1.0f / 1.055f;
+
+        inline void DecodeScalar(const f32* in, f32* out, const size_t count) {
+            for (size_t i = 0; i < count; ++i) {
+                out[i] = SRGBToLinear(in[i]);
+            }
+        }
+
+        inline void EncodeScalar(const f32* in, f32* out, const size_t count) {
+            for (size_t i = 0; i < count; ++i) {
+                out[i] = LinearToSRGB(in[i]);
+            }
+        }
+
+        // The SIMD kernels evaluate both segments and select per lane.
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+        inline __m128 Saturate(const __m128 value) noexcept {
+            return _mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+        }
+
+        inline __m128 Select(const __m128 mask, const __m128 yes, const __m128 no) noexcept {
+            return _mm_or_ps(_mm_and_ps(mask, yes), _mm_andnot_ps(mask, no));
+        }
+
+        inline void DecodeSse2(const f32* in, f32* out, const size_t count) {
+            const auto& c = kDecodeCoefficients;
+            size_t i      = 0;
+            for (; i + 4 <= count; i += 4) {
+                const __m128 x = Saturate(_mm_loadu_ps(in + i));
+                const __m128 y =
+                  _mm_mul_ps(_mm_add_ps(x, _mm_set1_ps(0.055f)), _mm_set1_ps(kInverse1055));
+                const __m128 u = _mm_sqrt_ps(_mm_sqrt_ps(y));
+                __m128 p       = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(c[4]), u), _mm_set1_ps(c[3]));
+                p              = _mm_add_ps(_mm_mul_ps(p, u), _mm_set1_ps(c[2]));
+                p              = _mm_add_ps(_mm_mul_ps(p, u), _mm_set1_ps(c[1]));
+                p              = _mm_add_ps(_mm_mul_ps(p, u), _mm_set1_ps(c[0]));
+                const __m128 curve  = _mm_mul_ps(_mm_mul_ps(y, y), p);
+                const __m128 linear = _mm_mul_ps(x, _mm_set1_ps(1.0f / 12.92f));
+                const __m128 low    = _mm_cmple_ps(x, _mm_set1_ps(0.04045f));
+                _mm_storeu_ps(out + i, Select(low, linear, curve));
+            }
+
+            DecodeScalar(in + i, out + i, count - i);
+        }
+
+        inline void EncodeSse2(const f32* in, f32* out, const size_t count) {
+            const auto& c = kEncodeCoefficients;
+            size_t i      = 0;
+            for (; i + 4 <= count; i += 4) {
+                const __m128 x = Saturate(_mm_loadu_ps(in + i));
+                const __m128 u = _mm_sqrt_ps(_mm_sqrt_ps(x));
+                __m128 p       = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(c[5]), u), _mm_set1_ps(c[4]));
+                p              = _mm_add_ps(_mm_mul_ps(p, u), _mm_set1_ps(c[3]));
+                p              = _mm_add_ps(_mm_mul_ps(p, u), _mm_set1_ps(c[2]));
+                p              = _mm_add_ps(_mm_mul_ps(p, u), _mm_set1_ps(c[1]));
+                p              = _mm_add_ps(_mm_mul_ps(p, u), _mm_set1_ps(c[0]));
+                const __m128 linear = _mm_mul_ps(x, _mm_set1_ps(12.92f));
+                const __m128 low    = _mm_cmple_ps(x, _mm_set1_ps(0.0031308f));
+                _mm_storeu_ps(out + i, Select(low, linear, p));
+            }
+
+            EncodeScalar(in + i, out + i, count - i);
+        }
+
+        RIEGER_TARGET("avx2,fma")
+        inline __m256 Saturate(const __m256 value) noexcept {
+            return _mm256_min_ps(_mm256_max_ps(value, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+        }
+
+        RIEGER_TARGET("avx2,fma")
+        inline void DecodeAvx2(const f32* in, f32* out, const size_t count) {
+            const auto& c = kDecodeCoefficients;
+            size_t i      = 0;
+            for (; i + 8 <= count; i += 8) {
+                const __m256 x = Saturate(_mm256_loadu_ps(in + i));
+                const __m256 y = _mm256_mul_ps(_mm256_add_ps(x, _mm256_set1_ps(0.055f)),
+                                               _mm256_set1_ps(kInverse1055));
+                const __m256 u = _mm256_sqrt_ps(_mm256_sqrt_ps(y));
+                __m256 p       = _mm256_fmadd_ps(_mm256_set1_ps(c[4]), u, _mm256_set1_ps(c[3]));
+                p              = _mm256_fmadd_ps(p, u, _mm256_set1_ps(c[2]));
+                p              = _mm256_fmadd_ps(p, u, _mm256_set1_ps(c[1]));
+                p              = _mm256_fmadd_ps(p, u, _mm256_set1_ps(c[0]));
+                const __m256 curve  = _mm256_mul_ps(_mm256_mul_ps(y, y), p);
+                const __m256 linear = _mm256_mul_ps(x, _mm256_set1_ps(1.0f / 12.92f));
+                const __m256 low    = _mm256_cmp_ps(x, _mm256_set1_ps(0.04045f), _CMP_LE_OQ);
+                _mm256_storeu_ps(out + i, _mm256_blendv_ps(curve, linear, low));
+            }
+
+            DecodeSse2(in + i, out + i, count - i);
+        }
+
+        RIEGER_TARGET("avx2,fma")
+        inline void EncodeAvx2(const f32* in, f32* out, const size_t count) {
+            const auto& c = kEncodeCoefficients;
+            size_t i      = 0;
+            for (; i + 8 <= count; i += 8) {
+                const __m256 x = Saturate(_mm256_loadu_ps(in + i));
+                const __m256 u = _mm256_sqrt_ps(_mm256_sqrt_ps(x));
+                __m256 p       = _mm256_fmadd_ps(_mm256_set1_ps(c[5]), u, _mm256_set1_ps(c[4]));
+                p              = _mm256_fmadd_ps(p, u, _mm256_set1_ps(c[3]));
+                p              = _mm256_fmadd_ps(p, u, _mm256_set1_ps(c[2]));
+                p              = _mm256_fmadd_ps(p, u, _mm256_set1_ps(c[1]));
+                p              = _mm256_fmadd_ps(p, u, _mm256_set1_ps(c[0]));
+                const __m256 linear = _mm256_mul_ps(x, _mm256_set1_ps(12.92f));
+                const __m256 low    = _mm256_cmp_ps(x, _mm256_set1_ps(0.0031308f), _CMP_LE_OQ);
+                _mm256_storeu_ps(out + i, _mm256_blendv_ps(p, linear, low));
+            }
+
+            EncodeSse2(in + i, out + i, count - i);
+        }
+#elif defined(__aarch64__) || defined(_M_ARM64)
+        // vmaxnm returns the number when one operand is NaN, so NaN becomes 0 as on x86.
+        inline float32x4_t Saturate(const float32x4_t value) noexcept {
+            return vminq_f32(vmaxnmq_f32(value, vdupq_n_f32(0.0f)), vdupq_n_f32(1.0f));
+        }
+
+        inline void DecodeNeon(const f32* in, f32* out, const size_t count) {
+            const auto& c = kDecodeCoefficients;
+            size_t i      = 0;
+            for (; i + 4 <= count; i += 4) {
+                const float32x4_t x = Saturate(vld1q_f32(in + i));
+                const float32x4_t y = vmulq_n_f32(vaddq_f32(x, vdupq_n_f32(0.055f)), kInverse1055);
+                const float32x4_t u = vsqrtq_f32(vsqrtq_f32(y));
+                float32x4_t p       = vfmaq_n_f32(vdupq_n_f32(c[3]), u, c[4]);
+                p                   = vfmaq_f32(vdupq_n_f32(c[2]), p, u);
+                p                   = vfmaq_f32(vdupq_n_f32(c[1]), p, u);
+                p                   = vfmaq_f32(vdupq_n_f32(c[0]), p, u);
+                const float32x4_t curve  = vmulq_f32(vmulq_f32(y, y), p);
+                const float32x4_t linear = vmulq_n_f32(x, 1.0f / 12.92f);
+                const uint32x4_t low     = vcleq_f32(x, vdupq_n_f32(0.04045f));
+                vst1q_f32(out + i, vbslq_f32(low, linear, curve));
+            }
+
+            DecodeScalar(in + i, out + i, count - i);
+        }
+
+        inline void EncodeNeon(const f32* in, f32* out, const size_t count) {
+            const auto& c = kEncodeCoefficients;
+            size_t i      = 0;
+            for (; i + 4 <= count; i += 4) {
+                const float32x4_t x = Saturate(vld1q_f32(in + i));
+                const float32x4_t u = vsqrtq_f32(vsqrtq_f32(x));
+                float32x4_t p       = vfmaq_n_f32(vdupq_n_f32(c[4]), u, c[5]);
+                p                   = vfmaq_f32(vdupq_n_f32(c[3]), p, u);
+                p                   = vfmaq_f32(vdupq_n_f32(c[2]), p, u);
+                p                   = vfmaq_f32(vdupq_n_f32(c[1]), p, u);
+                p                   = vfmaq_f32(vdupq_n_f32(c[0]), p, u);
+                const float32x4_t linear = vmulq_n_f32(x, 12.92f);
+                const uint32x4_t low     = vcleq_f32(x, vdupq_n_f32(0.0031308f));
+                vst1q_f32(out + i, vbslq_f32(low, linear, p));
+            }
+
+            EncodeScalar(in + i, out + i, count - i);
+        }
+#endif
+
+        inline TransferKernel SelectTransferKernel(const bool encode) noexcept {
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+            if (Cpu::ActiveSimd() >= Cpu::SimdLevel::Avx2) {
+                return encode ? EncodeAvx2 : DecodeAvx2;
+            }
+
+            return encode ? EncodeSse2 : DecodeSse2;
+#elif defined(__aarch64__) || defined(_M_ARM64)
+            return encode ? EncodeNeon : DecodeNeon;
+#else
+            return encode ? EncodeScalar : DecodeScalar;
+#endif
+        }
+
+        using HexToRGBAKernel = void (*)(const u32*, f32*, size_t, PixelLayout);
+        using RGBAToHexKernel = void (*)(const f32*, u32*, size_t, PixelLayout);
+
+        inline HexToRGBAKernel SelectHexToRGBAKernel() noexcept {
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+            return Cpu::Select<HexToRGBAKernel>({{Cpu::Feature::Avx2, HexToRGBAAvx2}},
+                                                HexToRGBASse2);
+#elif defined(__aarch64__) || defined(_M_ARM64)
+            return HexToRGBANeon;
+#else
+            return [](const u32* hex, f32* out, const size_t count, const PixelLayout layout) {
+                HexToRGBAScalar(hex, out, count, layout, 0);
+            };
+#endif
+        }
+
+        inline RGBAToHexKernel SelectRGBAToHexKernel() noexcept {
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+            return Cpu::Select<RGBAToHexKernel>({{Cpu::Feature::Avx2, RGBAToHexAvx2}},
+                                                RGBAToHexSse2);
+#elif defined(__aarch64__) || defined(_M_ARM64)
+            return RGBAToHexNeon;
+#else
+            return [](const f32* rgba, u32* out, const size_t count, const PixelLayout layout) {
+                RGBAToHexScalar(rgba, out, count, layout, 0);
+            };
+#endif
+        }
+    }  // namespace Detail
+
+    // Batch forms of SRGBToLinear/LinearToSRGB over min(in.size(), out.size()) values, with the
+    // same clamping and error bounds. in and out may be the same span.
+    inline void SRGBToLinearBatch(std::span<const f32> in, std::span<f32> out) {
+        static const Detail::TransferKernel kernel = Detail::SelectTransferKernel(false);
+        kernel(in.data(), out.data(), std::min(in.size(), out.size()));
+    }
+
+    inline void SRGBToLinearBatch(std::span<const u8> in, std::span<f32> out) {
+        const size_t count = std::min(in.size(), out.size());
+        for (size_t i = 0; i < count; ++i) {
+            out[i] = Detail::kSRGBByteToLinear[in[i]];
+        }
+    }
+
+    inline void LinearToSRGBBatch(std::span<const f32> in, std::span<f32> out) {
+        static const Detail::TransferKernel kernel = Detail::SelectTransferKernel(true);
+        kernel(in.data(), out.data(), std::min(in.size(), out.size()));
+    }
+
+    // Unpacks ARGB hex pixels into four f32 channels each. Converts min(hex.size(), out.size() / 4)
+    // pixels, and the planar layout sizes its planes by that count. Channels match HexToRGBA
+    // exactly in either ColorSpace.
+    inline void HexToRGBABatch(std::span<const u32> hex,
+                               std::span<f32> out,
+                               const PixelLayout layout = PixelLayout::Interleaved,
+                               const ColorSpace space   = ColorSpace::SRGB) {
+        const size_t count = std::min(hex.size(), out.size() / 4);
+        if (space == ColorSpace::Linear) {
+            // Decoding is a lookup per byte either way, so one scalar pass is as fast as any.
+            const size_t stride = layout == PixelLayout::Interleaved ? 1 : count;
+            for (size_t i = 0; i < count; ++i) {
+                f32* pixel        = out.data() + (layout == PixelLayout::Interleaved ? i * 4 : i);
+                pixel[0]          = Detail::kSRGBByteToLinear[(hex[i] >> 16) & 0xFF];
+                pixel[stride]     = Detail::kSRGBByteToLinear[(hex[i] >> 8) & 0xFF];
+                pixel[stride * 2] = Detail::kSRGBByteToLinear[hex[i] & 0xFF];
+                pixel[stride * 3] = Detail::kByteToFloat[hex[i] >> 24];
+            }
+
+            return;
+        }
+
+        static const Detail::HexToRGBAKernel kernel = Detail::SelectHexToRGBAKernel();
+        kernel(hex.data(), out.data(), count, layout);
+    }
+
+    // Packs four f32 channels per pixel back into ARGB hex, converting min(out.size(),
+    // rgba.size() / 4) pixels. Channels are clamped to [0, 1] and rounded to nearest; NaN
+    // becomes 0. ColorSpace::Linear applies the sRGB encode curve first.
+    inline void RGBAToHexBatch(std::span<const f32> rgba,
+                               std::span<u32> out,
+                               const PixelLayout layout = PixelLayout::Interleaved,
+                               const ColorSpace space   = ColorSpace::SRGB) {
+        const size_t count = std::min(out.size(), rgba.size() / 4);
+        if (space == ColorSpace::Linear) {
+            // Encode a stack-sized chunk at a time into interleaved scratch, then pack that.
+            constexpr size_t kChunk = 256;
+            f32 encoded[kChunk * 4];
+            const size_t stride = layout == PixelLayout::Interleaved ? 1 : count;
+            for (size_t first = 0; first < count; first += kChunk) {
+                const size_t pixels = std::min(kChunk, count - first);
+                for (size_t i = 0; i < pixels; ++i) {
+                    const size_t index = first + i;
+                    const f32* pixel =
+                      rgba.data() + (layout == PixelLayout::Interleaved ? index * 4 : index);
+                    for (size_t channel = 0; channel < 4; ++channel) {
+                        encoded[i * 4 + channel] = pixel[channel * stride];
+                    }
+                }
+
+                const std::span<f32> scratch(encoded, pixels * 4);
+                LinearToSRGBBatch(scratch, scratch);
+                for (size_t i = 0; i < pixels; ++i) {
+                    const size_t alpha = layout == PixelLayout::Interleaved ? (first + i) * 4 + 3
+                                                                            : count * 3 + first + i;
+                    encoded[i * 4 + 3] = rgba[alpha];
+                }
+
+                RGBAToHexBatch(scratch, out.subspan(first, pixels));
+            }
+
+            return;
+        }
+
+        static const Detail::RGBAToHexKernel kernel = Detail::SelectRGBAToHexKernel();
+        kernel(rgba.data(), out.data(), count, layout);
+    }
+
+    // One packed 8-bit pixel in the same 0xAARRGGBB layout as the hex functions, so a span of
+    // u32 hex colors and a span of RGBA8 share their memory representation.
+    struct RGBA8 {
+        u32 hex = 0;
+
+        static constexpr RGBA8
+        FromChannels(const u8 r, const u8 g, const u8 b, const u8 a) noexcept {
+            return {(CAST<u32>(a) << 24) | (CAST<u32>(r) << 16) | (CAST<u32>(g) << 8) | b};
+        }
+
+        [[nodiscard]] constexpr u8 R() const noexcept {
+            return CAST<u8>(hex >> 16);
+        }
+
+        [[nodiscard]] constexpr u8 G() const noexcept {
+            return CAST<u8>(hex >> 8);
+        }
+
+        [[nodiscard]] constexpr u8 B() const noexcept {
+            return CAST<u8>(hex);
+        }
+
+        [[nodiscard]] constexpr u8 A() const noexcept {
+            return CAST<u8>(hex >> 24);
+        }
+
+        friend constexpr bool operator==(RGBA8, RGBA8) = default;
+    };
+
+    static_assert(sizeof(RGBA8) == sizeof(u32));
+
+    namespace Detail {
+        // Exactly round(x * y / 255) for x, y in [0, 255], without a divide.
+        constexpr u32 MultiplyDivide255(const u32 x, const u32 y) noexcept {
+            const u32 t = x * y + 128;
+            return (t + (t >> 8)) >> 8;
+        }
+
+        // Maps f32 weights onto [0, 256] so the endpoints are exact in 8.8 fixed point.
+        inline u32 LerpWeight(const f32 t) noexcept {
+            return CAST<u32>(Saturate(t) * 256.0f + 0.5f);
+        }
+
+        // round(255 * 65536 / a): unpremultiplying is then one multiply and shift per channel.
+        inline constexpr std::array<u32, 256> kUnpremultiplyScale = [] {
+            std::array<u32, 256> table {};
+            for (u32 alpha = 1; alpha < table.size(); ++alpha) {
+                table[alpha] = (255u * 65536u + alpha / 2) / alpha;
+            }
+
+            return table;
+        }();
+
+        template<class F>
+        constexpr RGBA8 MapChannels(const RGBA8 pixel, F op) noexcept {
+            return RGBA8::FromChannels(CAST<u8>(op(pixel.R())),
+                                       CAST<u8>(op(pixel.G())),
+                                       CAST<u8>(op(pixel.B())),
+                                       pixel.A());
+        }
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+        // 16-bit lanes: round(x * y / 255) per lane, the same identity as MultiplyDivide255.
+        inline __m128i MultiplyDivide255(const __m128i x, const __m128i y) noexcept {
+            const __m128i t = _mm_add_epi16(_mm_mullo_epi16(x, y), _mm_set1_epi16(128));
+            return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+        }
+
+        // Copies each pixel's alpha (lane 3 of every four 16-bit lanes) across its pixel.
+        inline __m128i BroadcastAlpha(const __m128i lanes) noexcept {
+            return _mm_shufflehi_epi16(_mm_shufflelo_epi16(lanes, 0xFF), 0xFF);
+        }
+
+        inline __m128i PremultiplyHalf(const __m128i lanes) noexcept {
+            const __m128i alphaLanes = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+            // Multiplying the alpha lane by 255 leaves it unchanged.
+            const __m128i factor =
+              _mm_or_si128(_mm_andnot_si128(alphaLanes, BroadcastAlpha(lanes)),
+                           _mm_and_si128(alphaLanes, _mm_set1_epi16(255)));
+            return MultiplyDivide255(lanes, factor);
+        }
+#endif
+    }  // namespace Detail
+
+    // The batch operations below run element-wise over min of their span sizes, and the output
+    // may alias an input. On x86 they work on 16-bit lanes with SSE2; on AArch64 with NEON.
+
+    // Scales red, green and blue by alpha.
+    inline void Premultiply(std::span<const RGBA8> in, std::span<RGBA8> out) {
+        const size_t count = std::min(in.size(), out.size());
+        size_t i           = 0;
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+        const __m128i zero = _mm_setzero_si128();
+        for (; i + 4 <= count; i += 4) {
+            const __m128i pixels = _mm_loadu_si128(RCAST<const __m128i*>(in.data() + i));
+            const __m128i low    = Detail::PremultiplyHalf(_mm_unpacklo_epi8(pixels, zero));
+            const __m128i high   = Detail::PremultiplyHalf(_mm_unpackhi_epi8(pixels, zero));
+            _mm_storeu_si128(RCAST<__m128i*>(out.data() + i), _mm_packus_epi16(low, high));
+        }
+#elif defined(__aarch64__) || defined(_M_ARM64)
+        for (; i + 8 <= count; i += 8) {
+            // Byte planes b, g, r, a for eight pixels.
+            uint8x8x4_t planes = vld4_u8(RCAST<const u8*>(in.data() + i));
+            for (size_t channel = 0; channel < 3; ++channel) {
+                const uint16x8_t t  = vmull_u8(planes.val[channel], planes.val[3]);
+                planes.val[channel] = vraddhn_u16(t, vrshrq_n_u16(t, 8));
+            }
+
+            vst4_u8(RCAST<u8*>(out.data() + i), planes);
+        }
+#endif
+        for (; i < count; ++i) {
+            const u32 alpha = in[i].A();
+            out[i]          = Detail::MapChannels(in[i], [alpha](const u32 c) {
+                return Detail::MultiplyDivide255(c, alpha);
+            });
+        }
+    }
+
+    // Inverse of Premultiply, up to the precision premultiplying lost. Fully transparent
+    // pixels become transparent black. Channels above alpha saturate to 255.
+    inline void Unpremultiply(std::span<const RGBA8> in, std::span<RGBA8> out) {
+        // One table multiply per channel; division has no packed 8-bit form to vectorize.
+        const size_t count = std::min(in.size(), out.size());
+        for (size_t i = 0; i < count; ++i) {
+            const u32 scale = Detail::kUnpremultiplyScale[in[i].A()];
+            out[i]          = Detail::MapChannels(in[i], [scale](const u32 c) {
+                return std::min<u32>((c * scale + 32768) >> 16, 255);
+            });
+        }
+    }
+
+    // Porter-Duff source-over for premultiplied pixels: out = src + dst * (1 - src.alpha).
+    inline void
+    AlphaOver(std::span<const RGBA8> src, std::span<const RGBA8> dst, std::span<RGBA8> out) {
+        const size_t count = std::min({src.size(), dst.size(), out.size()});
+        size_t i           = 0;
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i full = _mm_set1_epi16(255);
+        for (; i + 4 <= count; i += 4) {
+            const __m128i source = _mm_loadu_si128(RCAST<const __m128i*>(src.data() + i));
+            const __m128i target = _mm_loadu_si128(RCAST<const __m128i*>(dst.data() + i));
+            const __m128i keepLow =
+              _mm_sub_epi16(full, Detail::BroadcastAlpha(_mm_unpacklo_epi8(source, zero)));
+            const __m128i keepHigh =
+              _mm_sub_epi16(full, Detail::BroadcastAlpha(_mm_unpackhi_epi8(source, zero)));
+            const __m128i low =
+              Detail::MultiplyDivide255(_mm_unpacklo_epi8(target, zero), keepLow);
+            const __m128i high =
+              Detail::MultiplyDivide255(_mm_unpackhi_epi8(target, zero), keepHigh);
+            const __m128i blended = _mm_adds_epu8(source, _mm_packus_epi16(low, high));
+            _mm_storeu_si128(RCAST<__m128i*>(out.data() + i), blended);
+        }
+#elif defined(__aarch64__) || defined(_M_ARM64)
+        for (; i + 8 <= count; i += 8) {
+            const uint8x8x4_t source = vld4_u8(RCAST<const u8*>(src.data() + i));
+            uint8x8x4_t target       = vld4_u8(RCAST<const u8*>(dst.data() + i));
+            const uint8x8_t keep     = vmvn_u8(source.val[3]);
+            for (size_t channel = 0; channel < 4; ++channel) {
+                const uint16x8_t t = vmull_u8(target.val[channel], keep);
+                target.val[channel] =
+                  vqadd_u8(source.val[channel], vraddhn_u16(t, vrshrq_n_u16(t, 8)));
+            }
+
+            vst4_u8(RCAST<u8*>(out.data() + i), target);
+        }
+#endif
+        for (; i < count; ++i) {
+            const u32 keep  = 255 - src[i].A();
+            const auto over = [keep](const u32 s, const u32 d) {
+                return CAST<u8>(std::min<u32>(s + Detail::MultiplyDivide255(d, keep), 255));
+            };
+            out[i] = RGBA8::FromChannels(over(src[i].R(), dst[i].R()),
+                                         over(src[i].G(), dst[i].G()),
+                                         over(src[i].B(), dst[i].B()),
+                                         over(src[i].A(), dst[i].A()));
+        }
+    }
+
+    // Per-channel Lerp(a, b, t) in 8.8 fixed point. Like Math::Lerp, t = 0 yields a, t = 1
+    // yields b and equal inputs are returned unchanged; t is clamped to [0, 1].
+    inline void
+    Lerp(std::span<const RGBA8> a, std::span<const RGBA8> b, const f32 t, std::span<RGBA8> out) {
+        const size_t count = std::min({a.size(), b.size(), out.size()});
+        const u32 weight   = Detail::LerpWeight(t);
+        size_t i           = 0;
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+        const __m128i zero  = _mm_setzero_si128();
+        const __m128i toB   = _mm_set1_epi16(CAST<i16>(weight));
+        const __m128i toA   = _mm_set1_epi16(CAST<i16>(256 - weight));
+        const __m128i round = _mm_set1_epi16(128);
+        const auto blend    = [&](const __m128i x, const __m128i y) {
+            const __m128i sum = _mm_add_epi16(_mm_mullo_epi16(x, toA), _mm_mullo_epi16(y, toB));
+            return _mm_srli_epi16(_mm_add_epi16(sum, round), 8);
+        };
+        for (; i + 4 <= count; i += 4) {
+            const __m128i from = _mm_loadu_si128(RCAST<const __m128i*>(a.data() + i));
+            const __m128i to   = _mm_loadu_si128(RCAST<const __m128i*>(b.data() + i));
+            const __m128i low  = blend(_mm_unpacklo_epi8(from, zero), _mm_unpacklo_epi8(to, zero));
+            const __m128i high = blend(_mm_unpackhi_epi8(from, zero), _mm_unpackhi_epi8(to, zero));
+            _mm_storeu_si128(RCAST<__m128i*>(out.data() + i), _mm_packus_epi16(low, high));
+        }
+#elif defined(__aarch64__) || defined(_M_ARM64)
+        const uint16x8_t toB = vdupq_n_u16(CAST<u16>(weight));
+        const uint16x8_t toA = vdupq_n_u16(CAST<u16>(256 - weight));
+        for (; i + 4 <= count; i += 4) {
+            const uint8x16_t from = vld1q_u8(RCAST<const u8*>(a.data() + i));
+            const uint8x16_t to   = vld1q_u8(RCAST<const u8*>(b.data() + i));
+            const uint16x8_t low  = vmlaq_u16(
+              vmulq_u16(vmovl_u8(vget_low_u8(from)), toA), vmovl_u8(vget_low_u8(to)), toB);
+            const uint16x8_t high =
+              vmlaq_u16(vmulq_u16(vmovl_high_u8(from), toA), vmovl_high_u8(to), toB);
+            vst1q_u8(RCAST<u8*>(out.data() + i),
+                     vcombine_u8(vrshrn_n_u16(low, 8), vrshrn_n_u16(high, 8)));
+        }
+#endif
+        for (; i < count; ++i) {
+            const auto mix = [weight](const u32 x, const u32 y) {
+                return CAST<u8>((x * (256 - weight) + y * weight + 128) >> 8);
+            };
+            out[i] = RGBA8::FromChannels(mix(a[i].R(), b[i].R()),
+                                         mix(a[i].G(), b[i].G()),
+                                         mix(a[i].B(), b[i].B()),
+                                         mix(a[i].A(), b[i].A()));
+        }
     }
 }  // namespace Color
\ No newline at end of file
@@ -0,0 +1,272 @@
+// rieger_bench entry point: runs the registered cases, prints a table, writes JSON and checks it
+// against a baseline.
+//
+//   rieger_bench [--filter text] [--json file] [--baseline file] [--threshold 0.10]
+//                [--min-time ms] [--samples n] [--large] [--dir path]
+//
+// Times are per call: the median of the samples, which is also what the baseline check
+// compares. The JSON keeps one benchmark per line so results diff cleanly across commits.
+
+#include "Bench.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+    struct CommandLine {
+        Bench::Options options;
+        str filter;
+        Path json;
+        Path baseline;
+        f64 threshold = 0.10;
+    };
+
+    [[noreturn]] void Usage(const char* message) {
+        std::fprintf(stderr,
+                     "rieger_bench: %s\n"
+                     "usage: rieger_bench [--filter text] [--json file] [--baseline file]\n"
+                     "                    [--threshold fraction] [--min-time ms] [--samples n]\n"
+                     "                    [--large] [--dir path]\n",
+                     message);
+        std::exit(2);
+    }
+
+    CommandLine Parse(const int argc, char** argv) {
+        CommandLine command;
+        for (int i = 1; i < argc; ++i) {
+            const std::string_view argument = argv[i];
+            const auto value                = [&]() -> const char* {
+                if (i + 1 >= argc) {
+                    Usage("missing value after an option");
+                }
+
+                return argv[++i];
+            };
+
+            if (argument == "--filter") {
+                command.filter = value();
+            } else if (argument == "--json") {
+                command.json = value();
+            } else if (argument == "--baseline") {
+                command.baseline = value();
+                if (command.baseline.empty()) {
+                    // Most likely an unset variable; checking against nothing would pass.
+                    Usage("--baseline needs a file");
+                }
+            } else if (argument == "--threshold") {
+                command.threshold = std::strtod(value(), nullptr);
+            } else if (argument == "--min-time") {
+                command.options.minSampleTime =
+                  std::chrono::microseconds(CAST<i64>(std::strtod(value(), nullptr) * 1000));
+            } else if (argument == "--samples") {
+                command.options.samples = std::max<size_t>(1, std::strtoul(value(), nullptr, 10));
+            } else if (argument == "--large") {
+                command.options.large = true;
+            } else if (argument == "--dir") {
+                command.options.directory = value();
+            } else {
+                Usage("unknown option");
+            }
+        }
+
+        // Every run gets its own scratch directory, removed again at exit.
+        const Path parent = command.options.directory.empty() ? FileSystem::temp_directory_path()
+                                                              : command.options.directory;
+        const auto stamp  = Bench::Clock::now().time_since_epoch().count();
+        command.options.directory = parent / ("rieger_bench-" + std::to_string(stamp));
+        return command;
+    }
+
+    str Escape(const std::string_view text) {
+        str escaped;
+        for (const char character : text) {
+            if (character == '"' || character == '\\') {
+                escaped += '\\';
+            }
+
+            escaped += character;
+        }
+
+        return escaped;
+    }
+
+    str Compiler() {
+#if defined(__clang__)
+        return "clang " __clang_version__;
+#elif defined(__GNUC__)
+        return "gcc " __VERSION__;
+#elif defined(_MSC_VER)
+        return "msvc " + std::to_string(_MSC_FULL_VER);
+#else
+        return "unknown";
+#endif
+    }
+
+    bool WriteJson(const Path& filename, const Vector<Bench::Result>& results) {
+        Vector<str> lines;
+        lines.push_back("{");
+        lines.push_back("  \"context\": {\"compiler\": \"" + Escape(Compiler()) +
+                        "\", \"threads\": " +
+                        std::to_string(std::thread::hardware_concurrency()) + "},");
+        lines.push_back("  \"benchmarks\": [");
+        for (size_t i = 0; i < results.size(); ++i) {
+            const auto& result = results[i];
+            char numbers[256];
+            std::snprintf(numbers,
+                          sizeof(numbers),
+                          "\"iterations\": %llu, \"median_ns\": %.3f, \"min_ns\": %.3f, "
+                          "\"bytes_per_op\": %llu, \"items_per_op\": %llu",
+                          CAST<unsigned long long>(result.iterations),
+                          result.medianNs,
+                          result.minNs,
+                          CAST<unsigned long long>(result.bytes),
+                          CAST<unsigned long long>(result.items));
+            lines.push_back("    {\"name\": \"" + Escape(result.name) + "\", " + numbers + "}" +
+                            (i + 1 < results.size() ? "," : ""));
+        }
+
+        lines.push_back("  ]");
+        lines.push_back("}");
+        return IO::WriteAllLines(filename, lines);
+    }
+
+    // Reads back the name and median of every benchmark line WriteJson produced.
+    Option<std::unordered_map<str, f64>> ReadJson(const Path& filename) {
+        const auto lines = IO::ReadAllLines(filename);
+        if (!lines.has_value()) {
+            return kNone;
+        }
+
+        std::unordered_map<str, f64> medians;
+        for (const auto& line : *lines) {
+            constexpr std::string_view kName   = "{\"name\": \"";
+            constexpr std::string_view kMedian = "\"median_ns\": ";
+            const auto name                    = line.find(kName);
+            const auto median                  = line.find(kMedian);
+            if (name == str::npos || median == str::npos) {
+                continue;
+            }
+
+            str key;
+            for (size_t i = name + kName.size(); i < line.size() && line[i] != '"'; ++i) {
+                if (line[i] == '\\' && i + 1 < line.size()) {
+                    ++i;
+                }
+
+                key += line[i];
+            }
+
+            medians[key] = std::strtod(line.c_str() + median + kMedian.size(), nullptr);
+        }
+
+        return medians;
+    }
+
+    void PrintResult(const Bench::Result& result) {
+        char throughput[64] = "";
+        const f64 seconds   = result.medianNs * 1e-9;
+        if (result.bytes > 0 && seconds > 0) {
+            std::snprintf(throughput,
+                          sizeof(throughput),
+                          "%10.2f MB/s",
+                          CAST<f64>(result.bytes) / seconds / 1e6);
+        } else if (result.items > 0 && seconds > 0) {
+            std::snprintf(throughput,
+                          sizeof(throughput),
+                          "%10.2f M/s ",
+                          CAST<f64>(result.items) / seconds / 1e6);
+        }
+
+        std::printf("%-52s %14.1f ns %14.1f ns %s\n",
+                    result.name.c_str(),
+                    result.medianNs,
+                    result.minNs,
+                    throughput);
+        std::fflush(stdout);
+    }
+
+    // Lists every benchmark that moved by more than threshold and counts the slowdowns.
+    // Benchmarks missing from the baseline are listed as new and never fail the check.
+    int Compare(const Vector<Bench::Result>& results,
+                const std::unordered_map<str, f64>& previous,
+                const f64 threshold) {
+        int regressions = 0;
+        std::printf("\nagainst baseline (threshold %.1f%%):\n", threshold * 100);
+        for (const auto& result : results) {
+            const auto before = previous.find(result.name);
+            if (before == previous.end() || before->second <= 0) {
+                std::printf("  %-52s new\n", result.name.c_str());
+                continue;
+            }
+
+            const f64 change     = result.medianNs / before->second - 1.0;
+            const bool regressed = change > threshold;
+            regressions += regressed;
+            if (regressed || change < -threshold) {
+                std::printf("  %-52s %+7.1f%%%s\n",
+                            result.name.c_str(),
+                            change * 100,
+                            regressed ? "  REGRESSION" : "");
+            }
+        }
+
+        std::printf("%d regression(s)\n", regressions);
+        return regressions > 0 ? 1 : 0;
+    }
+}  // namespace
+
+int main(const int argc, char** argv) {
+    const auto command = Parse(argc, argv);
+
+    // Read first: the baseline may be the very file this run's JSON replaces.
+    Option<std::unordered_map<str, f64>> baseline;
+    if (!command.baseline.empty()) {
+        baseline = ReadJson(command.baseline);
+        if (!baseline.has_value()) {
+            std::fprintf(
+              stderr, "rieger_bench: cannot read %s\n", command.baseline.string().c_str());
+            return 2;
+        }
+    }
+
+    std::error_code error;
+    FileSystem::create_directories(command.options.directory, error);
+    if (error) {
+        std::fprintf(
+          stderr, "rieger_bench: cannot create %s\n", command.options.directory.string().c_str());
+        return 2;
+    }
+
+    Bench::Registry registry;
+    Bench::RegisterColor(registry);
+    Bench::RegisterContainers(registry);
+    Bench::RegisterIO(registry, command.options);
+    Bench::RegisterMath(registry);
+
+    std::printf("%-52s %17s %17s %13s\n", "benchmark", "median", "min", "throughput");
+    Vector<Bench::Result> results;
+    for (const auto& entry : registry.Entries()) {
+        if (!command.filter.empty() && entry.name.find(command.filter) == str::npos) {
+            continue;
+        }
+
+        Bench::State state(command.options);
+        entry.function(state);
+        state.Outcome().name = entry.name;
+        PrintResult(state.Outcome());
+        results.push_back(state.Outcome());
+    }
+
+    FileSystem::remove_all(command.options.directory, error);
+
+    if (!command.json.empty() && !WriteJson(command.json, results)) {
+        std::fprintf(stderr, "rieger_bench: cannot write %s\n", command.json.string().c_str());
+        return 2;
+    }
+
+    if (baseline.has_value()) {
+        return Compare(results, *baseline, command.threshold);
+    }
+
+    return 0;
+}
@@ -0,0 +1,167 @@
+// Minimal benchmark harness for rieger_bench: registration, adaptive timing and JSON output.
+
+#pragma once
+
+#include "Rieger.h"
+
+#include <chrono>
+
+namespace Bench {
+    using Clock = std::chrono::steady_clock;
+
+    // Keeps the compiler from discarding a result or hoisting work out of the timed loop.
+    template<class T>
+    void DoNotOptimize(T&& value) {
+#if defined(__GNUC__) || defined(__clang__)
+        asm volatile("" : : "r,m"(value) : "memory");
+#else
+        static volatile const void* sink;
+        sink = &value;
+        _ReadWriteBarrier();
+#endif
+    }
+
+    struct Options {
+        std::chrono::nanoseconds minSampleTime = std::chrono::milliseconds(5);
+        size_t samples                         = 11;
+        // Also run the multi-gigabyte IO cases.
+        bool large = false;
+        Path directory;
+    };
+
+    struct Result {
+        str name;
+        u64 iterations = 0;
+        f64 medianNs   = 0;
+        f64 minNs      = 0;
+        u64 bytes      = 0;
+        u64 items      = 0;
+    };
+
+    // Handed to each benchmark; Run does the timing and records the result.
+    class State {
+    public:
+        explicit State(const Options& options) : options(options) {}
+
+        // Throughput figures per call of the body.
+        void SetBytesProcessed(const u64 bytes) noexcept {
+            result.bytes = bytes;
+        }
+
+        void SetItemsProcessed(const u64 items) noexcept {
+            result.items = items;
+        }
+
+        // Calls body in batches sized so each sample takes at least minSampleTime, and keeps
+        // the median and fastest per-call times.
+        template<class Body>
+        void Run(Body&& body) {
+            constexpr size_t kMaxBatch = size_t(1) << 30;
+
+            size_t batch = 1;
+            while (true) {
+                const auto elapsed = TimeBatch(body, batch);
+                if (elapsed >= options.minSampleTime || batch >= kMaxBatch) {
+                    break;
+                }
+
+                // Aim a little past the target, growing at most tenfold per probe.
+                const f64 ratio = elapsed.count() > 0
+                                    ? CAST<f64>(options.minSampleTime.count()) / elapsed.count()
+                                    : 10.0;
+                batch = CAST<size_t>(CAST<f64>(batch) * std::clamp(ratio * 1.2, 2.0, 10.0));
+            }
+
+            Vector<f64> perCall;
+            for (size_t sample = 0; sample < options.samples; ++sample) {
+                perCall.push_back(CAST<f64>(TimeBatch(body, batch).count()) / CAST<f64>(batch));
+            }
+
+            Record(perCall, batch * options.samples);
+        }
+
+        // Runs setup, untimed, before every call of body, e.g. to drop a file from the page
+        // cache. Each call is timed on its own, so keep it to bodies well above a microsecond.
+        template<class Setup, class Body>
+        void Run(Setup&& setup, Body&& body) {
+            Vector<f64> perCall;
+            for (size_t sample = 0; sample < options.samples; ++sample) {
+                setup();
+                const auto start = Clock::now();
+                body();
+                perCall.push_back(CAST<f64>((Clock::now() - start).count()));
+            }
+
+            Record(perCall, options.samples);
+        }
+
+        [[nodiscard]] const Options& Settings() const noexcept {
+            return options;
+        }
+
+        [[nodiscard]] Result& Outcome() noexcept {
+            return result;
+        }
+
+    private:
+        const Options& options;
+        Result result;
+
+        template<class Body>
+        std::chrono::nanoseconds TimeBatch(Body& body, const size_t batch) {
+            const auto start = Clock::now();
+            for (size_t i = 0; i < batch; ++i) {
+                body();
+            }
+
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start);
+        }
+
+        void Record(Vector<f64>& perCall, const u64 iterations) {
+            std::sort(perCall.begin(), perCall.end());
+            result.iterations = iterations;
+            result.medianNs   = perCall[perCall.size() / 2];
+            result.minNs      = perCall.front();
+        }
+    };
+
+    using Function = std::function<void(State&)>;
+
+    class Registry {
+    public:
+        void Add(str name, Function function) {
+            entries.push_back({std::move(name), std::move(function)});
+        }
+
+        struct Entry {
+            str name;
+            Function function;
+        };
+
+        [[nodiscard]] const Vector<Entry>& Entries() const noexcept {
+            return entries;
+        }
+
+    private:
+        Vector<Entry> entries;
+    };
+
+    // Each benchmark source registers its cases here; Bench.cpp calls all of them.
+    void RegisterColor(Registry& registry);
+    void RegisterContainers(Registry& registry);
+    void RegisterIO(Registry& registry, const Options& options);
+    void RegisterMath(Registry& registry);
+
+    // Human-readable byte count for benchmark names: 4KiB, 1MiB, 4GiB.
+    inline str SizeName(const u64 bytes) {
+        constexpr const char* kUnits[] = {"B", "KiB", "MiB", "GiB"};
+        size_t unit = 0;
+        u64 value   = bytes;
+        while (unit + 1 < std::size(kUnits) && value >= 1024 && value % 1024 == 0) {
+            value /= 1024;
+            ++unit;
+        }
+
+        return std::to_string(value) + kUnits[unit];
+    }
+}  // namespace Bench
@@ -0,0 +1,158 @@
+// Color conversions over one megapixel, reported as pixels per second. The scalar cases loop
+// over the per-pixel functions the batch ones replace.
+
+#include "Bench.h"
+
+namespace Bench {
+    namespace {
+        constexpr size_t kPixels = 1024 * 1024;
+
+        Vector<u32> HexPixels() {
+            Vector<u32> hex(kPixels);
+            u32 state = 0x12345678;
+            for (auto& pixel : hex) {
+                state ^= state << 13;
+                state ^= state >> 17;
+                state ^= state << 5;
+                pixel = state;
+            }
+
+            return hex;
+        }
+
+        Vector<f32> Channels() {
+            Vector<f32> channels(kPixels * 4);
+            for (size_t i = 0; i < channels.size(); ++i) {
+                channels[i] = CAST<f32>(i % 256) / 255.0f;
+            }
+
+            return channels;
+        }
+
+        Vector<Color::RGBA8> Bytes() {
+            const auto hex = HexPixels();
+            Vector<Color::RGBA8> pixels(kPixels);
+            for (size_t i = 0; i < kPixels; ++i) {
+                pixels[i].hex = hex[i];
+            }
+
+            return pixels;
+        }
+
+        template<class Body>
+        void Add(Registry& registry, const str& name, Body body) {
+            registry.Add("Color/" + name + "/1Mpx", [body](State& state) {
+                state.SetItemsProcessed(kPixels);
+                body(state);
+            });
+        }
+    }  // namespace
+
+    void RegisterColor(Registry& registry) {
+        Add(registry, "HexToRGBA/scalar", [](State& state) {
+            const auto hex = HexPixels();
+            Vector<f32> out(kPixels * 4);
+            state.Run([&] {
+                for (size_t i = 0; i < kPixels; ++i) {
+                    f32* pixel = out.data() + 4 * i;
+                    Color::HexToRGBA(hex[i], pixel[0], pixel[1], pixel[2], pixel[3]);
+                }
+
+                DoNotOptimize(out.data());
+            });
+        });
+
+        for (const auto layout : {Color::PixelLayout::Interleaved, Color::PixelLayout::Planar}) {
+            const str suffix = layout == Color::PixelLayout::Planar ? "/planar" : "/interleaved";
+            Add(registry, "HexToRGBABatch" + suffix, [layout](State& state) {
+                const auto hex = HexPixels();
+                Vector<f32> out(kPixels * 4);
+                state.Run([&] {
+                    Color::HexToRGBABatch(hex, out, layout);
+                    DoNotOptimize(out.data());
+                });
+            });
+
+            Add(registry, "RGBAToHexBatch" + suffix, [layout](State& state) {
+                const auto channels = Channels();
+                Vector<u32> out(kPixels);
+                state.Run([&] {
+                    Color::RGBAToHexBatch(channels, out, layout);
+                    DoNotOptimize(out.data());
+                });
+            });
+        }
+
+        Add(registry, "RGBAToHex/scalar", [](State& state) {
+            const auto channels = Channels();
+            Vector<u32> out(kPixels);
+            state.Run([&] {
+                for (size_t i = 0; i < kPixels; ++i) {
+                    const f32* pixel = channels.data() + 4 * i;
+                    out[i]           = Color::RGBAToHex(pixel[0], pixel[1], pixel[2], pixel[3]);
+                }
+
+                DoNotOptimize(out.data());
+            });
+        });
+
+        Add(registry, "SRGBToLinear/scalar", [](State& state) {
+            const auto channels = Channels();
+            Vector<f32> out(channels.size());
+            state.Run([&] {
+                for (size_t i = 0; i < channels.size(); ++i) {
+                    out[i] = Color::SRGBToLinear(channels[i]);
+                }
+
+                DoNotOptimize(out.data());
+            });
+        });
+
+        Add(registry, "SRGBToLinearBatch/f32", [](State& state) {
+            const auto channels = Channels();
+            Vector<f32> out(channels.size());
+            state.Run([&] {
+                Color::SRGBToLinearBatch(channels, out);
+                DoNotOptimize(out.data());
+            });
+        });
+
+        Add(registry, "SRGBToLinearBatch/u8", [](State& state) {
+            const auto pixels = Bytes();
+            const std::span<const u8> bytes(RCAST<const u8*>(pixels.data()), kPixels * 4);
+            Vector<f32> out(bytes.size());
+            state.Run([&] {
+                Color::SRGBToLinearBatch(bytes, out);
+                DoNotOptimize(out.data());
+            });
+        });
+
+        Add(registry, "LinearToSRGBBatch", [](State& state) {
+            const auto channels = Channels();
+            Vector<f32> out(channels.size());
+            state.Run([&] {
+                Color::LinearToSRGBBatch(channels, out);
+                DoNotOptimize(out.data());
+            });
+        });
+
+        Add(registry, "Premultiply", [](State& state) {
+            const auto pixels = Bytes();
+            Vector<Color::RGBA8> out(kPixels);
+            state.Run([&] {
+                Color::Premultiply(pixels, out);
+                DoNotOptimize(out.data());
+            });
+        });
+
+        Add(registry, "AlphaOver", [](State& state) {
+            const auto source      = Bytes();
+            const auto destination = Bytes();
+            Vector<Color::RGBA8> out(kPixels);
+            state.Run([&] {
+                Color::AlphaOver(source, destination, out);
+                DoNotOptimize(out.data());
+            });
+        });
+    }
+}  // namespace Bench
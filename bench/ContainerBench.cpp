@@ -0,0 +1,99 @@
+// SmallVector and InlineString against Vector and str at the sizes they are meant for: a few
+// elements, short identifiers. Each call builds, walks or copies a thousand containers.
+
+#include "Bench.h"
+
+namespace Bench {
+    namespace {
+        constexpr size_t kContainers = 1000;
+        constexpr size_t kElements   = 6;
+
+        template<class Container>
+        void AddVector(Registry& registry, const str& name) {
+            registry.Add("Containers/" + name + "/push", [](State& state) {
+                state.SetItemsProcessed(kContainers);
+                state.Run([] {
+                    for (size_t i = 0; i < kContainers; ++i) {
+                        Container values;
+                        for (size_t j = 0; j < kElements; ++j) {
+                            values.push_back(CAST<i32>(i + j));
+                        }
+
+                        DoNotOptimize(values.data());
+                    }
+                });
+            });
+
+            registry.Add("Containers/" + name + "/iterate", [](State& state) {
+                Vector<Container> containers(kContainers);
+                for (auto& values : containers) {
+                    for (size_t j = 0; j < kElements; ++j) {
+                        values.push_back(CAST<i32>(j));
+                    }
+                }
+
+                state.SetItemsProcessed(kContainers);
+                state.Run([&] {
+                    i64 sum = 0;
+                    for (const auto& values : containers) {
+                        for (const i32 value : values) {
+                            sum += value;
+                        }
+                    }
+
+                    DoNotOptimize(sum);
+                });
+            });
+
+            registry.Add("Containers/" + name + "/copy", [](State& state) {
+                Container source;
+                for (size_t j = 0; j < kElements; ++j) {
+                    source.push_back(CAST<i32>(j));
+                }
+
+                state.SetItemsProcessed(kContainers);
+                state.Run([&] {
+                    for (size_t i = 0; i < kContainers; ++i) {
+                        Container copy(source);
+                        DoNotOptimize(copy.data());
+                    }
+                });
+            });
+        }
+
+        template<class String>
+        void AddString(Registry& registry, const str& name) {
+            registry.Add("Containers/" + name + "/append", [](State& state) {
+                state.SetItemsProcessed(kContainers);
+                state.Run([] {
+                    for (size_t i = 0; i < kContainers; ++i) {
+                        String text;
+                        text += "entity_";
+                        text += "transform_";
+                        text += CAST<char>('a' + i % 26);
+                        DoNotOptimize(text.data());
+                    }
+                });
+            });
+
+            registry.Add("Containers/" + name + "/copy", [](State& state) {
+                // Longer than libstdc++'s 15-character small-string buffer.
+                const String source("player_controller_input");
+                state.SetItemsProcessed(kContainers);
+                state.Run([&] {
+                    for (size_t i = 0; i < kContainers; ++i) {
+                        String copy(source);
+                        DoNotOptimize(copy.data());
+                    }
+                });
+            });
+        }
+    }  // namespace
+
+    void RegisterContainers(Registry& registry) {
+        AddVector<Vector<i32>>(registry, "Vector");
+        AddVector<SmallVector<i32, 8>>(registry, "SmallVector");
+        AddString<str>(registry, "str");
+        AddString<InlineString<31>>(registry, "InlineString");
+    }
+}  // namespace Bench
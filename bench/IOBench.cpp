@@ -0,0 +1,167 @@
+// IO::Read, ReadAllBytes, ReadAllLines, ReadBlock and WriteAllLines across file sizes, next to a
+// plain fread loop as the cat-level reference. Cold cases drop the file from the page cache
+// before every call and exist only where that needs no privileges (Linux).
+
+#include "Bench.h"
+
+#include <cstdio>
+
+#if defined(__linux__)
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+namespace Bench {
+    namespace {
+        constexpr size_t kLineLength = 64;
+
+        // Text of kLineLength-character lines, so the same file serves the byte and line cases.
+        Path DataFile(const Options& options, const u64 size) {
+            const Path filename = options.directory / ("data-" + SizeName(size) + ".txt");
+            if (FileSystem::exists(filename)) {
+                return filename;
+            }
+
+            std::FILE* file = std::fopen(filename.string().c_str(), "wb");
+            if (file == nullptr) {
+                throw RuntimeError("cannot create " + filename.string());
+            }
+
+            Vector<char> chunk(1024 * 1024);
+            u64 state = 0x9E3779B97F4A7C15;
+            for (size_t i = 0; i < chunk.size(); ++i) {
+                state ^= state << 13;
+                state ^= state >> 7;
+                state ^= state << 17;
+                chunk[i] = (i + 1) % kLineLength == 0 ? '\n' : CAST<char>('a' + state % 26);
+            }
+
+            for (u64 written = 0; written < size;) {
+                const size_t count = CAST<size_t>(std::min<u64>(chunk.size(), size - written));
+                std::fwrite(chunk.data(), 1, count, file);
+                written += count;
+            }
+
+            std::fclose(file);
+            return filename;
+        }
+
+        // Drops the file's pages so the next read goes to storage. The file was written by this
+        // run, so it is flushed first: dirty pages stay cached.
+        [[maybe_unused]] void Evict(const Path& filename) {
+#if defined(__linux__)
+            const int file = ::open(filename.c_str(), O_RDONLY);
+            if (file >= 0) {
+                ::fdatasync(file);
+                ::posix_fadvise(file, 0, 0, POSIX_FADV_DONTNEED);
+                ::close(file);
+            }
+#else
+            (void)filename;
+#endif
+        }
+
+        u64 Fread(const Path& filename) {
+            static Vector<char> buffer(1024 * 1024);
+            std::FILE* file = std::fopen(filename.string().c_str(), "rb");
+            u64 total       = 0;
+            if (file != nullptr) {
+                size_t count;
+                while ((count = std::fread(buffer.data(), 1, buffer.size(), file)) > 0) {
+                    total += count;
+                }
+
+                std::fclose(file);
+            }
+
+            return total;
+        }
+
+        // Registers name/<size>/warm and, where supported, name/<size>/cold.
+        template<class Body>
+        void AddRead(Registry& registry,
+                     const Options& options,
+                     const str& name,
+                     const u64 size,
+                     Body body) {
+            const str prefix = name + "/" + SizeName(size);
+            registry.Add(prefix + "/warm", [&options, size, body](State& state) {
+                const Path filename = DataFile(options, size);
+                body(filename);
+                state.SetBytesProcessed(size);
+                state.Run([&] { body(filename); });
+            });
+
+#if defined(__linux__)
+            registry.Add(prefix + "/cold", [&options, size, body](State& state) {
+                const Path filename = DataFile(options, size);
+                state.SetBytesProcessed(size);
+                state.Run([&] { Evict(filename); }, [&] { body(filename); });
+            });
+#endif
+        }
+
+        // 64 KiB blocks at strided offsets, so consecutive calls never hit the same block.
+        void AddReadBlock(Registry& registry, const Options& options, const u64 size) {
+            constexpr size_t kBlockSize = 64 * 1024;
+            const str name = "IO/ReadBlock/" + SizeName(kBlockSize) + "/" + SizeName(size);
+            registry.Add(name, [&options, size](State& state) {
+                const Path filename = DataFile(options, size);
+                const u64 blocks    = size / kBlockSize;
+                Vector<u8> block(kBlockSize);
+                u64 next = 0;
+                state.SetBytesProcessed(kBlockSize);
+                state.Run([&] {
+                    next = (next + 7919) % blocks;
+                    DoNotOptimize(IO::ReadBlock(filename, next * kBlockSize, block));
+                });
+            });
+        }
+
+        void AddWriteLines(Registry& registry, const Options& options, const size_t lines) {
+            const str name = "IO/WriteAllLines/" + std::to_string(lines);
+            registry.Add(name, [&options, lines](State& state) {
+                const Vector<str> content(lines, str(kLineLength - 1, 'x'));
+                const Path filename = options.directory / "write.txt";
+                state.SetBytesProcessed(lines * kLineLength);
+                state.Run([&] { DoNotOptimize(IO::WriteAllLines(filename, content)); });
+            });
+        }
+    }  // namespace
+
+    void RegisterIO(Registry& registry, const Options& options) {
+        Vector<u64> sizes = {4 * 1024, 1024 * 1024, 100 * 1024 * 1024};
+        if (options.large) {
+            sizes.push_back(4ull * 1024 * 1024 * 1024);
+        }
+
+        for (const u64 size : sizes) {
+            AddRead(registry, options, "Baseline/fread", size, [](const Path& filename) {
+                DoNotOptimize(Fread(filename));
+            });
+
+            AddRead(registry, options, "IO/Read", size, [](const Path& filename) {
+                DoNotOptimize(IO::Read(filename));
+            });
+
+            AddRead(registry, options, "IO/ReadAllBytes", size, [](const Path& filename) {
+                DoNotOptimize(IO::ReadAllBytes(filename));
+            });
+
+            // Tens of millions of strings at 4 GiB measure the allocator more than IO.
+            if (size <= 100 * 1024 * 1024) {
+                AddRead(registry, options, "IO/ReadAllLines", size, [](const Path& filename) {
+                    DoNotOptimize(IO::ReadAllLines(filename));
+                });
+            }
+
+            if (size >= 1024 * 1024) {
+                AddReadBlock(registry, options, size);
+            }
+        }
+
+        for (const size_t lines : {1000, 100000}) {
+            AddWriteLines(registry, options, lines);
+        }
+    }
+}  // namespace Bench
@@ -0,0 +1,53 @@
+// Math::Lerp one element at a time against Math::LerpBatch, at a cache-resident size and one
+// that streams from memory.
+
+#include "Bench.h"
+
+namespace Bench {
+    namespace {
+        template<class T>
+        struct LerpData {
+            Vector<T> a, b, t, out;
+
+            explicit LerpData(const size_t count) : a(count), b(count), t(count), out(count) {
+                for (size_t i = 0; i < count; ++i) {
+                    a[i] = CAST<T>(i % 1000);
+                    b[i] = CAST<T>(1000 - i % 1000);
+                    t[i] = CAST<T>(i % 97) / CAST<T>(96);
+                }
+            }
+        };
+
+        template<class T>
+        void AddLerp(Registry& registry, const str& type, const size_t count) {
+            const str suffix = "/" + type + "/" + std::to_string(count);
+            registry.Add("Math/Lerp/scalar" + suffix, [count](State& state) {
+                LerpData<T> data(count);
+                state.SetItemsProcessed(count);
+                state.Run([&] {
+                    for (size_t i = 0; i < count; ++i) {
+                        data.out[i] = Math::Lerp(data.a[i], data.b[i], data.t[i]);
+                    }
+
+                    DoNotOptimize(data.out.data());
+                });
+            });
+
+            registry.Add("Math/LerpBatch" + suffix, [count](State& state) {
+                LerpData<T> data(count);
+                state.SetItemsProcessed(count);
+                state.Run([&] {
+                    Math::LerpBatch<T>(data.a, data.b, data.t, data.out);
+                    DoNotOptimize(data.out.data());
+                });
+            });
+        }
+    }  // namespace
+
+    void RegisterMath(Registry& registry) {
+        for (const size_t count : {1024, 1024 * 1024}) {
+            AddLerp<f32>(registry, "f32", count);
+            AddLerp<f64>(registry, "f64", count);
+        }
+    }
+}  // namespace Bench